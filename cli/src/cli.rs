@@ -1,12 +1,15 @@
 use clap::{self, Args, Parser, Subcommand};
+use std::collections::BTreeMap;
 use std::ops::RangeInclusive;
-use std::{thread, time::Duration};
+use std::{thread, time::Duration, time::Instant};
 
 use crate::device::{self, Device, Report};
 use crate::temperature;
 
 mod animation;
+mod calibrate;
 mod lamparray;
+mod scene;
 
 #[derive(Parser)]
 #[command(author, version, about, long_about = None)]
@@ -35,6 +38,10 @@ impl Root {
 
             Commands::SetAnimation { animation } => animation.run(&dev),
 
+            Commands::Scene { command } => command.run(&dev),
+
+            Commands::Calibrate { command } => command.run(&dev),
+
             Commands::Reset(args) => dev
                 .send_report(Report::Reset(device::ResetFlags {
                     bootsel: args.bootsel,
@@ -42,12 +49,104 @@ impl Root {
                 }))
                 .map_err(From::from),
 
-            Commands::GetTemperature(args) => loop {
-                println!("{:.2}", args.units.from_celsius(dev.read_temperature()?));
-                match args.interval {
-                    Some(interval) => thread::sleep(Duration::from_secs(interval as u64)),
-                    None => return Ok(()),
+            Commands::GetPower => {
+                let status = dev.read_power_status()?;
+                for (id, load) in status.lamp_loads.iter().enumerate() {
+                    println!("lamp {}: {:.2} W", id + 1, watts(*load as u32));
+                }
+                println!("total: {:.2} W", watts(status.total_load));
+                println!("requested: {:.2} W", watts(status.requested_load));
+                if status.budget > 0 {
+                    println!("budget: {:.2} W", watts(status.budget));
+                } else {
+                    println!("budget: unlimited");
+                }
+                println!("brightness: {:.1}%", status.scale * 100.0);
+                println!(
+                    "temperature range: {:.2} to {:.2}",
+                    status.min_temperature, status.max_temperature
+                );
+                Ok(())
+            }
+
+            Commands::Stats(args) => args.run(&dev),
+
+            Commands::Trace(args) => args.run(&dev),
+
+            Commands::Recorder(args) => args.run(&dev),
+
+            Commands::Latency(args) => args.run(&dev),
+
+            Commands::Watch(args) => args.run(&dev),
+
+            Commands::Status => {
+                let status = dev.read_status()?;
+                let mode = if status.autonomous {
+                    "autonomous"
+                } else {
+                    "host"
+                };
+                println!("mode: {mode}");
+                println!("suspended: {}", yes_no(status.suspended));
+                println!("saved lamp state: {}", yes_no(status.checkpoint_saved));
+                match status.first_light_us {
+                    Some(us) => println!("first light: {us} us after reset"),
+                    None => println!("first light: -"),
+                }
+                println!();
+                println!(
+                    "{:<4} {:>6} {:>6} {:>6} {:>3}  {:<10} {:>5} {:>10}  default",
+                    "lamp", "red", "green", "blue", "i", "animation", "stage", "frame"
+                );
+                for (id, lamp) in status.lamps.iter().enumerate() {
+                    println!(
+                        "{:<4} {:>6} {:>6} {:>6} {:>3}  {:<10} {:>5} {:>10}  {}",
+                        id + 1,
+                        lamp.red,
+                        lamp.green,
+                        lamp.blue,
+                        lamp.intensity,
+                        device::Animation::type_name(lamp.animation_type),
+                        lamp.animation_stage,
+                        lamp.animation_frame,
+                        lamp.default_animation_type
+                            .map(device::Animation::type_name)
+                            .unwrap_or_else(|| "-".to_string())
+                    );
                 }
+                Ok(())
+            }
+
+            Commands::Memory => {
+                let status = dev.read_memory_status()?;
+                println!("data: {} bytes", status.data_size);
+                println!("bss: {} bytes", status.bss_size);
+                println!(
+                    "heap: {} of {} bytes used, {} peak, {} free",
+                    status.heap_used, status.heap_size, status.heap_peak, status.heap_free
+                );
+                for (core, (size, peak)) in status
+                    .stack_sizes
+                    .iter()
+                    .zip(status.stack_peaks.iter())
+                    .enumerate()
+                {
+                    if *size > 0 {
+                        println!("core {core} stack: {peak} of {size} bytes peak");
+                    }
+                }
+                Ok(())
+            }
+
+            Commands::GetTemperature(args) => match args.batch {
+                Some(batch_size) => args.run_batched(&dev, batch_size),
+                None => loop {
+                    println!("{:.2}", args.units.from_celsius(dev.read_temperature()?));
+                    match args.interval {
+                        Some(interval) => thread::sleep(Duration::from_secs(interval as u64)),
+                        None => return Ok(()),
+                    }
+                },
             },
         }
     }
@@ -70,11 +169,83 @@ pub enum Commands {
         animation: animation::Animation,
     },
 
+    /// Manage scenes saved on the device
+    Scene {
+        #[command(subcommand)]
+        command: scene::Command,
+    },
+
+    /// Correct the color response of each lamp
+    ///
+    /// Calibration curves map colors to PWM duty for each channel of each lamp. They are saved on
+    /// the device and applied to animations and host updates.
+    Calibrate {
+        #[command(subcommand)]
+        command: calibrate::Command,
+    },
+
     /// Reset the controller hardware
     Reset(ResetArgs),
 
     /// Read the internal temperature sensor
     GetTemperature(GetTemperatureArgs),
+
+    /// Print the estimated power of the lamps, the power limit, and the temperature range
+    ///
+    /// The device dims all lamps when their estimated total exceeds the budget. The budget is
+    /// lowered as the controller gets hot.
+    GetPower,
+
+    /// Print how long the firmware spends in each task and report handler
+    ///
+    /// Times are in microseconds. Report handlers run inside tud_task.
+    Stats(StatsArgs),
+
+    /// Print RAM usage, including the peak stack depth of each core
+    ///
+    /// Stack peaks are found by filling unused stack with a pattern at startup and finding the
+    /// deepest word that was overwritten.
+    Memory,
+
+    /// Print diagnostic events from the device as they happen
+    ///
+    /// The device records USB reports, late animation frames, flash stalls, suspend and resume,
+    /// and system clock mode changes in a small buffer. Events recorded before the stream starts are printed first, and
+    /// the oldest are lost if the buffer filled up.
+    Trace(TraceArgs),
+
+    /// Print the recent reports the device received and returned
+    ///
+    /// The device keeps the most recent reports with the time it handled them, whether it
+    /// accepted them, and their first bytes. Reports are printed oldest first, followed by the
+    /// time between reports of each kind. Reading the recorder does not add to it.
+    Recorder(RecorderArgs),
+
+    /// Measure the time from sending a lamp update to the light changing
+    ///
+    /// Sends probes as feature and output reports. The device records when each probe arrived,
+    /// when the next lamp update was written to the outputs, and when it becomes visible at the
+    /// start of a later output period. The transfer time to the device is estimated as half the
+    /// round trip. Output reports are sent over the interrupt endpoint when the system uses it,
+    /// so results are grouped by the path the device saw.
+    Latency(LatencyArgs),
+
+    /// Print the current lamp colors, animations, and mode
+    ///
+    /// The device returns its whole state in one report: the color last set on each lamp, the
+    /// animation playing on each lamp with its stage and frame, whether the host or the built-in
+    /// animations control the lamps, whether the device is suspended, the defaults saved to
+    /// flash, and how long after reset the first lamp turned on. Colors are sRGB values scaled to
+    /// 16 bits, before calibration and dimming.
+    Status,
+
+    /// Print device events as they happen
+    ///
+    /// The device sends an event when an animation reaches a new stage, a scene is switched, the
+    /// lamps start or stop dimming to stay within the power budget, which is lowered as the
+    /// device heats up, or a setting is written to flash. Subscribing to reset events also prints
+    /// the cause of the last reset. Only the selected events are sent, until --stop.
+    Watch(WatchArgs),
 }
 
 #[derive(Args)]
@@ -99,7 +270,386 @@ pub struct GetTemperatureArgs {
 
     /// How often to print the temperature, in seconds. If unset, print the current temperature
     /// and exit.
+    #[arg(conflicts_with = "batch")]
     interval: Option<u32>,
+
+    /// Stream timestamped samples, delivered by the device in batches of up to SIZE samples.
+    ///
+    /// Each line shows the device time in seconds and the temperature.
+    #[arg(long, value_name = "SIZE")]
+    #[arg(value_parser = clap::value_parser!(u8).range(1..=(device::TemperatureBatch::MAX_SAMPLES as i64)))]
+    batch: Option<u8>,
+
+    /// Time between batched samples, in milliseconds
+    #[arg(long, value_name = "MS", default_value_t = 100, requires = "batch")]
+    #[arg(value_parser = clap::value_parser!(u16).range(10..=5000))]
+    sample_interval: u16,
+
+    /// Longest time a batched sample can wait on the device before it is sent, in milliseconds
+    #[arg(long, value_name = "MS", default_value_t = 1000, requires = "batch")]
+    max_latency: u16,
+}
+
+impl GetTemperatureArgs {
+    fn run_batched(&self, dev: &Device, batch_size: u8) -> Result<(), Box<dyn std::error::Error>> {
+        dev.send_report(Report::TemperatureBatchConfig(
+            device::TemperatureBatchConfig {
+                batch_size,
+                sample_interval_ms: self.sample_interval,
+                max_latency_ms: self.max_latency,
+            },
+        ))?;
+
+        loop {
+            let batch = dev.read_temperature_batch()?;
+            if batch.dropped_samples > 0 {
+                eprintln!("warning: device dropped {} samples", batch.dropped_samples);
+            }
+            for sample in batch.samples {
+                println!(
+                    "{:.3}\t{:.2}",
+                    sample.timestamp_ms as f64 / 1000.0,
+                    self.units.from_celsius(sample.celsius)
+                );
+            }
+        }
+    }
+}
+
+#[derive(Args)]
+pub struct StatsArgs {
+    /// Also print the histogram of durations for each stage
+    #[arg(long)]
+    histogram: bool,
+
+    /// Clear all stats after printing them
+    #[arg(long)]
+    reset: bool,
+}
+
+impl StatsArgs {
+    fn run(&self, dev: &Device) -> Result<(), Box<dyn std::error::Error>> {
+        let first = dev.read_stats(0)?;
+        let mut pages = vec![];
+        for page in 1..first.page_count {
+            pages.push(dev.read_stats(page)?);
+        }
+        pages.insert(0, first);
+
+        println!(
+            "{:<28} {:>10} {:>10} {:>10}",
+            "stage", "count", "mean us", "max us"
+        );
+        for page in pages.iter() {
+            println!(
+                "{:<28} {:>10} {:>10} {:>10}",
+                page.name(),
+                page.count,
+                page.mean_us,
+                page.max_us
+            );
+            if self.histogram {
+                for (bucket, count) in page.histogram.iter().enumerate() {
+                    if *count > 0 {
+                        let start = device::StatsPage::bucket_start(bucket);
+                        println!("  >= {start:>8} us: {count}");
+                    }
+                }
+            }
+        }
+
+        println!();
+        for (name, value) in device::StatsPage::COUNTER_NAMES
+            .iter()
+            .zip(pages[0].counters.iter())
+        {
+            println!("{name}: {value}");
+        }
+
+        if self.reset {
+            dev.send_report(Report::Stats(device::StatsRequest {
+                page: 0,
+                reset: true,
+            }))?;
+        }
+        Ok(())
+    }
+}
+
+#[derive(Args)]
+pub struct TraceArgs {
+    /// Stop the stream and exit
+    #[arg(long)]
+    stop: bool,
+}
+
+impl TraceArgs {
+    fn run(&self, dev: &Device) -> Result<(), Box<dyn std::error::Error>> {
+        dev.send_report(Report::TraceConfig(device::TraceConfig {
+            stream: !self.stop,
+        }))?;
+        if self.stop {
+            return Ok(());
+        }
+
+        loop {
+            let batch = dev.read_trace_batch()?;
+            if batch.dropped_entries > 0 {
+                eprintln!("warning: device dropped {} events", batch.dropped_entries);
+            }
+            for entry in batch.entries {
+                println!("{:.6}\t{entry}", entry.timestamp_us as f64 / 1_000_000.0);
+            }
+        }
+    }
+}
+
+#[derive(Args)]
+pub struct WatchArgs {
+    /// The events to print, separated by commas. Prints all events by default.
+    ///
+    /// Events: reset, animation-stage, scene, throttle, persist
+    #[arg(long, value_delimiter = ',', value_parser = device::EventType::parse)]
+    events: Vec<device::EventType>,
+
+    /// Stop sending events and exit
+    #[arg(long)]
+    stop: bool,
+}
+
+impl WatchArgs {
+    fn run(&self, dev: &Device) -> Result<(), Box<dyn std::error::Error>> {
+        let types = if self.stop {
+            vec![]
+        } else if self.events.is_empty() {
+            device::EventType::ALL.to_vec()
+        } else {
+            self.events.clone()
+        };
+        dev.send_report(Report::EventsConfig(device::EventsConfig { types }))?;
+        if self.stop {
+            return Ok(());
+        }
+
+        loop {
+            let batch = dev.read_event_batch()?;
+            if batch.dropped_entries > 0 {
+                eprintln!("warning: device dropped {} events", batch.dropped_entries);
+            }
+            for event in batch.entries {
+                println!("{:.6}\t{event}", event.timestamp_us as f64 / 1_000_000.0);
+            }
+        }
+    }
+}
+
+#[derive(Args)]
+pub struct RecorderArgs {
+    /// Clear the recorder after printing it
+    #[arg(long)]
+    clear: bool,
+}
+
+impl RecorderArgs {
+    fn run(&self, dev: &Device) -> Result<(), Box<dyn std::error::Error>> {
+        let mut entries = vec![];
+        let mut sequence = 0;
+        loop {
+            let page = dev.read_recorder(sequence)?;
+            let Some(last) = page.entries.last() else {
+                break;
+            };
+            if let Some(first) = page.entries.first() {
+                if !entries.is_empty() && first.sequence != sequence {
+                    let lost = first.sequence.wrapping_sub(sequence);
+                    eprintln!("warning: {lost} reports were replaced while reading");
+                }
+            }
+            sequence = last.sequence.wrapping_add(1);
+            entries.extend(page.entries);
+            if sequence == page.next_sequence {
+                break;
+            }
+        }
+
+        // Inter-arrival times in microseconds for each kind of report
+        let mut intervals: BTreeMap<String, Vec<u32>> = BTreeMap::new();
+        let mut last_seen: BTreeMap<String, u32> = BTreeMap::new();
+
+        println!(
+            "{:>12} {:>10}  {:<20} {:>4}  {:<26} payload",
+            "time", "delta", "report", "len", "result"
+        );
+        let mut previous = None;
+        for entry in entries.iter() {
+            let delta = previous.map(|t: u32| entry.timestamp_us.wrapping_sub(t));
+            previous = Some(entry.timestamp_us);
+
+            let kind = entry.kind();
+            if let Some(last) = last_seen.insert(kind.clone(), entry.timestamp_us) {
+                intervals
+                    .entry(kind.clone())
+                    .or_default()
+                    .push(entry.timestamp_us.wrapping_sub(last));
+            }
+
+            let payload: Vec<String> = entry.payload.iter().map(|b| format!("{b:02x}")).collect();
+            println!(
+                "{:>12.6} {:>10}  {:<20} {:>4}  {:<26} {}",
+                entry.timestamp_us as f64 / 1_000_000.0,
+                delta
+                    .map(|d| format!("+{:.3}", millis(d)))
+                    .unwrap_or_default(),
+                kind,
+                entry.length,
+                entry.result_name(),
+                payload.join(" ")
+            );
+        }
+
+        if !intervals.is_empty() {
+            println!();
+            println!(
+                "{:<20} {:>6} {:>10} {:>10} {:>10}",
+                "report", "count", "min ms", "mean ms", "max ms"
+            );
+            for (kind, values) in intervals.iter() {
+                let min = values.iter().min().copied().unwrap_or_default();
+                let max = values.iter().max().copied().unwrap_or_default();
+                let mean = values.iter().map(|v| *v as u64).sum::<u64>() / values.len() as u64;
+                println!(
+                    "{:<20} {:>6} {:>10.3} {:>10.3} {:>10.3}",
+                    kind,
+                    values.len() + 1,
+                    millis(min),
+                    millis(mean as u32),
+                    millis(max)
+                );
+            }
+        }
+
+        if self.clear {
+            dev.send_report(Report::Recorder(device::RecorderRequest {
+                sequence: 0,
+                clear: true,
+            }))?;
+        }
+        Ok(())
+    }
+}
+
+#[derive(Args)]
+pub struct LatencyArgs {
+    /// The number of probes to send as each report type
+    #[arg(long, default_value_t = 200)]
+    count: u32,
+
+    /// The lamp whose output period is measured
+    #[arg(long = "lamp", value_name = "ID", default_value = "1")]
+    #[arg(value_parser = lamp_id_parser)]
+    lamp_id: u8,
+
+    /// The advertised update latency to compare against, in microseconds. This is
+    /// CFG_RGB_LAMP_UPDATE_LATENCY in the firmware.
+    #[arg(long, value_name = "US", default_value_t = 4000)]
+    limit: u32,
+}
+
+impl LatencyArgs {
+    fn run(&self, dev: &Device) -> Result<(), Box<dyn std::error::Error>> {
+        let start = Instant::now();
+        let now_us = || start.elapsed().as_micros() as u32;
+
+        // Host-to-light latency in microseconds for each path the device saw
+        let mut latencies: BTreeMap<String, Vec<u32>> = BTreeMap::new();
+        let mut timeouts = 0;
+        let mut sequence: u32 = 0;
+        for transport in [
+            device::LatencyTransport::Feature,
+            device::LatencyTransport::Output,
+        ] {
+            for _ in 0..self.count {
+                sequence = sequence.wrapping_add(1);
+                dev.send_report(Report::LatencyProbe(
+                    transport,
+                    device::LatencyProbe {
+                        sequence,
+                        host_timestamp: now_us(),
+                        lamp_id: self.lamp_id,
+                    },
+                ))?;
+
+                let result = match dev.read_latency_result(sequence) {
+                    Ok(result) => result,
+                    Err(device::Error::Timeout) => {
+                        timeouts += 1;
+                        continue;
+                    }
+                    Err(err) => return Err(err.into()),
+                };
+
+                // Assume the transfers to and from the device take the same time
+                let round_trip = now_us().wrapping_sub(result.host_timestamp);
+                let transfer = round_trip.saturating_sub(result.turnaround_us()) / 2;
+                latencies
+                    .entry(result.path_name())
+                    .or_default()
+                    .push(transfer + result.device_latency_us());
+            }
+        }
+
+        if timeouts > 0 {
+            eprintln!("warning: {timeouts} probes were not answered");
+        }
+
+        println!(
+            "{:<10} {:>6} {:>10} {:>10} {:>10} {:>6}",
+            "path", "count", "p50 ms", "p99 ms", "max ms", "over"
+        );
+        for (path, values) in latencies.iter_mut() {
+            values.sort_unstable();
+            let over = values.iter().filter(|v| **v > self.limit).count();
+            println!(
+                "{:<10} {:>6} {:>10.3} {:>10.3} {:>10.3} {:>6}",
+                path,
+                values.len(),
+                millis(percentile(values, 0.50)),
+                millis(percentile(values, 0.99)),
+                millis(values.last().copied().unwrap_or_default()),
+                over
+            );
+        }
+        println!();
+        println!("advertised: {:.3} ms", millis(self.limit));
+        Ok(())
+    }
+}
+
+/// Returns the value at fraction `q` of sorted `values`, or 0 if there are none
+fn percentile(values: &[u32], q: f64) -> u32 {
+    if values.is_empty() {
+        return 0;
+    }
+    let index = ((values.len() - 1) as f64 * q).round() as usize;
+    values[index]
+}
+
+/// Converts microseconds to milliseconds
+fn millis(micros: u32) -> f64 {
+    micros as f64 / 1000.0
+}
+
+fn yes_no(value: bool) -> &'static str {
+    if value {
+        "yes"
+    } else {
+        "no"
+    }
+}
+
+/// Converts milliwatts to watts
+fn watts(milliwatts: u32) -> f64 {
+    milliwatts as f64 / 1000.0
 }
 
 /// Parses a 1-indexed lamp/channel string to 0-indexed lamp ID
@@ -117,3 +667,19 @@ fn lamp_id_parser(value: &str) -> Result<u8, String> {
         ))
     }
 }
+
+/// Parses a 1-indexed scene string to 0-indexed scene ID
+fn scene_id_parser(value: &str) -> Result<u8, String> {
+    const RANGE: RangeInclusive<usize> = 1..=(device::SCENE_COUNT as usize);
+
+    let id: usize = value.parse().map_err(|_| "invalid scene number")?;
+    if RANGE.contains(&id) {
+        Ok((id - 1) as u8)
+    } else {
+        Err(format!(
+            "scene number must be in range {}-{}",
+            RANGE.start(),
+            RANGE.end()
+        ))
+    }
+}
@@ -36,20 +36,26 @@ pub enum Animation {
 
     /// Crossfade between multiple colors
     Fade(FadeArgs),
+
+    /// Show the controller temperature as a color from a gradient
+    ///
+    /// The gradient is defined by up to 8 stops, each a temperature in degrees Celsius and a
+    /// color, such as "--stop 30:blue --stop 60:red". Colors between stops are interpolated and
+    /// temperatures outside the stops use the color of the nearest stop.
+    Thermal(ThermalArgs),
 }
 
 impl Animation {
     pub fn run(&self, dev: &Device) -> Result<(), Box<dyn std::error::Error>> {
         match self {
-            Self::None(args) => dev
-                .send_report(Report::SetAnimation(
-                    args.mode(),
-                    device::SetAnimationReport {
-                        lamp_id: args.lamp_id,
-                        animation: device::Animation::None,
-                    },
-                ))
-                .map_err(From::from),
+            Self::None(args) => send_animation(
+                dev,
+                args.mode(),
+                device::SetAnimationReport {
+                    lamp_id: args.lamp_id,
+                    animation: device::Animation::None,
+                },
+            ),
 
             Self::Breathe(args) => {
                 const DEFAULT_ON_TIME: Time = Time(500);
@@ -64,7 +70,8 @@ impl Animation {
                     a: 1.0,
                 });
 
-                dev.send_report(Report::SetAnimation(
+                send_animation(
+                    dev,
                     args.shared.mode(),
                     device::SetAnimationReport {
                         lamp_id: args.shared.lamp_id,
@@ -77,8 +84,7 @@ impl Animation {
                             off_time_ms: args.off_time.unwrap_or(DEFAULT_OFF_TIME).0,
                         }),
                     },
-                ))
-                .map_err(From::from)
+                )
             }
 
             Self::Fade(args) => {
@@ -105,7 +111,8 @@ impl Animation {
                         .collect::<Vec<_>>(),
                 );
 
-                dev.send_report(Report::SetAnimation(
+                send_animation(
+                    dev,
                     args.shared.mode(),
                     device::SetAnimationReport {
                         lamp_id: args.shared.lamp_id,
@@ -116,13 +123,66 @@ impl Animation {
                             hold_time_ms: args.hold_time.unwrap_or(DEFAULT_HOLD_TIME).0,
                         }),
                     },
-                ))
-                .map_err(From::from)
+                )
+            }
+
+            Self::Thermal(args) => {
+                const MAX_STOPS: usize = device::ThermalAnimationData::MAX_STOPS;
+
+                let stop_count = args.stops.len();
+                if stop_count > MAX_STOPS {
+                    let mut err = cli::Root::command();
+                    err.error(
+                        clap::error::ErrorKind::TooManyValues,
+                        format!("The animation can use at most {} stops", MAX_STOPS),
+                    )
+                    .exit();
+                }
+
+                let mut sorted = args.stops.clone();
+                sorted.sort_by_key(|stop| stop.temperature);
+
+                let mut stops = [device::ThermalStop::zero(); MAX_STOPS];
+                stops[0..stop_count].copy_from_slice(&sorted);
+
+                send_animation(
+                    dev,
+                    args.shared.mode(),
+                    device::SetAnimationReport {
+                        lamp_id: args.shared.lamp_id,
+                        animation: device::Animation::Thermal(device::ThermalAnimationData {
+                            stop_count: stop_count as u8,
+                            stops,
+                            hysteresis: (args.hysteresis * 100.0).round() as u16,
+                            smoothing_ms: args.smoothing.0,
+                        }),
+                    },
+                )
             }
         }
     }
 }
 
+/// Sends an animation report. If the animation is saved as the default or in a scene, waits for the
+/// device to write it to flash.
+fn send_animation(
+    dev: &Device,
+    mode: device::SetAnimationMode,
+    report: device::SetAnimationReport,
+) -> Result<(), Box<dyn std::error::Error>> {
+    match mode {
+        device::SetAnimationMode::Default | device::SetAnimationMode::Scene(_) => {
+            let before = dev.read_persist_status()?;
+            dev.send_report(Report::SetAnimation(mode, report))?;
+            dev.wait_for_persist(&before)?;
+        }
+        device::SetAnimationMode::Current => {
+            dev.send_report(Report::SetAnimation(mode, report))?;
+        }
+    }
+    Ok(())
+}
+
 #[derive(Args)]
 pub struct BreatheArgs {
     #[command(flatten)]
@@ -186,6 +246,29 @@ pub struct FadeArgs {
     pub hold_time: Option<Time>,
 }
 
+#[derive(Args)]
+pub struct ThermalArgs {
+    #[command(flatten)]
+    pub shared: SharedArgs,
+
+    /// A gradient stop as TEMP:COLOR; repeat to set multiple stops.
+    ///
+    /// Colors are specified as CSS color strings. The alpha channel is ignored.
+    #[arg(long = "stop", value_name = "TEMP:COLOR", required = true)]
+    #[arg(value_parser = thermal_stop_parser)]
+    pub stops: Vec<device::ThermalStop>,
+
+    /// The change in degrees Celsius needed to change the color
+    #[arg(long, value_name = "DEGREES", default_value_t = 0.5)]
+    #[arg(value_parser = hysteresis_parser)]
+    pub hysteresis: f64,
+
+    /// The time constant of the temperature smoothing in fractional seconds
+    #[arg(long, value_name = "SECONDS", default_value = "2")]
+    #[arg(value_parser = animation_time_parser)]
+    pub smoothing: Time,
+}
+
 #[derive(Args)]
 pub struct SharedArgs {
     /// The lamp that will play this animation
@@ -196,11 +279,18 @@ pub struct SharedArgs {
     /// Save this animation in flash as the default for the lamp
     #[arg(long)]
     pub default: bool,
+
+    /// Save this animation in a scene instead of playing it now
+    #[arg(long = "scene", value_name = "ID", conflicts_with = "default")]
+    #[arg(value_parser = cli::scene_id_parser)]
+    pub scene_id: Option<u8>,
 }
 
 impl SharedArgs {
     fn mode(&self) -> device::SetAnimationMode {
-        if self.default {
+        if let Some(scene_id) = self.scene_id {
+            device::SetAnimationMode::Scene(scene_id)
+        } else if self.default {
             device::SetAnimationMode::Default
         } else {
             device::SetAnimationMode::Current
@@ -233,3 +323,43 @@ fn animation_time_parser(value: &str) -> Result<Time, String> {
         ))
     }
 }
+
+/// Parses a "TEMP:COLOR" gradient stop, where TEMP is in degrees Celsius.
+fn thermal_stop_parser(value: &str) -> Result<device::ThermalStop, String> {
+    const RANGE: RangeInclusive<f64> = -300.0..=300.0;
+
+    let (temperature, color) = value.split_once(':').ok_or("stop must be TEMP:COLOR")?;
+
+    let c: f64 = temperature
+        .parse()
+        .map_err(|_| "invalid stop temperature")?;
+    if !RANGE.contains(&c) {
+        return Err(format!(
+            "stop temperature must be between {} and {} degrees",
+            RANGE.start(),
+            RANGE.end()
+        ));
+    }
+
+    let color = csscolorparser::parse(color).map_err(|err| err.to_string())?;
+    Ok(device::ThermalStop {
+        temperature: (c * 100.0).round() as i16,
+        color: (&color).into(),
+    })
+}
+
+/// Parses a hysteresis value in degrees Celsius.
+fn hysteresis_parser(value: &str) -> Result<f64, String> {
+    const RANGE: RangeInclusive<f64> = 0.0..=100.0;
+
+    let c: f64 = value.parse().map_err(|_| "invalid hysteresis value")?;
+    if RANGE.contains(&c) {
+        Ok(c)
+    } else {
+        Err(format!(
+            "hysteresis must be between {} and {} degrees",
+            RANGE.start(),
+            RANGE.end()
+        ))
+    }
+}
@@ -0,0 +1,135 @@
+use clap::{Args, Subcommand};
+
+use crate::cli;
+use crate::device::{self, CalibrationAction, CalibrationCurve, Channel, Device, Report};
+
+#[derive(Subcommand)]
+pub enum Command {
+    /// Print the calibration curves of a lamp
+    Show(ShowArgs),
+
+    /// Set the calibration curve of a lamp channel
+    ///
+    /// The curve is given either as a gain and gamma, or as 17 output values for inputs evenly
+    /// spaced from 0 to 65535. Inputs are linear light output; the device decodes sRGB colors
+    /// before applying the curve.
+    Set(SetArgs),
+
+    /// Restore the uncalibrated curve of a lamp channel
+    Reset(ChannelArgs),
+}
+
+impl Command {
+    pub fn run(&self, dev: &Device) -> Result<(), Box<dyn std::error::Error>> {
+        match self {
+            Self::Show(args) => {
+                let channels = match args.channel {
+                    Some(channel) => vec![channel],
+                    None => Channel::ALL.to_vec(),
+                };
+                for channel in channels {
+                    let curve = dev.read_calibration(args.lamp_id, channel)?;
+                    let points: Vec<String> = curve.points.iter().map(|p| p.to_string()).collect();
+                    println!("{channel}: {}", points.join(","));
+                }
+                Ok(())
+            }
+
+            Self::Set(args) => {
+                let curve = match &args.points {
+                    Some(points) => CalibrationCurve {
+                        points: points.as_slice().try_into().map_err(|_| {
+                            format!("exactly {} points are required", CalibrationCurve::POINTS)
+                        })?,
+                    },
+                    None => CalibrationCurve::from_gain_gamma(args.gain, args.gamma),
+                };
+                let action = if args.preview {
+                    CalibrationAction::Preview
+                } else {
+                    CalibrationAction::Save
+                };
+                send_calibration(dev, args.lamp_id, args.channel, action, curve)
+            }
+
+            Self::Reset(args) => send_calibration(
+                dev,
+                args.lamp_id,
+                args.channel,
+                CalibrationAction::Reset,
+                CalibrationCurve::identity(),
+            ),
+        }
+    }
+}
+
+/// Sends a calibration action and waits for the device to write any changes to flash.
+fn send_calibration(
+    dev: &Device,
+    lamp_id: u8,
+    channel: Channel,
+    action: CalibrationAction,
+    curve: CalibrationCurve,
+) -> Result<(), Box<dyn std::error::Error>> {
+    let before = dev.read_persist_status()?;
+    dev.send_report(Report::Calibration(device::CalibrationReport {
+        lamp_id,
+        channel,
+        action,
+        curve,
+    }))?;
+    dev.wait_for_persist(&before)?;
+    Ok(())
+}
+
+#[derive(Args)]
+pub struct ShowArgs {
+    /// The lamp number
+    #[arg(long = "lamp", value_name = "ID")]
+    #[arg(value_parser = cli::lamp_id_parser)]
+    pub lamp_id: u8,
+
+    /// The channel to print: red, green, or blue. If unset, print all channels.
+    #[arg(long, value_parser = Channel::parse)]
+    pub channel: Option<Channel>,
+}
+
+#[derive(Args)]
+pub struct ChannelArgs {
+    /// The lamp number
+    #[arg(long = "lamp", value_name = "ID")]
+    #[arg(value_parser = cli::lamp_id_parser)]
+    pub lamp_id: u8,
+
+    /// The channel: red, green, or blue
+    #[arg(long, value_parser = Channel::parse)]
+    pub channel: Channel,
+}
+
+#[derive(Args)]
+pub struct SetArgs {
+    /// The lamp number
+    #[arg(long = "lamp", value_name = "ID")]
+    #[arg(value_parser = cli::lamp_id_parser)]
+    pub lamp_id: u8,
+
+    /// The channel: red, green, or blue
+    #[arg(long, value_parser = Channel::parse)]
+    pub channel: Channel,
+
+    /// The output at full input, from 0 to 1
+    #[arg(long, default_value_t = 1.0, conflicts_with = "points")]
+    pub gain: f64,
+
+    /// The exponent applied to the input before the gain
+    #[arg(long, default_value_t = 1.0, conflicts_with = "points")]
+    pub gamma: f64,
+
+    /// A comma-separated list of 17 output values
+    #[arg(long, value_delimiter = ',')]
+    pub points: Option<Vec<u16>>,
+
+    /// Use the curve until the device restarts without saving it to flash
+    #[arg(long)]
+    pub preview: bool,
+}
@@ -0,0 +1,169 @@
+use clap::{Args, Subcommand};
+
+use crate::cli;
+use crate::device::{self, Device, Report};
+
+#[derive(Subcommand)]
+pub enum Command {
+    /// List saved scenes
+    List,
+
+    /// Switch to a scene now
+    Activate(SceneArgs),
+
+    /// Set the name of a scene
+    Rename(RenameArgs),
+
+    /// Remove a scene's name and animations
+    Delete(SceneArgs),
+
+    /// Print the scene for each event and the temperature thresholds
+    Rules,
+
+    /// Set the scene for an event
+    ///
+    /// Events are: suspend, resume, temperature-high, temperature-normal, host-update, and
+    /// disconnect. If no scene is given, the event does not change the scene.
+    Rule(RuleArgs),
+
+    /// Set the temperature thresholds for the temperature-high and temperature-normal events
+    Thresholds(ThresholdsArgs),
+}
+
+impl Command {
+    pub fn run(&self, dev: &Device) -> Result<(), Box<dyn std::error::Error>> {
+        match self {
+            Self::List => {
+                for scene_id in 0..device::SCENE_COUNT {
+                    let scene = dev.read_scene(scene_id)?;
+                    if !scene.saved {
+                        continue;
+                    }
+                    println!(
+                        "{}: {}{}",
+                        scene.scene_id + 1,
+                        scene.name,
+                        if scene.active { " (active)" } else { "" }
+                    );
+                }
+                Ok(())
+            }
+
+            Self::Activate(args) => {
+                send_scene(dev, args.scene_id, device::SceneAction::Activate, "")
+            }
+
+            Self::Rename(args) => {
+                if args.name.len() > device::SceneReport::NAME_SIZE {
+                    return Err(format!(
+                        "scene name must be at most {} bytes",
+                        device::SceneReport::NAME_SIZE
+                    )
+                    .into());
+                }
+                send_scene(dev, args.scene_id, device::SceneAction::Rename, &args.name)
+            }
+
+            Self::Delete(args) => send_scene(dev, args.scene_id, device::SceneAction::Delete, ""),
+
+            Self::Rules => {
+                let rules = dev.read_scene_rules()?;
+                for event in device::SceneEvent::ALL {
+                    match rules.scenes[event.index()] {
+                        Some(scene_id) => println!("{event}: {}", scene_id + 1),
+                        None => println!("{event}: none"),
+                    }
+                }
+                println!("temperature-high threshold: {:.2}", rules.temperature_high);
+                println!(
+                    "temperature-normal threshold: {:.2}",
+                    rules.temperature_normal
+                );
+                Ok(())
+            }
+
+            Self::Rule(args) => {
+                let mut rules = dev.read_scene_rules()?;
+                rules.scenes[args.event.index()] = args.scene_id;
+                send_rules(dev, rules)
+            }
+
+            Self::Thresholds(args) => {
+                if args.normal >= args.high {
+                    return Err("normal threshold must be below the high threshold".into());
+                }
+                let mut rules = dev.read_scene_rules()?;
+                rules.temperature_high = args.high;
+                rules.temperature_normal = args.normal;
+                send_rules(dev, rules)
+            }
+        }
+    }
+}
+
+/// Sends a scene action and waits for the device to write any changes to flash.
+fn send_scene(
+    dev: &Device,
+    scene_id: u8,
+    action: device::SceneAction,
+    name: &str,
+) -> Result<(), Box<dyn std::error::Error>> {
+    let before = dev.read_persist_status()?;
+    dev.send_report(Report::Scene(device::SceneReport {
+        scene_id,
+        action,
+        name: name.to_string(),
+    }))?;
+    dev.wait_for_persist(&before)?;
+    Ok(())
+}
+
+/// Sends the rule table and waits for the device to write it to flash.
+fn send_rules(dev: &Device, rules: device::SceneRules) -> Result<(), Box<dyn std::error::Error>> {
+    let before = dev.read_persist_status()?;
+    dev.send_report(Report::SceneRules(rules))?;
+    dev.wait_for_persist(&before)?;
+    Ok(())
+}
+
+#[derive(Args)]
+pub struct SceneArgs {
+    /// The scene number
+    #[arg(long = "scene", value_name = "ID")]
+    #[arg(value_parser = cli::scene_id_parser)]
+    pub scene_id: u8,
+}
+
+#[derive(Args)]
+pub struct RenameArgs {
+    /// The scene number
+    #[arg(long = "scene", value_name = "ID")]
+    #[arg(value_parser = cli::scene_id_parser)]
+    pub scene_id: u8,
+
+    /// The new name, up to 16 bytes
+    pub name: String,
+}
+
+#[derive(Args)]
+pub struct RuleArgs {
+    /// The event that switches scenes
+    #[arg(value_parser = device::SceneEvent::parse)]
+    pub event: device::SceneEvent,
+
+    /// The scene to switch to. If unset, the event does not change the scene.
+    #[arg(long = "scene", value_name = "ID")]
+    #[arg(value_parser = cli::scene_id_parser)]
+    pub scene_id: Option<u8>,
+}
+
+#[derive(Args)]
+pub struct ThresholdsArgs {
+    /// Switch to the temperature-high scene at this temperature, in degrees Celsius
+    #[arg(long)]
+    pub high: f64,
+
+    /// Switch to the temperature-normal scene at this temperature, in degrees Celsius
+    #[arg(long)]
+    pub normal: f64,
+}
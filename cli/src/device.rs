@@ -1,4 +1,4 @@
-use std::{error, fmt, io::Write};
+use std::{error, fmt, io::Write, thread, time::Duration, time::Instant};
 
 #[cfg_attr(unix, path = "device/unix.rs")]
 #[cfg_attr(windows, path = "device/windows.rs")]
@@ -25,6 +25,12 @@ pub enum Error {
     /// could not be found.
     NotFound,
 
+    /// Indicates that the device did not finish an operation in time.
+    Timeout,
+
+    /// Indicates that the device could not save settings to flash.
+    PersistFailed,
+
     /// Wraps an error from the platform-specific USB backend.
     Backend(Box<dyn error::Error>),
 }
@@ -33,6 +39,8 @@ impl fmt::Display for Error {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> Result<(), fmt::Error> {
         match self {
             Self::NotFound => write!(f, "device not found"),
+            Self::Timeout => write!(f, "timed out waiting for device"),
+            Self::PersistFailed => write!(f, "device failed to save settings"),
             Self::Backend(err) => write!(f, "system error: {err}"),
         }
     }
@@ -41,7 +49,7 @@ impl fmt::Display for Error {
 impl error::Error for Error {
     fn cause(&self) -> Option<&dyn error::Error> {
         match self {
-            Self::NotFound => None,
+            Self::NotFound | Self::Timeout | Self::PersistFailed => None,
             Self::Backend(err) => Some(err.as_ref()),
         }
     }
@@ -65,6 +73,99 @@ impl Device {
     pub fn read_temperature(&self) -> Result<f64, Error> {
         self.d.read_temperature()
     }
+
+    /// Waits for the next batch of temperature samples. Batching must first be enabled by sending
+    /// a `Report::TemperatureBatchConfig`.
+    pub fn read_temperature_batch(&self) -> Result<TemperatureBatch, Error> {
+        self.d.read_temperature_batch()
+    }
+
+    pub fn read_persist_status(&self) -> Result<PersistStatus, Error> {
+        self.d.read_persist_status()
+    }
+
+    pub fn read_power_status(&self) -> Result<PowerStatus, Error> {
+        self.d.read_power_status()
+    }
+
+    pub fn read_scene(&self, scene_id: u8) -> Result<SceneInfo, Error> {
+        self.d.read_scene(scene_id)
+    }
+
+    pub fn read_scene_rules(&self) -> Result<SceneRules, Error> {
+        self.d.read_scene_rules()
+    }
+
+    pub fn read_calibration(
+        &self,
+        lamp_id: u8,
+        channel: Channel,
+    ) -> Result<CalibrationCurve, Error> {
+        self.d.read_calibration(lamp_id, channel)
+    }
+
+    pub fn read_stats(&self, page: u8) -> Result<StatsPage, Error> {
+        self.d.read_stats(page)
+    }
+
+    pub fn read_memory_status(&self) -> Result<MemoryStatus, Error> {
+        self.d.read_memory_status()
+    }
+
+    pub fn read_status(&self) -> Result<ControllerStatus, Error> {
+        self.d.read_status()
+    }
+
+    /// Reads the recorded reports starting at `sequence`, or at the oldest recorded report if
+    /// that is later.
+    pub fn read_recorder(&self, sequence: u32) -> Result<RecorderPage, Error> {
+        self.d.read_recorder(sequence)
+    }
+
+    /// Waits for the next batch of trace events. The stream must first be enabled by sending a
+    /// `Report::TraceConfig`.
+    pub fn read_trace_batch(&self) -> Result<TraceBatch, Error> {
+        self.d.read_trace_batch()
+    }
+
+    /// Waits for the next batch of events. The host must first subscribe to events by sending a
+    /// `Report::EventsConfig`.
+    pub fn read_event_batch(&self) -> Result<EventBatch, Error> {
+        self.d.read_event_batch()
+    }
+
+    /// Waits for the result of the latency probe with the given sequence number, skipping the
+    /// results of earlier probes.
+    pub fn read_latency_result(&self, sequence: u32) -> Result<LatencyResult, Error> {
+        loop {
+            let result = self.d.read_latency_result()?;
+            if result.sequence == sequence {
+                return Ok(result);
+            }
+        }
+    }
+
+    /// Waits for the device to write all queued settings to flash. `before` is the status read
+    /// before sending the settings and is used to detect writes that failed.
+    pub fn wait_for_persist(&self, before: &PersistStatus) -> Result<(), Error> {
+        const POLL_INTERVAL: Duration = Duration::from_millis(10);
+        const TIMEOUT: Duration = Duration::from_secs(5);
+
+        let start = Instant::now();
+        loop {
+            let status = self.read_persist_status()?;
+            if status.failed_writes != before.failed_writes {
+                return Err(Error::PersistFailed);
+            }
+            if status.is_idle() {
+                return Ok(());
+            }
+            if start.elapsed() > TIMEOUT {
+                return Err(Error::Timeout);
+            }
+            thread::sleep(POLL_INTERVAL);
+        }
+    }
 }
 
 pub enum Report {
@@ -73,6 +174,15 @@ pub enum Report {
     LampArrayControl(LampArrayControlReport),
     Reset(ResetFlags),
     SetAnimation(SetAnimationMode, SetAnimationReport),
+    Scene(SceneReport),
+    SceneRules(SceneRules),
+    TemperatureBatchConfig(TemperatureBatchConfig),
+    Calibration(CalibrationReport),
+    Stats(StatsRequest),
+    TraceConfig(TraceConfig),
+    Recorder(RecorderRequest),
+    LatencyProbe(LatencyTransport, LatencyProbe),
+    EventsConfig(EventsConfig),
 }
 
 impl Report {
@@ -82,7 +192,17 @@ impl Report {
             Self::LampArrayRangeUpdate(_) => 0x05,
             Self::LampArrayControl(_) => 0x06,
             Self::Reset(_) => 0x30,
+            Self::SetAnimation(SetAnimationMode::Scene(_), _) => 0x33,
             Self::SetAnimation(_, _) => 0x31,
+            Self::Scene(_) => SceneReport::REPORT_ID,
+            Self::SceneRules(_) => SceneRules::REPORT_ID,
+            Self::TemperatureBatchConfig(_) => TemperatureBatch::REPORT_ID,
+            Self::Calibration(_) => CalibrationReport::REPORT_ID,
+            Self::Stats(_) => StatsPage::REPORT_ID,
+            Self::TraceConfig(_) => TraceBatch::REPORT_ID,
+            Self::Recorder(_) => RecorderPage::REPORT_ID,
+            Self::LatencyProbe(_, _) => LatencyResult::REPORT_ID,
+            Self::EventsConfig(_) => EventBatch::REPORT_ID,
         }
     }
 }
@@ -150,6 +270,7 @@ impl From<&ResetFlags> for u8 {
 pub enum SetAnimationMode {
     Default,
     Current,
+    Scene(u8),
 }
 
 #[derive(Debug)]
@@ -157,16 +278,28 @@ pub enum Animation {
     None,
     Breathe(BreatheAnimationData),
     Fade(FadeAnimationData),
+    Thermal(ThermalAnimationData),
 }
 
 impl Animation {
     pub const DATA_SIZE: usize = 60;
 
+    const TYPE_NAMES: [&'static str; 4] = ["none", "breathe", "fade", "thermal"];
+
+    /// Returns the name of an animation type byte.
+    pub fn type_name(value: u8) -> String {
+        Self::TYPE_NAMES
+            .get(value as usize)
+            .map(|name| name.to_string())
+            .unwrap_or_else(|| format!("type {value}"))
+    }
+
     pub fn type_byte(&self) -> u8 {
         match self {
             Self::None => 0x00,
             Self::Breathe(_) => 0x01,
             Self::Fade(_) => 0x02,
+            Self::Thermal(_) => 0x03,
         }
     }
 
@@ -190,6 +323,16 @@ impl Animation {
                 b.write_all(&data.fade_time_ms.to_le_bytes())?;
                 b.write_all(&data.hold_time_ms.to_le_bytes())
             }),
+
+            Self::Thermal(ref data) => Self::write_data(|b| {
+                b.write_all(&data.stop_count.to_le_bytes())?;
+                for stop in data.stops.iter() {
+                    b.write_all(&stop.temperature.to_le_bytes())?;
+                    b.write_all(&<[u8; 3]>::from(&stop.color))?;
+                }
+                b.write_all(&data.hysteresis.to_le_bytes())?;
+                b.write_all(&data.smoothing_ms.to_le_bytes())
+            }),
         }
     }
 
@@ -226,6 +369,930 @@ impl FadeAnimationData {
     pub const MAX_COLORS: usize = 8;
 }
 
+#[derive(Debug)]
+pub struct ThermalAnimationData {
+    pub stop_count: u8,
+    pub stops: [ThermalStop; ThermalAnimationData::MAX_STOPS],
+    /// The change needed to update the color, in hundredths of a degree Celsius
+    pub hysteresis: u16,
+    pub smoothing_ms: u16,
+}
+
+impl ThermalAnimationData {
+    pub const MAX_STOPS: usize = 8;
+}
+
+#[derive(Debug, Copy, Clone)]
+pub struct ThermalStop {
+    /// The temperature in hundredths of a degree Celsius
+    pub temperature: i16,
+    pub color: RGB,
+}
+
+impl ThermalStop {
+    pub fn zero() -> Self {
+        ThermalStop {
+            temperature: 0,
+            color: RGB::zero(),
+        }
+    }
+}
+
+/// The state of settings waiting to be saved to flash.
+#[derive(Debug)]
+pub struct PersistStatus {
+    pub pending_writes: u8,
+    pub pending_erases: u8,
+    pub failed_writes: u16,
+    pub completed_writes: u16,
+}
+
+impl PersistStatus {
+    pub const REPORT_ID: u8 = 0x32;
+
+    pub fn is_idle(&self) -> bool {
+        self.pending_writes == 0 && self.pending_erases == 0
+    }
+}
+
+/// The estimated load of the lamps and the dimming applied to stay within the power budget. Loads
+/// are in milliwatts.
+#[derive(Debug)]
+pub struct PowerStatus {
+    /// The load of each lamp after dimming
+    pub lamp_loads: Vec<u16>,
+    /// The total load before dimming
+    pub requested_load: u32,
+    /// The total load after dimming
+    pub total_load: u32,
+    /// The budget at the current temperature, or 0 if unlimited
+    pub budget: u32,
+    /// The brightness of all lamps, from 0 to 1
+    pub scale: f64,
+    /// The lowest temperature since startup in degrees Celsius
+    pub min_temperature: f64,
+    /// The highest temperature since startup in degrees Celsius
+    pub max_temperature: f64,
+}
+
+impl PowerStatus {
+    pub const REPORT_ID: u8 = 0x37;
+    pub const SCALE_MAX: u16 = 10000;
+}
+
+/// The state of one lamp.
+#[derive(Debug)]
+pub struct LampStatus {
+    /// The sRGB color last committed to the lamp, scaled to 16 bits, before calibration and dimming
+    pub red: u16,
+    pub green: u16,
+    pub blue: u16,
+    pub intensity: u8,
+    pub animation_type: u8,
+    pub animation_stage: u8,
+    pub animation_frame: u32,
+    /// The type of the animation saved as the lamp's default, if any
+    pub default_animation_type: Option<u8>,
+}
+
+/// A snapshot of the controller state.
+#[derive(Debug)]
+pub struct ControllerStatus {
+    /// Whether the built-in animations control the lamps instead of the host
+    pub autonomous: bool,
+    /// Whether the lamps are off because the host suspended the device
+    pub suspended: bool,
+    /// Whether lamp colors set by the host are saved to restore after a reset
+    pub checkpoint_saved: bool,
+    pub lamps: Vec<LampStatus>,
+    /// The time from reset to the first lamp update that turned a lamp on, in microseconds, or
+    /// `None` if no lamp has been on yet
+    pub first_light_us: Option<u32>,
+}
+
+impl ControllerStatus {
+    pub const REPORT_ID: u8 = 0x3E;
+    pub const NO_DEFAULT: u8 = 0xFF;
+
+    const FLAG_AUTONOMOUS: u8 = 1 << 0;
+    const FLAG_SUSPENDED: u8 = 1 << 1;
+    const FLAG_CHECKPOINT_SAVED: u8 = 1 << 2;
+
+    pub fn from_report(flags: u8, lamps: Vec<LampStatus>, first_light_us: u32) -> Self {
+        ControllerStatus {
+            autonomous: flags & Self::FLAG_AUTONOMOUS != 0,
+            suspended: flags & Self::FLAG_SUSPENDED != 0,
+            checkpoint_saved: flags & Self::FLAG_CHECKPOINT_SAVED != 0,
+            lamps,
+            first_light_us: Some(first_light_us).filter(|us| *us != 0),
+        }
+    }
+}
+
+/// The number of scenes the device can store.
+pub const SCENE_COUNT: u8 = 8;
+
+#[derive(Debug, Copy, Clone)]
+pub enum SceneAction {
+    Select,
+    Activate,
+    Rename,
+    Delete,
+}
+
+impl From<SceneAction> for u8 {
+    fn from(value: SceneAction) -> Self {
+        match value {
+            SceneAction::Select => 0x00,
+            SceneAction::Activate => 0x01,
+            SceneAction::Rename => 0x02,
+            SceneAction::Delete => 0x03,
+        }
+    }
+}
+
+#[derive(Debug)]
+pub struct SceneReport {
+    pub scene_id: u8,
+    pub action: SceneAction,
+    pub name: String,
+}
+
+impl SceneReport {
+    pub const REPORT_ID: u8 = 0x34;
+    pub const NAME_SIZE: usize = 16;
+
+    /// Returns the name as a zero-padded byte array, truncating it if it is too long.
+    pub fn name_bytes(&self) -> [u8; Self::NAME_SIZE] {
+        let mut name = [0; Self::NAME_SIZE];
+        let len = self.name.len().min(Self::NAME_SIZE);
+        name[..len].copy_from_slice(&self.name.as_bytes()[..len]);
+        name
+    }
+}
+
+/// A saved scene, as reported by the device.
+#[derive(Debug)]
+pub struct SceneInfo {
+    pub scene_id: u8,
+    pub saved: bool,
+    pub active: bool,
+    pub name: String,
+}
+
+impl SceneInfo {
+    const FLAG_SAVED: u8 = 1 << 0;
+    const FLAG_ACTIVE: u8 = 1 << 1;
+
+    pub fn from_report(scene_id: u8, flags: u8, name: &[u8]) -> Self {
+        let len = name.iter().position(|&c| c == 0).unwrap_or(name.len());
+        SceneInfo {
+            scene_id,
+            saved: flags & Self::FLAG_SAVED != 0,
+            active: flags & Self::FLAG_ACTIVE != 0,
+            name: String::from_utf8_lossy(&name[..len]).into_owned(),
+        }
+    }
+}
+
+/// Device events that can switch scenes, in rule table order.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum SceneEvent {
+    Suspend,
+    Resume,
+    TemperatureHigh,
+    TemperatureNormal,
+    HostUpdate,
+    Disconnect,
+}
+
+impl fmt::Display for SceneEvent {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> Result<(), fmt::Error> {
+        match self {
+            Self::Suspend => write!(f, "suspend"),
+            Self::Resume => write!(f, "resume"),
+            Self::TemperatureHigh => write!(f, "temperature-high"),
+            Self::TemperatureNormal => write!(f, "temperature-normal"),
+            Self::HostUpdate => write!(f, "host-update"),
+            Self::Disconnect => write!(f, "disconnect"),
+        }
+    }
+}
+
+impl SceneEvent {
+    pub const ALL: [SceneEvent; 6] = [
+        Self::Suspend,
+        Self::Resume,
+        Self::TemperatureHigh,
+        Self::TemperatureNormal,
+        Self::HostUpdate,
+        Self::Disconnect,
+    ];
+
+    pub fn parse(s: &str) -> Result<Self, String> {
+        let e = s.to_lowercase().replace('_', "-");
+        Self::ALL
+            .into_iter()
+            .find(|event| event.to_string() == e)
+            .ok_or_else(|| "invalid scene event".to_string())
+    }
+
+    /// Returns the position of the event in the rule table.
+    pub fn index(&self) -> usize {
+        *self as usize
+    }
+}
+
+/// The table mapping events to scenes. Temperatures are in degrees Celsius.
+#[derive(Debug)]
+pub struct SceneRules {
+    pub scenes: [Option<u8>; SceneEvent::ALL.len()],
+    pub temperature_high: f64,
+    pub temperature_normal: f64,
+}
+
+impl SceneRules {
+    pub const REPORT_ID: u8 = 0x35;
+
+    /// The scene ID used by the device for events with no scene.
+    pub const NO_SCENE: u8 = 0xFF;
+
+    /// The device reports temperatures in hundredths of a degree.
+    pub const TEMPERATURE_SCALE: f64 = 100.0;
+
+    pub fn scene_bytes(&self) -> [u8; SceneEvent::ALL.len()] {
+        self.scenes.map(|s| s.unwrap_or(Self::NO_SCENE))
+    }
+}
+
+/// Configures batched temperature samples. A batch size of 0 disables batching.
+#[derive(Debug)]
+pub struct TemperatureBatchConfig {
+    pub batch_size: u8,
+    pub sample_interval_ms: u16,
+    pub max_latency_ms: u16,
+}
+
+#[derive(Debug)]
+pub struct TemperatureSample {
+    /// The time the sample was taken, in milliseconds since the device started.
+    pub timestamp_ms: u32,
+    pub celsius: f64,
+}
+
+#[derive(Debug)]
+pub struct TemperatureBatch {
+    /// The number of samples lost since the previous batch because it was not read in time.
+    pub dropped_samples: u8,
+    pub samples: Vec<TemperatureSample>,
+}
+
+impl TemperatureBatch {
+    pub const REPORT_ID: u8 = 0x36;
+    pub const MAX_SAMPLES: u8 = 14;
+}
+
+/// A color channel of a lamp.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum Channel {
+    Red,
+    Green,
+    Blue,
+}
+
+impl fmt::Display for Channel {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> Result<(), fmt::Error> {
+        match self {
+            Self::Red => write!(f, "red"),
+            Self::Green => write!(f, "green"),
+            Self::Blue => write!(f, "blue"),
+        }
+    }
+}
+
+impl Channel {
+    pub const ALL: [Channel; 3] = [Self::Red, Self::Green, Self::Blue];
+
+    pub fn parse(s: &str) -> Result<Self, String> {
+        let c = s.to_lowercase();
+        Self::ALL
+            .into_iter()
+            .find(|channel| channel.to_string() == c)
+            .ok_or_else(|| "channel must be red, green, or blue".to_string())
+    }
+}
+
+impl From<Channel> for u8 {
+    fn from(value: Channel) -> Self {
+        value as u8
+    }
+}
+
+#[derive(Debug, Copy, Clone)]
+pub enum CalibrationAction {
+    Select,
+    Preview,
+    Save,
+    Reset,
+}
+
+impl From<CalibrationAction> for u8 {
+    fn from(value: CalibrationAction) -> Self {
+        match value {
+            CalibrationAction::Select => 0x00,
+            CalibrationAction::Preview => 0x01,
+            CalibrationAction::Save => 0x02,
+            CalibrationAction::Reset => 0x03,
+        }
+    }
+}
+
+/// Maps linear light output to PWM duty for one channel of one lamp. Points are evenly spaced over
+/// the 16-bit input range. The device combines the curve with sRGB decoding into a table with one
+/// duty for each 8-bit color level.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct CalibrationCurve {
+    pub points: [u16; CalibrationCurve::POINTS],
+}
+
+impl CalibrationCurve {
+    pub const POINTS: usize = 17;
+
+    /// The input value of each point, except that the last point is clamped to `u16::MAX`.
+    const SPACING: u32 = 1 << 12;
+
+    /// Returns the curve that leaves colors unchanged.
+    pub fn identity() -> Self {
+        Self::from_fn(|x| x)
+    }
+
+    /// Returns a curve that scales the output by `gain` after applying `gamma` to the input.
+    /// Both are relative to the full-scale value, so a gain of 1 and gamma of 1 is the identity.
+    pub fn from_gain_gamma(gain: f64, gamma: f64) -> Self {
+        Self::from_fn(|x| gain * x.powf(gamma))
+    }
+
+    /// Builds a curve by sampling `f`, which maps inputs in [0, 1] to outputs in [0, 1].
+    fn from_fn<F: Fn(f64) -> f64>(f: F) -> Self {
+        let mut points = [0; Self::POINTS];
+        for (i, point) in points.iter_mut().enumerate() {
+            let x = (i as u32 * Self::SPACING).min(u16::MAX as u32) as f64 / u16::MAX as f64;
+            *point = (f(x).clamp(0.0, 1.0) * u16::MAX as f64).round() as u16;
+        }
+        CalibrationCurve { points }
+    }
+}
+
+#[derive(Debug)]
+pub struct CalibrationReport {
+    pub lamp_id: u8,
+    pub channel: Channel,
+    pub action: CalibrationAction,
+    pub curve: CalibrationCurve,
+}
+
+impl CalibrationReport {
+    pub const REPORT_ID: u8 = 0x38;
+}
+
+/// Selects the stats page returned by the next read, optionally clearing all stats first.
+#[derive(Debug)]
+pub struct StatsRequest {
+    pub page: u8,
+    pub reset: bool,
+}
+
+impl StatsRequest {
+    const FLAG_RESET: u8 = 1 << 0;
+
+    pub fn flags(&self) -> u8 {
+        if self.reset {
+            Self::FLAG_RESET
+        } else {
+            0
+        }
+    }
+}
+
+/// The timing of one firmware stage, plus the event counters. Durations are in microseconds.
+#[derive(Debug)]
+pub struct StatsPage {
+    pub page: u8,
+    pub page_count: u8,
+    pub count: u32,
+    pub mean_us: u32,
+    pub max_us: u32,
+    /// Bucket 0 counts durations below 2^`HISTOGRAM_SHIFT` microseconds, and each following bucket is
+    /// twice as wide. The last bucket also counts all longer durations.
+    pub histogram: Vec<u16>,
+    /// Event counts, in the order of `COUNTER_NAMES`
+    pub counters: Vec<u16>,
+}
+
+impl StatsPage {
+    pub const REPORT_ID: u8 = 0x39;
+    pub const BUCKETS: usize = 16;
+    pub const HISTOGRAM_SHIFT: u32 = 0;
+
+    /// The name of the stage on each page
+    pub const TIMER_NAMES: [&'static str; 28] = [
+        "tud_task",
+        "ctrl_task",
+        "animation frame",
+        "temperature_task",
+        "ctrl_sensor_task",
+        "ctrl_scene_task",
+        "ctrl_persist_task",
+        "ctrl_warmboot_task",
+        "trace_task",
+        "latency_task",
+        "events_task",
+        "set lamp attributes request",
+        "set lamp multi update",
+        "set lamp range update",
+        "set lamp array control",
+        "set temperature",
+        "set reset",
+        "set animation",
+        "set scene lamp",
+        "set scene",
+        "set scene rules",
+        "set sensor batch",
+        "set calibration",
+        "set stats",
+        "set trace",
+        "set recorder",
+        "set latency",
+        "set events",
+    ];
+
+    pub const COUNTER_NAMES: [&'static str; 8] = [
+        "frame overruns",
+        "dropped updates",
+        "rejected reports (size)",
+        "rejected reports (invalid)",
+        "rejected reports (autonomous mode)",
+        "rejected reports (unknown)",
+        "flash stalls",
+        "rejected reports (flash busy)",
+    ];
+
+    /// Returns the name of the stage on this page.
+    pub fn name(&self) -> String {
+        Self::TIMER_NAMES
+            .get(self.page as usize)
+            .map(|name| name.to_string())
+            .unwrap_or_else(|| format!("stage {}", self.page))
+    }
+
+    /// Returns the lowest duration counted by a histogram bucket, in microseconds.
+    pub fn bucket_start(bucket: usize) -> u32 {
+        match bucket {
+            0 => 0,
+            _ => 1 << (Self::HISTOGRAM_SHIFT + bucket as u32 - 1),
+        }
+    }
+}
+
+/// RAM usage in bytes. Peaks are the most used since the device started.
+#[derive(Debug)]
+pub struct MemoryStatus {
+    pub data_size: u32,
+    pub bss_size: u32,
+    pub heap_size: u32,
+    pub heap_peak: u32,
+    pub heap_used: u32,
+    pub heap_free: u32,
+    /// The stack size of each core, or 0 if the core has no stack
+    pub stack_sizes: Vec<u16>,
+    pub stack_peaks: Vec<u16>,
+}
+
+impl MemoryStatus {
+    pub const REPORT_ID: u8 = 0x3A;
+    pub const CORES: usize = 2;
+}
+
+/// Enables or disables the stream of trace events from the device.
+#[derive(Debug)]
+pub struct TraceConfig {
+    pub stream: bool,
+}
+
+impl TraceConfig {
+    const FLAG_STREAM: u8 = 1 << 0;
+
+    pub fn flags(&self) -> u8 {
+        if self.stream {
+            Self::FLAG_STREAM
+        } else {
+            0
+        }
+    }
+}
+
+/// One diagnostic event recorded by the device. The meaning of the arguments depends on the
+/// event; `Display` decodes them.
+#[derive(Debug)]
+pub struct TraceEntry {
+    /// The time the event was recorded, in microseconds since the device started. This wraps
+    /// every 71 minutes.
+    pub timestamp_us: u32,
+    pub event: u8,
+    pub arg8: u8,
+    pub arg16: u16,
+    pub arg32: u32,
+}
+
+impl TraceEntry {
+    /// The name of each event, indexed by event ID
+    pub const EVENT_NAMES: [&'static str; 10] = [
+        "boot",
+        "get input",
+        "get feature",
+        "set output",
+        "set feature",
+        "frame overrun",
+        "flash stall",
+        "suspend",
+        "resume",
+        "clock mode",
+    ];
+
+    /// The name of each system clock mode, indexed by mode
+    const CLOCK_MODE_NAMES: [&'static str; 3] = ["full", "reduced", "sleep"];
+
+    const EVENT_BOOT: u8 = 0;
+    const EVENT_SET_FEATURE: u8 = 4;
+    const EVENT_FRAME_OVERRUN: u8 = 5;
+    const EVENT_FLASH_STALL: u8 = 6;
+    const EVENT_SUSPEND: u8 = 7;
+    const EVENT_CLOCK_MODE: u8 = 9;
+
+    fn clock_mode_name(mode: u16) -> String {
+        Self::CLOCK_MODE_NAMES
+            .get(mode as usize)
+            .map(|name| name.to_string())
+            .unwrap_or_else(|| format!("mode {mode}"))
+    }
+}
+
+impl fmt::Display for TraceEntry {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> Result<(), fmt::Error> {
+        let Some(name) = Self::EVENT_NAMES.get(self.event as usize) else {
+            return write!(
+                f,
+                "event {}: {:#04x} {} {:#010x}",
+                self.event, self.arg8, self.arg16, self.arg32
+            );
+        };
+
+        match self.event {
+            Self::EVENT_BOOT if self.arg8 != 0 => write!(f, "{name} (warm)"),
+            Self::EVENT_SUSPEND if self.arg8 != 0 => write!(f, "{name} (lamps on)"),
+            1..=Self::EVENT_SET_FEATURE => {
+                // The device records up to the first four bytes of the report
+                let len = (self.arg16 as usize).min(4);
+                let bytes: Vec<String> = self.arg32.to_le_bytes()[..len]
+                    .iter()
+                    .map(|b| format!("{b:02x}"))
+                    .collect();
+                write!(
+                    f,
+                    "{name} {:#04x}, {} bytes: {}",
+                    self.arg8,
+                    self.arg16,
+                    bytes.join(" ")
+                )
+            }
+            Self::EVENT_FRAME_OVERRUN => write!(f, "{name}: {} frames skipped", self.arg32),
+            Self::EVENT_FLASH_STALL => write!(f, "{name}: {} us", self.arg32),
+            Self::EVENT_CLOCK_MODE => write!(
+                f,
+                "{name}: {} -> {} ({} ms in {} since start)",
+                Self::clock_mode_name(self.arg16),
+                Self::clock_mode_name(self.arg8 as u16),
+                self.arg32,
+                Self::clock_mode_name(self.arg16)
+            ),
+            _ => write!(f, "{name}"),
+        }
+    }
+}
+
+#[derive(Debug)]
+pub struct TraceBatch {
+    /// The number of events lost since the previous batch because the device's buffer filled up.
+    pub dropped_entries: u8,
+    pub entries: Vec<TraceEntry>,
+}
+
+impl TraceBatch {
+    pub const REPORT_ID: u8 = 0x3B;
+    pub const MAX_ENTRIES: u8 = 5;
+}
+
+/// Selects the first recorded report returned by the next read, optionally clearing the recorder
+/// first.
+#[derive(Debug)]
+pub struct RecorderRequest {
+    pub sequence: u32,
+    pub clear: bool,
+}
+
+impl RecorderRequest {
+    const FLAG_CLEAR: u8 = 1 << 0;
+
+    pub fn flags(&self) -> u8 {
+        if self.clear {
+            Self::FLAG_CLEAR
+        } else {
+            0
+        }
+    }
+}
+
+/// A report the device received or returned.
+#[derive(Debug)]
+pub struct RecorderEntry {
+    pub sequence: u32,
+    /// The time the device finished handling the report, in microseconds since it started. This
+    /// wraps every 71 minutes.
+    pub timestamp_us: u32,
+    /// Set for reports sent by the host, clear for reports returned by the device
+    pub is_set: bool,
+    pub report_type: u8,
+    pub report_id: u8,
+    pub result: u8,
+    /// The full length of the report
+    pub length: u16,
+    /// The start of the report, up to `RecorderPage::PAYLOAD` bytes
+    pub payload: Vec<u8>,
+}
+
+impl RecorderEntry {
+    const RESULT_NAMES: [&'static str; 6] = [
+        "ok",
+        "rejected (size)",
+        "rejected (invalid)",
+        "rejected (autonomous mode)",
+        "rejected (unknown)",
+        "rejected (flash busy)",
+    ];
+
+    /// Returns the direction, type, and ID of the report, which identify the handler.
+    pub fn kind(&self) -> String {
+        let direction = if self.is_set { "set" } else { "get" };
+        let report_type = match self.report_type {
+            1 => "input",
+            2 => "output",
+            3 => "feature",
+            _ => "invalid",
+        };
+        format!("{direction} {report_type} {:#04x}", self.report_id)
+    }
+
+    pub fn result_name(&self) -> String {
+        Self::RESULT_NAMES
+            .get(self.result as usize)
+            .map(|name| name.to_string())
+            .unwrap_or_else(|| format!("result {}", self.result))
+    }
+}
+
+/// A page of recorded reports, oldest first.
+#[derive(Debug)]
+pub struct RecorderPage {
+    /// The sequence number the device will give the next report it records
+    pub next_sequence: u32,
+    pub entries: Vec<RecorderEntry>,
+}
+
+impl RecorderPage {
+    pub const REPORT_ID: u8 = 0x3C;
+    pub const MAX_ENTRIES: u8 = 3;
+    pub const PAYLOAD: usize = 8;
+    const TYPE_SET: u8 = 0x80;
+
+    /// Splits the report type byte of an entry into whether it was a set report, and its type.
+    pub fn split_type(value: u8) -> (bool, u8) {
+        (value & Self::TYPE_SET != 0, value & !Self::TYPE_SET)
+    }
+}
+
+/// How a latency probe is sent. Output reports go over the interrupt OUT endpoint when the system
+/// uses it, so the device reports the path it actually saw in `LatencyResult`.
+#[derive(Debug, Copy, Clone)]
+pub enum LatencyTransport {
+    Feature,
+    Output,
+}
+
+/// Asks the device to time the next lamp update.
+#[derive(Debug)]
+pub struct LatencyProbe {
+    pub sequence: u32,
+    /// The host time the probe was sent, returned unchanged by the device
+    pub host_timestamp: u32,
+    /// The lamp whose output period is measured
+    pub lamp_id: u8,
+}
+
+/// The timing of a latency probe. Times are in microseconds since the device started, and wrap
+/// every 71 minutes.
+#[derive(Debug)]
+pub struct LatencyResult {
+    pub sequence: u32,
+    pub host_timestamp: u32,
+    pub lamp_id: u8,
+    pub path: u8,
+    /// How far the lamp was through its output period when the update was latched, out of 65536
+    pub phase: u16,
+    pub receive_us: u32,
+    /// When the update was written to the lamp outputs
+    pub latch_us: u32,
+    /// When the update is shown, at the start of a later output period
+    pub visible_us: u32,
+    /// When the device queued the result
+    pub send_us: u32,
+}
+
+impl LatencyResult {
+    pub const REPORT_ID: u8 = 0x3D;
+
+    const PATH_NAMES: [&'static str; 3] = ["feature", "output", "interrupt"];
+
+    /// Returns how the probe reached the device.
+    pub fn path_name(&self) -> String {
+        Self::PATH_NAMES
+            .get(self.path as usize)
+            .map(|name| name.to_string())
+            .unwrap_or_else(|| format!("path {}", self.path))
+    }
+
+    /// Returns the time from the device receiving the probe to the update being visible.
+    pub fn device_latency_us(&self) -> u32 {
+        self.visible_us.wrapping_sub(self.receive_us)
+    }
+
+    /// Returns the time the probe spent on the device before the result was queued.
+    pub fn turnaround_us(&self) -> u32 {
+        self.send_us.wrapping_sub(self.receive_us)
+    }
+}
+
+/// The kinds of event the device can send, in subscription mask order.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum EventType {
+    Reset,
+    AnimationStage,
+    Scene,
+    Throttle,
+    Persist,
+}
+
+impl fmt::Display for EventType {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> Result<(), fmt::Error> {
+        match self {
+            Self::Reset => write!(f, "reset"),
+            Self::AnimationStage => write!(f, "animation-stage"),
+            Self::Scene => write!(f, "scene"),
+            Self::Throttle => write!(f, "throttle"),
+            Self::Persist => write!(f, "persist"),
+        }
+    }
+}
+
+impl EventType {
+    pub const ALL: [EventType; 5] = [
+        Self::Reset,
+        Self::AnimationStage,
+        Self::Scene,
+        Self::Throttle,
+        Self::Persist,
+    ];
+
+    pub fn parse(s: &str) -> Result<Self, String> {
+        let e = s.to_lowercase().replace('_', "-");
+        Self::ALL
+            .into_iter()
+            .find(|event_type| event_type.to_string() == e)
+            .ok_or_else(|| "invalid event type".to_string())
+    }
+
+    /// Returns the bit for this type in the subscription mask.
+    pub fn mask(&self) -> u16 {
+        1 << *self as u16
+    }
+}
+
+/// Selects the events the device sends. An empty list stops the events.
+#[derive(Debug)]
+pub struct EventsConfig {
+    pub types: Vec<EventType>,
+}
+
+impl EventsConfig {
+    pub fn mask(&self) -> u16 {
+        self.types.iter().fold(0, |mask, t| mask | t.mask())
+    }
+}
+
+/// A change on the device. The meaning of the arguments depends on the type; `Display` decodes
+/// them.
+#[derive(Debug)]
+pub struct Event {
+    /// The time of the event, in microseconds since the device started. This wraps every 71
+    /// minutes.
+    pub timestamp_us: u32,
+    pub event_type: u8,
+    pub arg8: u8,
+    pub arg16: u16,
+}
+
+impl Event {
+    const RESET_CAUSES: [&'static str; 3] = ["power-on", "watchdog", "reboot"];
+
+    /// The scene switch cause for scenes activated by the host
+    const SCENE_BY_HOST: u16 = 0xFFFF;
+
+    /// The name of each kind of flash record, indexed by record type
+    const RECORD_NAMES: [&'static str; 6] = [
+        "animation",
+        "lamp state",
+        "scene lamp",
+        "scene name",
+        "scene rules",
+        "calibration",
+    ];
+}
+
+impl fmt::Display for Event {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> Result<(), fmt::Error> {
+        let Some(event_type) = EventType::ALL.get(self.event_type as usize) else {
+            return write!(
+                f,
+                "event {}: {:#04x} {}",
+                self.event_type, self.arg8, self.arg16
+            );
+        };
+
+        match event_type {
+            EventType::Reset => {
+                let cause = Self::RESET_CAUSES
+                    .get(self.arg8 as usize)
+                    .map(|cause| cause.to_string())
+                    .unwrap_or_else(|| format!("cause {}", self.arg8));
+                let warm = if self.arg16 != 0 { " (warm)" } else { "" };
+                write!(f, "{event_type}: {cause}{warm}")
+            }
+            EventType::AnimationStage => write!(
+                f,
+                "{event_type}: lamp {} stage {}",
+                self.arg8 as u16 + 1,
+                self.arg16
+            ),
+            EventType::Scene => {
+                let cause = match self.arg16 {
+                    Self::SCENE_BY_HOST => "host".to_string(),
+                    event => SceneEvent::ALL
+                        .get(event as usize)
+                        .map(|event| event.to_string())
+                        .unwrap_or_else(|| format!("event {event}")),
+                };
+                write!(f, "{event_type}: {} ({cause})", self.arg8 as u16 + 1)
+            }
+            EventType::Throttle if self.arg8 != 0 => write!(
+                f,
+                "{event_type}: dimming to {:.1}%",
+                self.arg16 as f64 * 100.0 / PowerStatus::SCALE_MAX as f64
+            ),
+            EventType::Throttle => write!(f, "{event_type}: full brightness"),
+            EventType::Persist => {
+                let record_type = self.arg16 >> 8;
+                let record = Self::RECORD_NAMES
+                    .get(record_type as usize)
+                    .map(|name| name.to_string())
+                    .unwrap_or_else(|| format!("record {record_type}"));
+                let result = if self.arg8 != 0 { "failed" } else { "saved" };
+                write!(f, "{event_type}: {record} {} {result}", self.arg16 & 0xFF)
+            }
+        }
+    }
+}
+
+#[derive(Debug)]
+pub struct EventBatch {
+    /// The number of events lost since the previous batch because the device's queue filled up.
+    pub dropped_entries: u8,
+    pub entries: Vec<Event>,
+}
+
+impl EventBatch {
+    pub const REPORT_ID: u8 = 0x3F;
+    pub const MAX_ENTRIES: u8 = 7;
+}
+
 #[derive(Debug)]
 pub struct SetAnimationReport {
     pub lamp_id: u8,
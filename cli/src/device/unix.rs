@@ -1,4 +1,8 @@
-use crate::device::{Error, Report};
+use crate::device::{
+    CalibrationCurve, Channel, ControllerStatus, Error, EventBatch, LatencyResult, MemoryStatus,
+    PersistStatus, PowerStatus, RecorderPage, Report, SceneInfo, SceneRules, StatsPage,
+    TemperatureBatch, TraceBatch,
+};
 
 pub struct Device {}
 
@@ -14,4 +18,60 @@ impl Device {
     pub fn read_temperature(&self) -> Result<f64, Error> {
         unimplemented!()
     }
+
+    pub fn read_temperature_batch(&self) -> Result<TemperatureBatch, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_persist_status(&self) -> Result<PersistStatus, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_power_status(&self) -> Result<PowerStatus, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_scene(&self, _scene_id: u8) -> Result<SceneInfo, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_scene_rules(&self) -> Result<SceneRules, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_calibration(
+        &self,
+        _lamp_id: u8,
+        _channel: Channel,
+    ) -> Result<CalibrationCurve, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_stats(&self, _page: u8) -> Result<StatsPage, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_memory_status(&self) -> Result<MemoryStatus, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_status(&self) -> Result<ControllerStatus, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_recorder(&self, _sequence: u32) -> Result<RecorderPage, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_trace_batch(&self) -> Result<TraceBatch, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_event_batch(&self) -> Result<EventBatch, Error> {
+        unimplemented!()
+    }
+
+    pub fn read_latency_result(&self) -> Result<LatencyResult, Error> {
+        unimplemented!()
+    }
 }
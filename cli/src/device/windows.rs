@@ -1,10 +1,21 @@
-use crate::device::{hid, Error, Report, SetAnimationMode};
-use std::sync;
+use crate::device::{
+    hid, CalibrationAction, CalibrationCurve, CalibrationReport, Channel, ControllerStatus, Error,
+    Event, EventBatch, LampStatus, LatencyResult, LatencyTransport, MemoryStatus, PersistStatus,
+    PowerStatus, RecorderEntry, RecorderPage, RecorderRequest, Report, SceneAction, SceneEvent,
+    SceneInfo, SceneReport, SceneRules, SetAnimationMode, StatsPage, StatsRequest,
+    TemperatureBatch, TemperatureSample, TraceBatch, TraceEntry,
+};
+use std::cell::OnceCell;
+use std::sync::{self, mpsc};
+use std::time::Duration;
 use windows::core::HSTRING;
 use windows::Devices::Enumeration::DeviceInformation;
-use windows::Devices::HumanInterfaceDevice::{HidDevice, HidFeatureReport, HidOutputReport};
+use windows::Devices::HumanInterfaceDevice::{
+    HidDevice, HidFeatureReport, HidInputReport, HidInputReportReceivedEventArgs, HidOutputReport,
+};
+use windows::Foundation::TypedEventHandler;
 use windows::Storage::FileAccessMode;
-use windows::Storage::Streams::{ByteOrder, DataWriter, IBuffer};
+use windows::Storage::Streams::{ByteOrder, DataReader, DataWriter, IBuffer};
 use windows::Win32::Devices::Sensors::{self, ISensor, ISensorManager};
 use windows::Win32::System::Com;
 use windows::Win32::System::Com::StructuredStorage::PROPVARIANT;
@@ -13,6 +24,10 @@ use windows::Win32::UI::Shell::PropertiesSystem::PROPERTYKEY;
 pub struct Device {
     vendor: HidDevice,
     temp_sensor: ISensor,
+    temp_batches: OnceCell<mpsc::Receiver<TemperatureBatch>>,
+    trace_batches: OnceCell<mpsc::Receiver<TraceBatch>>,
+    latency_results: OnceCell<mpsc::Receiver<LatencyResult>>,
+    event_batches: OnceCell<mpsc::Receiver<EventBatch>>,
 }
 
 impl From<windows::core::Error> for Error {
@@ -40,6 +55,10 @@ impl Device {
         Ok(Device {
             vendor,
             temp_sensor,
+            temp_batches: OnceCell::new(),
+            trace_batches: OnceCell::new(),
+            latency_results: OnceCell::new(),
+            event_batches: OnceCell::new(),
         })
     }
 
@@ -72,8 +91,12 @@ impl Device {
 
             Report::SetAnimation(mode, report) => {
                 let write_report = |r: &dyn HidReport| -> Result<(), Error> {
-                    ReportWriter::new(r)?
-                        .write_u8(report.lamp_id)?
+                    let w = ReportWriter::new(r)?;
+                    let w = match mode {
+                        SetAnimationMode::Scene(scene_id) => w.write_u8(scene_id)?,
+                        _ => w,
+                    };
+                    w.write_u8(report.lamp_id)?
                         .write_u8(report.animation.type_byte())?
                         .write_u8s(&report.animation.data())?
                         .close()
@@ -81,7 +104,7 @@ impl Device {
 
                 let d = &self.vendor;
                 match mode {
-                    SetAnimationMode::Default => {
+                    SetAnimationMode::Default | SetAnimationMode::Scene(_) => {
                         let r = d.CreateFeatureReportById(report_id)?;
                         write_report(&r)?;
                         d.SendFeatureReportAsync(&r)?.get()?;
@@ -94,6 +117,146 @@ impl Device {
                 };
                 Ok(())
             }
+
+            Report::Scene(report) => {
+                let d = &self.vendor;
+                let r = d.CreateFeatureReportById(report_id)?;
+
+                ReportWriter::new(&r)?
+                    .write_u8(report.scene_id)?
+                    .write_u8(report.action.into())?
+                    .write_u8s(&report.name_bytes())?
+                    .close()?;
+
+                d.SendFeatureReportAsync(&r)?.get()?;
+                Ok(())
+            }
+
+            Report::TemperatureBatchConfig(config) => {
+                let d = &self.vendor;
+                let r = d.CreateFeatureReportById(report_id)?;
+
+                ReportWriter::new(&r)?
+                    .write_u8(config.batch_size)?
+                    .write_u16(config.sample_interval_ms)?
+                    .write_u16(config.max_latency_ms)?
+                    .close()?;
+
+                d.SendFeatureReportAsync(&r)?.get()?;
+                Ok(())
+            }
+
+            Report::SceneRules(rules) => {
+                let d = &self.vendor;
+                let r = d.CreateFeatureReportById(report_id)?;
+
+                ReportWriter::new(&r)?
+                    .write_u8s(&rules.scene_bytes())?
+                    .write_i16(to_centidegrees(rules.temperature_high))?
+                    .write_i16(to_centidegrees(rules.temperature_normal))?
+                    .close()?;
+
+                d.SendFeatureReportAsync(&r)?.get()?;
+                Ok(())
+            }
+
+            Report::Calibration(report) => {
+                let d = &self.vendor;
+                let r = d.CreateFeatureReportById(report_id)?;
+
+                ReportWriter::new(&r)?
+                    .write_u8(report.lamp_id)?
+                    .write_u8(report.channel.into())?
+                    .write_u8(report.action.into())?
+                    .write_u16s(&report.curve.points)?
+                    .close()?;
+
+                d.SendFeatureReportAsync(&r)?.get()?;
+                Ok(())
+            }
+
+            Report::Stats(request) => {
+                let d = &self.vendor;
+                let r = d.CreateFeatureReportById(report_id)?;
+
+                ReportWriter::new(&r)?
+                    .write_u8(request.page)?
+                    .write_u8(0)?
+                    .write_u8(request.flags())?
+                    .close()?;
+
+                d.SendFeatureReportAsync(&r)?.get()?;
+                Ok(())
+            }
+
+            Report::Recorder(request) => {
+                let d = &self.vendor;
+                let r = d.CreateFeatureReportById(report_id)?;
+
+                ReportWriter::new(&r)?
+                    .write_u32(request.sequence)?
+                    .write_u32(0)?
+                    .write_u8(request.flags())?
+                    .close()?;
+
+                d.SendFeatureReportAsync(&r)?.get()?;
+                Ok(())
+            }
+
+            Report::TraceConfig(config) => {
+                let d = &self.vendor;
+                let r = d.CreateFeatureReportById(report_id)?;
+
+                ReportWriter::new(&r)?.write_u8(config.flags())?.close()?;
+
+                d.SendFeatureReportAsync(&r)?.get()?;
+                Ok(())
+            }
+
+            Report::EventsConfig(config) => {
+                // Listen before subscribing so the reset event is not missed
+                self.event_batches()?;
+
+                let d = &self.vendor;
+                let r = d.CreateFeatureReportById(report_id)?;
+
+                ReportWriter::new(&r)?
+                    .write_u16(config.mask())?
+                    .write_u8(0)?
+                    .write_u8(0)?
+                    .close()?;
+
+                d.SendFeatureReportAsync(&r)?.get()?;
+                Ok(())
+            }
+
+            Report::LatencyProbe(transport, probe) => {
+                // Listen before sending so a fast result is not missed
+                self.latency_results()?;
+
+                let write_report = |r: &dyn HidReport| -> Result<(), Error> {
+                    ReportWriter::new(r)?
+                        .write_u32(probe.sequence)?
+                        .write_u32(probe.host_timestamp)?
+                        .write_u8(probe.lamp_id)?
+                        .close()
+                };
+
+                let d = &self.vendor;
+                match transport {
+                    LatencyTransport::Feature => {
+                        let r = d.CreateFeatureReportById(report_id)?;
+                        write_report(&r)?;
+                        d.SendFeatureReportAsync(&r)?.get()?;
+                    }
+                    LatencyTransport::Output => {
+                        let r = d.CreateOutputReportById(report_id)?;
+                        write_report(&r)?;
+                        d.SendOutputReportAsync(&r)?.get()?;
+                    }
+                };
+                Ok(())
+            }
         }
     }
 
@@ -108,6 +271,463 @@ impl Device {
             Ok(value.Anonymous.Anonymous.Anonymous.fltVal as f64)
         }
     }
+
+    pub fn read_temperature_batch(&self) -> Result<TemperatureBatch, Error> {
+        // Input reports arrive on a system thread; forward batches over a channel
+        let batches = match self.temp_batches.get() {
+            Some(rx) => rx,
+            None => {
+                let (tx, rx) = mpsc::channel();
+                self.vendor.InputReportReceived(&TypedEventHandler::new(
+                    move |_, args: &Option<HidInputReportReceivedEventArgs>| {
+                        if let Some(args) = args {
+                            let report = args.Report()?;
+                            if report.Id()? == TemperatureBatch::REPORT_ID as u16 {
+                                if let Ok(batch) = parse_temperature_batch(&report) {
+                                    let _ = tx.send(batch);
+                                }
+                            }
+                        }
+                        Ok(())
+                    },
+                ))?;
+                self.temp_batches.get_or_init(|| rx)
+            }
+        };
+
+        // The device limits batch latency to 30 seconds
+        const TIMEOUT: Duration = Duration::from_secs(35);
+        batches.recv_timeout(TIMEOUT).map_err(|_| Error::Timeout)
+    }
+
+    pub fn read_recorder(&self, sequence: u32) -> Result<RecorderPage, Error> {
+        // The device returns the entries selected by the last set report
+        self.send_report(Report::Recorder(RecorderRequest {
+            sequence,
+            clear: false,
+        }))?;
+
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(RecorderPage::REPORT_ID as u16)?
+            .get()?;
+
+        let reader = ReportReader::new(&r.Data()?)?;
+        let first = reader.read_u32()?;
+        let next_sequence = reader.read_u32()?;
+        // Skip the flags
+        reader.read_u8()?;
+        let count = reader.read_u8()?.min(RecorderPage::MAX_ENTRIES);
+
+        let mut entries = Vec::with_capacity(count as usize);
+        for i in 0..count {
+            let timestamp_us = reader.read_u32()?;
+            let (is_set, report_type) = RecorderPage::split_type(reader.read_u8()?);
+            let report_id = reader.read_u8()?;
+            let result = reader.read_u8()?;
+            let length = reader.read_u16()?;
+            let mut payload = reader.read_u8s(RecorderPage::PAYLOAD)?;
+            payload.truncate(length as usize);
+            entries.push(RecorderEntry {
+                sequence: first.wrapping_add(i as u32),
+                timestamp_us,
+                is_set,
+                report_type,
+                report_id,
+                result,
+                length,
+                payload,
+            });
+        }
+
+        Ok(RecorderPage {
+            next_sequence,
+            entries,
+        })
+    }
+
+    pub fn read_trace_batch(&self) -> Result<TraceBatch, Error> {
+        // Input reports arrive on a system thread; forward batches over a channel
+        let batches = match self.trace_batches.get() {
+            Some(rx) => rx,
+            None => {
+                let (tx, rx) = mpsc::channel();
+                self.vendor.InputReportReceived(&TypedEventHandler::new(
+                    move |_, args: &Option<HidInputReportReceivedEventArgs>| {
+                        if let Some(args) = args {
+                            let report = args.Report()?;
+                            if report.Id()? == TraceBatch::REPORT_ID as u16 {
+                                if let Ok(batch) = parse_trace_batch(&report) {
+                                    let _ = tx.send(batch);
+                                }
+                            }
+                        }
+                        Ok(())
+                    },
+                ))?;
+                self.trace_batches.get_or_init(|| rx)
+            }
+        };
+
+        // Events may not arrive for a long time, so wait until the device goes away
+        batches.recv().map_err(|_| Error::NotFound)
+    }
+
+    pub fn read_event_batch(&self) -> Result<EventBatch, Error> {
+        // Events may not arrive for a long time, so wait until the device goes away
+        self.event_batches()?.recv().map_err(|_| Error::NotFound)
+    }
+
+    fn event_batches(&self) -> Result<&mpsc::Receiver<EventBatch>, Error> {
+        // Input reports arrive on a system thread; forward batches over a channel
+        if let Some(rx) = self.event_batches.get() {
+            return Ok(rx);
+        }
+
+        let (tx, rx) = mpsc::channel();
+        self.vendor.InputReportReceived(&TypedEventHandler::new(
+            move |_, args: &Option<HidInputReportReceivedEventArgs>| {
+                if let Some(args) = args {
+                    let report = args.Report()?;
+                    if report.Id()? == EventBatch::REPORT_ID as u16 {
+                        if let Ok(batch) = parse_event_batch(&report) {
+                            let _ = tx.send(batch);
+                        }
+                    }
+                }
+                Ok(())
+            },
+        ))?;
+        Ok(self.event_batches.get_or_init(|| rx))
+    }
+
+    pub fn read_latency_result(&self) -> Result<LatencyResult, Error> {
+        // The device answers at its next lamp commit, unless it is suspended
+        const TIMEOUT: Duration = Duration::from_secs(1);
+        self.latency_results()?
+            .recv_timeout(TIMEOUT)
+            .map_err(|_| Error::Timeout)
+    }
+
+    fn latency_results(&self) -> Result<&mpsc::Receiver<LatencyResult>, Error> {
+        // Input reports arrive on a system thread; forward results over a channel
+        if let Some(rx) = self.latency_results.get() {
+            return Ok(rx);
+        }
+
+        let (tx, rx) = mpsc::channel();
+        self.vendor.InputReportReceived(&TypedEventHandler::new(
+            move |_, args: &Option<HidInputReportReceivedEventArgs>| {
+                if let Some(args) = args {
+                    let report = args.Report()?;
+                    if report.Id()? == LatencyResult::REPORT_ID as u16 {
+                        if let Ok(result) = parse_latency_result(&report) {
+                            let _ = tx.send(result);
+                        }
+                    }
+                }
+                Ok(())
+            },
+        ))?;
+        Ok(self.latency_results.get_or_init(|| rx))
+    }
+
+    pub fn read_persist_status(&self) -> Result<PersistStatus, Error> {
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(PersistStatus::REPORT_ID as u16)?
+            .get()?;
+
+        let reader = ReportReader::new(&r.Data()?)?;
+        Ok(PersistStatus {
+            pending_writes: reader.read_u8()?,
+            pending_erases: reader.read_u8()?,
+            failed_writes: reader.read_u16()?,
+            completed_writes: reader.read_u16()?,
+        })
+    }
+
+    pub fn read_power_status(&self) -> Result<PowerStatus, Error> {
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(PowerStatus::REPORT_ID as u16)?
+            .get()?;
+
+        let reader = ReportReader::new(&r.Data()?)?;
+        Ok(PowerStatus {
+            lamp_loads: (0..crate::device::Device::LAMP_COUNT)
+                .map(|_| reader.read_u16())
+                .collect::<Result<_, _>>()?,
+            requested_load: reader.read_u32()?,
+            total_load: reader.read_u32()?,
+            budget: reader.read_u32()?,
+            scale: reader.read_u16()? as f64 / PowerStatus::SCALE_MAX as f64,
+            min_temperature: from_centidegrees(reader.read_i16()?),
+            max_temperature: from_centidegrees(reader.read_i16()?),
+        })
+    }
+
+    pub fn read_status(&self) -> Result<ControllerStatus, Error> {
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(ControllerStatus::REPORT_ID as u16)?
+            .get()?;
+
+        // Each field is an array with one value per lamp
+        let reader = ReportReader::new(&r.Data()?)?;
+        let count = crate::device::Device::LAMP_COUNT as usize;
+        let read_u16s = || {
+            (0..count)
+                .map(|_| reader.read_u16())
+                .collect::<Result<Vec<_>, _>>()
+        };
+
+        let flags = reader.read_u8()?;
+        let red = read_u16s()?;
+        let green = read_u16s()?;
+        let blue = read_u16s()?;
+        let intensity = reader.read_u8s(count)?;
+        let animation_type = reader.read_u8s(count)?;
+        let animation_stage = reader.read_u8s(count)?;
+        let animation_frame = (0..count)
+            .map(|_| reader.read_u32())
+            .collect::<Result<Vec<_>, _>>()?;
+        let default_animation_type = reader.read_u8s(count)?;
+        let first_light_us = reader.read_u32()?;
+
+        let lamps = (0..count)
+            .map(|id| LampStatus {
+                red: red[id],
+                green: green[id],
+                blue: blue[id],
+                intensity: intensity[id],
+                animation_type: animation_type[id],
+                animation_stage: animation_stage[id],
+                animation_frame: animation_frame[id],
+                default_animation_type: Some(default_animation_type[id])
+                    .filter(|t| *t != ControllerStatus::NO_DEFAULT),
+            })
+            .collect();
+
+        Ok(ControllerStatus::from_report(flags, lamps, first_light_us))
+    }
+
+    pub fn read_scene(&self, scene_id: u8) -> Result<SceneInfo, Error> {
+        // The device returns the scene selected by the last set report
+        self.send_report(Report::Scene(SceneReport {
+            scene_id,
+            action: SceneAction::Select,
+            name: String::new(),
+        }))?;
+
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(SceneReport::REPORT_ID as u16)?
+            .get()?;
+
+        let reader = ReportReader::new(&r.Data()?)?;
+        let scene_id = reader.read_u8()?;
+        let flags = reader.read_u8()?;
+        let name = reader.read_u8s(SceneReport::NAME_SIZE)?;
+        Ok(SceneInfo::from_report(scene_id, flags, &name))
+    }
+
+    pub fn read_scene_rules(&self) -> Result<SceneRules, Error> {
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(SceneRules::REPORT_ID as u16)?
+            .get()?;
+
+        let reader = ReportReader::new(&r.Data()?)?;
+        let mut scenes = [None; SceneEvent::ALL.len()];
+        for scene in scenes.iter_mut() {
+            let id = reader.read_u8()?;
+            *scene = (id != SceneRules::NO_SCENE).then_some(id);
+        }
+        Ok(SceneRules {
+            scenes,
+            temperature_high: from_centidegrees(reader.read_i16()?),
+            temperature_normal: from_centidegrees(reader.read_i16()?),
+        })
+    }
+
+    pub fn read_calibration(
+        &self,
+        lamp_id: u8,
+        channel: Channel,
+    ) -> Result<CalibrationCurve, Error> {
+        // The device returns the channel selected by the last set report
+        self.send_report(Report::Calibration(CalibrationReport {
+            lamp_id,
+            channel,
+            action: CalibrationAction::Select,
+            curve: CalibrationCurve::identity(),
+        }))?;
+
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(CalibrationReport::REPORT_ID as u16)?
+            .get()?;
+
+        let reader = ReportReader::new(&r.Data()?)?;
+        // Skip the lamp ID, channel, and action
+        reader.read_u8s(3)?;
+        let mut curve = CalibrationCurve::identity();
+        for point in curve.points.iter_mut() {
+            *point = reader.read_u16()?;
+        }
+        Ok(curve)
+    }
+
+    pub fn read_stats(&self, page: u8) -> Result<StatsPage, Error> {
+        // The device returns the page selected by the last set report
+        self.send_report(Report::Stats(StatsRequest { page, reset: false }))?;
+
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(StatsPage::REPORT_ID as u16)?
+            .get()?;
+
+        let reader = ReportReader::new(&r.Data()?)?;
+        let page = reader.read_u8()?;
+        let page_count = reader.read_u8()?;
+        // Skip the flags
+        reader.read_u8()?;
+        Ok(StatsPage {
+            page,
+            page_count,
+            count: reader.read_u32()?,
+            mean_us: reader.read_u32()?,
+            max_us: reader.read_u32()?,
+            histogram: (0..StatsPage::BUCKETS)
+                .map(|_| reader.read_u16())
+                .collect::<Result<_, _>>()?,
+            counters: (0..StatsPage::COUNTER_NAMES.len())
+                .map(|_| reader.read_u16())
+                .collect::<Result<_, _>>()?,
+        })
+    }
+
+    pub fn read_memory_status(&self) -> Result<MemoryStatus, Error> {
+        let r = self
+            .vendor
+            .GetFeatureReportByIdAsync(MemoryStatus::REPORT_ID as u16)?
+            .get()?;
+
+        let reader = ReportReader::new(&r.Data()?)?;
+        Ok(MemoryStatus {
+            data_size: reader.read_u32()?,
+            bss_size: reader.read_u32()?,
+            heap_size: reader.read_u32()?,
+            heap_peak: reader.read_u32()?,
+            heap_used: reader.read_u32()?,
+            heap_free: reader.read_u32()?,
+            stack_sizes: (0..MemoryStatus::CORES)
+                .map(|_| reader.read_u16())
+                .collect::<Result<_, _>>()?,
+            stack_peaks: (0..MemoryStatus::CORES)
+                .map(|_| reader.read_u16())
+                .collect::<Result<_, _>>()?,
+        })
+    }
+}
+
+fn parse_temperature_batch(report: &HidInputReport) -> Result<TemperatureBatch, Error> {
+    let reader = ReportReader::new(&report.Data()?)?;
+    let count = reader.read_u8()?.min(TemperatureBatch::MAX_SAMPLES);
+    let dropped_samples = reader.read_u8()?;
+    let timestamp_ms = reader.read_u32()?;
+
+    // All offsets come first, then all temperatures
+    let mut offsets = Vec::with_capacity(TemperatureBatch::MAX_SAMPLES as usize);
+    for _ in 0..TemperatureBatch::MAX_SAMPLES {
+        offsets.push(reader.read_u16()?);
+    }
+    let mut temperatures = Vec::with_capacity(TemperatureBatch::MAX_SAMPLES as usize);
+    for _ in 0..TemperatureBatch::MAX_SAMPLES {
+        temperatures.push(reader.read_i16()?);
+    }
+
+    let samples = offsets
+        .iter()
+        .zip(temperatures.iter())
+        .take(count as usize)
+        .map(|(offset_ms, temperature)| TemperatureSample {
+            timestamp_ms: timestamp_ms.wrapping_add(*offset_ms as u32),
+            celsius: from_centidegrees(*temperature),
+        })
+        .collect();
+
+    Ok(TemperatureBatch {
+        dropped_samples,
+        samples,
+    })
+}
+
+fn parse_trace_batch(report: &HidInputReport) -> Result<TraceBatch, Error> {
+    let reader = ReportReader::new(&report.Data()?)?;
+    let count = reader.read_u8()?.min(TraceBatch::MAX_ENTRIES);
+    let dropped_entries = reader.read_u8()?;
+
+    let mut entries = Vec::with_capacity(count as usize);
+    for _ in 0..count {
+        entries.push(TraceEntry {
+            timestamp_us: reader.read_u32()?,
+            event: reader.read_u8()?,
+            arg8: reader.read_u8()?,
+            arg16: reader.read_u16()?,
+            arg32: reader.read_u32()?,
+        });
+    }
+
+    Ok(TraceBatch {
+        dropped_entries,
+        entries,
+    })
+}
+
+fn parse_event_batch(report: &HidInputReport) -> Result<EventBatch, Error> {
+    let reader = ReportReader::new(&report.Data()?)?;
+    let count = reader.read_u8()?.min(EventBatch::MAX_ENTRIES);
+    let dropped_entries = reader.read_u8()?;
+
+    let mut entries = Vec::with_capacity(count as usize);
+    for _ in 0..count {
+        entries.push(Event {
+            timestamp_us: reader.read_u32()?,
+            event_type: reader.read_u8()?,
+            arg8: reader.read_u8()?,
+            arg16: reader.read_u16()?,
+        });
+    }
+
+    Ok(EventBatch {
+        dropped_entries,
+        entries,
+    })
+}
+
+fn parse_latency_result(report: &HidInputReport) -> Result<LatencyResult, Error> {
+    let reader = ReportReader::new(&report.Data()?)?;
+    Ok(LatencyResult {
+        sequence: reader.read_u32()?,
+        host_timestamp: reader.read_u32()?,
+        lamp_id: reader.read_u8()?,
+        path: reader.read_u8()?,
+        phase: reader.read_u16()?,
+        receive_us: reader.read_u32()?,
+        latch_us: reader.read_u32()?,
+        visible_us: reader.read_u32()?,
+        send_us: reader.read_u32()?,
+    })
+}
+
+fn to_centidegrees(c: f64) -> i16 {
+    (c * SceneRules::TEMPERATURE_SCALE).round() as i16
+}
+
+fn from_centidegrees(c: i16) -> f64 {
+    c as f64 / SceneRules::TEMPERATURE_SCALE
 }
 
 fn find_first_device(aqs_filter: &HSTRING) -> Result<DeviceInformation, Error> {
@@ -223,14 +843,24 @@ impl<'a> ReportWriter<'a> {
         Ok(self)
     }
 
-    #[allow(dead_code)]
     fn write_u16(mut self, value: u16) -> Result<Self, Error> {
         self.data.WriteUInt16(value)?;
         self.length += 2;
         Ok(self)
     }
 
-    #[allow(dead_code)]
+    fn write_i16(mut self, value: i16) -> Result<Self, Error> {
+        self.data.WriteInt16(value)?;
+        self.length += 2;
+        Ok(self)
+    }
+
+    fn write_u32(mut self, value: u32) -> Result<Self, Error> {
+        self.data.WriteUInt32(value)?;
+        self.length += 4;
+        Ok(self)
+    }
+
     fn write_u16s(mut self, value: &[u16]) -> Result<Self, Error> {
         value.iter().try_for_each(|v| self.data.WriteUInt16(*v))?;
         self.length += 2*value.len() as u32;
@@ -247,3 +877,41 @@ impl<'a> ReportWriter<'a> {
             .map_err(From::from)
     }
 }
+
+struct ReportReader {
+    data: DataReader,
+}
+
+impl ReportReader {
+    fn new(buffer: &IBuffer) -> Result<ReportReader, Error> {
+        let data = DataReader::FromBuffer(buffer)?;
+        data.SetByteOrder(ByteOrder::LittleEndian)?;
+
+        // Skip the report ID
+        data.ReadByte()?;
+
+        Ok(ReportReader { data })
+    }
+
+    fn read_u8(&self) -> Result<u8, Error> {
+        self.data.ReadByte().map_err(From::from)
+    }
+
+    fn read_u16(&self) -> Result<u16, Error> {
+        self.data.ReadUInt16().map_err(From::from)
+    }
+
+    fn read_i16(&self) -> Result<i16, Error> {
+        self.data.ReadInt16().map_err(From::from)
+    }
+
+    fn read_u32(&self) -> Result<u32, Error> {
+        self.data.ReadUInt32().map_err(From::from)
+    }
+
+    fn read_u8s(&self, len: usize) -> Result<Vec<u8>, Error> {
+        let mut value = vec![0; len];
+        self.data.ReadBytes(&mut value)?;
+        Ok(value)
+    }
+}
@@ -0,0 +1,58 @@
+# Prints a summary of where the firmware's code and data live in memory,
+# including every function placed in RAM (e.g. with __time_critical_func).
+#
+# Usage: cmake -DNM=<path to nm> -DELF=<path to elf> -P memory_report.cmake
+
+execute_process(
+    COMMAND ${NM} --print-size --size-sort --defined-only ${ELF}
+    OUTPUT_VARIABLE symbols
+    RESULT_VARIABLE result
+)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Failed to read symbols from ${ELF}")
+endif()
+
+set(flash_code 0)
+set(flash_data 0)
+set(ram_code 0)
+set(ram_data 0)
+set(ram_functions "")
+
+string(REPLACE "\n" ";" lines "${symbols}")
+foreach(line IN LISTS lines)
+    if (NOT line MATCHES "^([0-9a-f]+) ([0-9a-f]+) ([A-Za-z]) (.+)$")
+        continue()
+    endif()
+
+    set(addr ${CMAKE_MATCH_1})
+    math(EXPR size "0x${CMAKE_MATCH_2}")
+    string(TOLOWER ${CMAKE_MATCH_3} type)
+    set(name ${CMAKE_MATCH_4})
+
+    # Flash is mapped at 0x10000000 (XIP) and RAM at 0x20000000
+    string(SUBSTRING ${addr} 0 1 region)
+    if (type STREQUAL "t")
+        if (region STREQUAL "2")
+            math(EXPR ram_code "${ram_code} + ${size}")
+            list(APPEND ram_functions "${size}\t${name}")
+        else()
+            math(EXPR flash_code "${flash_code} + ${size}")
+        endif()
+    else()
+        if (region STREQUAL "2")
+            math(EXPR ram_data "${ram_data} + ${size}")
+        else()
+            math(EXPR flash_data "${flash_data} + ${size}")
+        endif()
+    endif()
+endforeach()
+
+message("Memory report for ${ELF}")
+message("  flash code: ${flash_code} bytes")
+message("  flash data: ${flash_data} bytes")
+message("  RAM code:   ${ram_code} bytes")
+message("  RAM data:   ${ram_data} bytes")
+message("Functions in RAM (bytes, name):")
+foreach(fn IN LISTS ram_functions)
+    message("  ${fn}")
+endforeach()
@@ -0,0 +1,124 @@
+#include <stdint.h>
+#ifdef DEBUG_BLEND
+#include <stdio.h>
+#endif
+
+#include "pico.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/interp.h"
+#endif
+
+#include "color/blend.h"
+#include "color/color.h"
+
+#if PICO_ON_DEVICE
+
+#ifdef DEBUG_BLEND
+static void blend_check();
+#endif
+
+void blend_init()
+{
+    interp_config cfg;
+
+    // INTERP0: lane 0 enables blend mode, lane 1 provides alpha in the 8 LSBs
+    // of its accumulator and treats the base values as signed
+    cfg = interp_default_config();
+    interp_config_set_blend(&cfg, true);
+    interp_set_config(interp0, 0, &cfg);
+
+    cfg = interp_default_config();
+    interp_config_set_signed(&cfg, true);
+    interp_set_config(interp0, 1, &cfg);
+
+    // INTERP1: lane 0 clamps its signed accumulator to [BASE0, BASE1]
+    cfg = interp_default_config();
+    interp_config_set_clamp(&cfg, true);
+    interp_config_set_signed(&cfg, true);
+    interp_set_config(interp1, 0, &cfg);
+
+    interp1->base[0] = 0;
+    interp1->base[1] = UINT16_MAX;
+
+#ifdef DEBUG_BLEND
+    blend_check();
+#endif
+}
+
+static __force_inline uint16_t blend_channel_hw(int32_t a, int32_t b)
+{
+    interp0->base[0] = (uint32_t) a;
+    interp0->base[1] = (uint32_t) b;
+    interp1->accum[0] = interp0->peek[1];
+    return (uint16_t) interp1->peek[0];
+}
+
+uint16_t __time_critical_func(blend_channel)(int32_t a, int32_t b, uint8_t alpha)
+{
+    interp0->accum[1] = alpha;
+    return blend_channel_hw(a, b);
+}
+
+struct RGBu16 __time_critical_func(blend_rgb)(struct RGBi32 const *a, struct RGBi32 const *b, uint8_t alpha)
+{
+    interp0->accum[1] = alpha;
+
+    struct RGBu16 rgb = {
+        blend_channel_hw(a->r, b->r),
+        blend_channel_hw(a->g, b->g),
+        blend_channel_hw(a->b, b->b),
+    };
+    return rgb;
+}
+
+#ifdef DEBUG_BLEND
+/**
+ * @brief Compares the interpolators with blend_channel_sw for every alpha,
+ * including values outside the channel range, and prints any differences.
+ * The interpolators only exist on the device, so there is no host test.
+ */
+static void blend_check()
+{
+    static const int32_t values[] = { -70000, -1, 0, 1, 255, 32768, 65534, 65535, 65536, 140000 };
+    const uint8_t count = sizeof(values) / sizeof(values[0]);
+
+    uint32_t mismatches = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        for (uint8_t j = 0; j < count; j++) {
+            for (uint16_t alpha = 0; alpha <= UINT8_MAX; alpha++) {
+                uint16_t hw = blend_channel(values[i], values[j], (uint8_t) alpha);
+                uint16_t sw = blend_channel_sw(values[i], values[j], (uint8_t) alpha);
+                if (hw != sw && mismatches++ < 8) {
+                    printf("blend: a=%ld b=%ld alpha=%u: hw=%u sw=%u\n",
+                           (long) values[i], (long) values[j], alpha, hw, sw);
+                }
+            }
+        }
+    }
+    printf("blend: %lu mismatches\n", (unsigned long) mismatches);
+}
+#endif
+
+#else
+
+void blend_init()
+{
+}
+
+uint16_t blend_channel(int32_t a, int32_t b, uint8_t alpha)
+{
+    return blend_channel_sw(a, b, alpha);
+}
+
+struct RGBu16 blend_rgb(struct RGBi32 const *a, struct RGBi32 const *b, uint8_t alpha)
+{
+    struct RGBu16 rgb = {
+        blend_channel_sw(a->r, b->r, alpha),
+        blend_channel_sw(a->g, b->g, alpha),
+        blend_channel_sw(a->b, b->b, alpha),
+    };
+    return rgb;
+}
+
+#endif
@@ -16,6 +16,11 @@ static inline uint16_t channel_to_u16(float c)
     return i > 65535 ? 65535 : (uint16_t) i;
 }
 
+static inline int32_t channel_to_i32(float c)
+{
+    return (int32_t) (65535.f * c + 0.5f);
+}
+
 static inline float channel_to_linear(float c)
 {
     if (c >= 0.04045) {
@@ -25,6 +30,15 @@ static inline float channel_to_linear(float c)
     }
 }
 
+static inline float channel_from_linear(float c)
+{
+    if (c >= 0.0031308f) {
+        return 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+    } else {
+        return 12.92f * c;
+    }
+}
+
 struct RGBu8 rgb_to_u8(struct RGB rgb)
 {
     struct RGBu8 u8 = {
@@ -45,6 +59,16 @@ struct RGBu16 rgb_to_u16(struct RGB rgb)
     return u16;
 }
 
+struct RGBi32 rgb_to_i32(struct RGB rgb)
+{
+    struct RGBi32 i32 = {
+        channel_to_i32(rgb.r),
+        channel_to_i32(rgb.g),
+        channel_to_i32(rgb.b),
+    };
+    return i32;
+}
+
 struct RGB rgb_from_u8(struct RGBu8 rgb)
 {
     struct RGB f = {
@@ -65,6 +89,16 @@ struct RGB rgb_to_linear_rgb(struct RGB rgb)
     return lin;
 }
 
+struct RGB rgb_from_linear_rgb(struct RGB lin)
+{
+    struct RGB rgb = {
+        channel_from_linear(lin.r),
+        channel_from_linear(lin.g),
+        channel_from_linear(lin.b),
+    };
+    return rgb;
+}
+
 struct Lab linear_rgb_to_oklab(struct RGB rgb)
 {
     float l = 0.4122214708f * rgb.r + 0.5363325363f * rgb.g + 0.0514459929f * rgb.b;
@@ -62,11 +62,98 @@
     {20, 21, 19}, \
     {17, 16, 18},
 
+// Select the hardware that drives the lamp outputs. LAMP_BACKEND_PWM uses the
+// PWM slices, which limits the mapping to one GPIO per PWM channel.
+// LAMP_BACKEND_PIO uses a PIO state machine fed by DMA, which can drive any
+// GPIOs with binary code modulation.
+#define CFG_RGB_LAMP_BACKEND LAMP_BACKEND_PWM
+
+// The number of bits per color channel for the PIO lamp backend. Lamp colors
+// are 16-bit values, which are truncated to this many bits.
+//
+// Range: [8, 16]
+#define CFG_RGB_PIO_BIT_DEPTH 12
+
+// The output frequency for the PIO lamp backend. Each period takes
+// 4 * (2^CFG_RGB_PIO_BIT_DEPTH - 1) PIO cycles, which must fit in the system
+// clock.
+//
+// Units: Hz
+#define CFG_RGB_PIO_FREQUENCY 1000
+
 // Set the divider for the PWM clock. The PWM counters wrap at the full 16-bit
 // value, so with a 125 MHz system clock, the default value gives a PWM
-// frequency of ~250 Hz.
+// frequency of ~250 Hz. The divider is relative to 125 MHz and is adjusted
+// when the system clock changes, so the PWM frequency stays the same.
 #define CFG_RGB_PWM_CLOCK_DIVIDER 7.625f
 
+// Start the counter of each PWM slice at a different point in the period, so
+// the channels do not all turn on at the same time. This spreads out the
+// current steps on the 12V supply. Set to 0 to start all slices together.
+#define CFG_RGB_PWM_STAGGER 1
+
+// Use phase-correct PWM, which centers each pulse on the slice's period
+// boundary instead of starting it there. The PWM frequency and resolution do
+// not change. With CFG_RGB_PWM_STAGGER, the slice offsets span half of the
+// period because the counters can only be started while counting up. Set to 1
+// to enable.
+#define CFG_RGB_PWM_PHASE_CORRECT 0
+
+// Lower the system clock from 125 MHz to 48 MHz while the controller runs
+// animations on its own or is suspended, and stop the system PLL. The full
+// clock is used while the host controls the lamps. Set to 0 to always run at
+// full speed.
+#define CFG_RGB_CLOCK_SCALING 1
+
+// The estimated power drawn by each lamp's (R, G, B) channels at full duty.
+// The number of entries must equal LAMP_COUNT (device/specs.h). These are used
+// to estimate the load of the connected lights for the power budget. Measure
+// the current of each channel with the lamp set to full red, green, or blue.
+//
+// Range: [0, 65535]
+// Units: Milliwatts
+#define CFG_RGB_LAMP_POWER \
+    {6000, 6000, 6000}, \
+    {6000, 6000, 6000}, \
+    {6000, 6000, 6000}, \
+    {6000, 6000, 6000},
+
+// The maximum estimated load of all lamps. When the lamp colors would exceed
+// this, all lamps are dimmed by the same factor to stay within the budget. Set
+// to 0 to disable the limit.
+//
+// Units: Milliwatts
+#define CFG_RGB_POWER_BUDGET 36000
+
+// The power budget is reduced linearly from CFG_RGB_POWER_BUDGET at the start
+// temperature to CFG_RGB_POWER_DERATE_MIN_BUDGET at the end temperature, as
+// measured by the internal temperature sensor.
+//
+// Units: Degrees Celsius
+#define CFG_RGB_POWER_DERATE_START_TEMP 50
+#define CFG_RGB_POWER_DERATE_END_TEMP   70
+
+// The power budget at and above CFG_RGB_POWER_DERATE_END_TEMP.
+//
+// Range: [0, CFG_RGB_POWER_BUDGET]
+// Units: Milliwatts
+#define CFG_RGB_POWER_DERATE_MIN_BUDGET 18000
+
+// Correct for LEDs dimming and shifting color as they warm up. Each entry of
+// the table is {temperature, red gain, green gain, blue gain}, sorted by
+// temperature. Gains are interpolated linearly between entries from the
+// internal temperature sensor, and the first or last entry is used outside the
+// table. The gains are applied with the power budget dimming, and the budget
+// includes them. Set CFG_RGB_TEMP_COMPENSATION to 1 to enable.
+//
+// Range: [-40, 120] for temperatures, [0, 2000] for gains
+// Units: Degrees Celsius, thousandths of full duty
+#define CFG_RGB_TEMP_COMPENSATION 0
+#define CFG_RGB_TEMP_COMPENSATION_TABLE \
+    {25, 1000, 1000, 1000}, \
+    {45, 1030, 1010, 1005}, \
+    {70, 1080, 1030, 1015},
+
 // The minimum update interval. This is the minimum amount of time a host must
 // wait between sending complete lamp update reports. Because this device does
 // nothing else, this defaults to the maximum update latency as determined by
@@ -91,9 +178,99 @@
 // Units: Hz
 #define CFG_RGB_ANIMATION_FRAME_RATE 120
 
+// Save the colors set by the host and the autonomous mode flag to flash so they
+// are restored immediately after a reset or power cycle, before the host
+// reconnects. Set to 1 to enable.
+#define CFG_RGB_PERSIST_LAMP_STATE 0
+
+// The minimum time between saves of the lamp state. Host updates within this
+// interval are combined into a single write, which limits flash wear when the
+// host animates the lamps.
+//
+// Range: [0, 2^31-1]
+// Units: Milliseconds
+#define CFG_RGB_PERSIST_LAMP_STATE_INTERVAL 10000
+
+// The timeout of the hardware watchdog. If the main loop does not run within
+// this time, the device reboots and resumes from the state saved before the
+// reboot. This must be longer than a flash sector erase. Set to 0 to disable
+// the watchdog.
+//
+// Range: [0, 8388]
+// Units: Milliseconds
+#define CFG_RGB_WATCHDOG_TIMEOUT 2000
+
+// Measure how long each main loop task and report handler takes, and count
+// late frames, dropped updates, rejected reports, and flash stalls. Timing
+// uses the microsecond timer, so durations do not depend on the system clock
+// speed. The results are read with the stats vendor report. Set to 0 to remove all
+// instrumentation.
+#define CFG_RGB_STATS 1
+
+// Keep a ring of compact binary trace events (USB reports, late frames, flash
+// stalls, suspend and resume, clock mode changes) that is cheap enough to leave
+// on in production.
+// The main loop sends the events to the host once it enables the trace stream.
+// Set to 0 to remove all tracing.
+#define CFG_RGB_TRACE 1
+
+// The number of events held by the trace ring. When the ring is full, new
+// events replace the oldest ones. Each event takes 12 bytes of RAM.
+//
+// Range: [2, 256], must be a power of 2
+// Units: Events
+#define CFG_RGB_TRACE_SIZE 64
+
+// Keep the most recent HID reports the device received or returned, with
+// their arrival time, result, and the first bytes of their payload. The host
+// reads them back with the recorder vendor report. Set to 0 to disable.
+#define CFG_RGB_RECORDER 1
+
+// The number of reports held by the recorder. When it is full, new reports
+// replace the oldest ones. Each report takes 17 bytes of RAM.
+//
+// Range: [2, 1024], must be a power of 2
+// Units: Reports
+#define CFG_RGB_RECORDER_DEPTH 128
+
+// Accept latency probes from the host and answer each one with the times it
+// was received, latched into the lamp outputs, and visible, so the host can
+// check CFG_RGB_LAMP_UPDATE_LATENCY. Set to 0 to disable.
+#define CFG_RGB_LATENCY_PROBE 1
+
+// Send device events (animation stages, scene switches, power budget dimming,
+// flash writes, and the last reset) to the host as they happen. The host
+// chooses the events it wants with the events vendor report. Set to 0 to
+// disable.
+#define CFG_RGB_EVENTS 1
+
+// The number of events held until the host reads them. When the queue is
+// full, new events replace the oldest ones. Each event takes 8 bytes of RAM.
+//
+// Range: [2, 256], must be a power of 2
+// Units: Events
+#define CFG_RGB_EVENTS_SIZE 16
+
 // The number of samples of the internal sensor to average for each
-// temperature reading.
-#define CFG_RGB_TEMP_SENSOR_SAMPLES 3
+// temperature reading. Samples are collected by DMA into a ring buffer of this
+// size, so it must be a power of two.
+//
+// Range: [2, 256]
+#define CFG_RGB_TEMP_SENSOR_SAMPLES 16
+
+// How often the ADC samples the internal sensor. The ADC runs in the
+// background, so this does not use any CPU time.
+//
+// Range: [733, 500000]
+// Units: Hertz
+#define CFG_RGB_TEMP_SENSOR_SAMPLE_RATE 1000
+
+// The strength of the low-pass filter applied to averaged readings. Each
+// update moves the filtered value 1/2^N of the way to the new average, so
+// larger values give smoother but slower readings.
+//
+// Range: [0, 8]
+#define CFG_RGB_TEMP_SENSOR_FILTER_SHIFT 3
 
 // The actual voltage of the ADC reference voltage used for the temperature
 // sensor. This will be the value of the external reference or the measured
@@ -109,4 +286,18 @@
 // Units: Degrees Celsius
 #define CFG_RGB_TEMP_SENSOR_ADJUST -5.0f
 
+// The default change in temperature required to send a new sensor report. The
+// host can override this with the change sensitivity feature properties. If 0,
+// send a report on every report interval.
+//
+// Range: [0, 65535]
+// Units: Hundredths of a degree Celsius
+#define CFG_RGB_TEMP_SENSOR_CHANGE_SENSITIVITY 25
+
+// The longest time between sensor reports, even if the temperature does not
+// change. If 0, only send reports when the temperature changes.
+//
+// Units: Milliseconds
+#define CFG_RGB_TEMP_SENSOR_MAX_REPORT_INTERVAL 60000
+
 #endif
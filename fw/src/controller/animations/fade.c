@@ -1,9 +1,9 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <stdlib.h>
 #include <string.h>
 
+#include "color/blend.h"
 #include "color/color.h"
 #include "controller/animations/fade.h"
 #include "controller/controller.h"
@@ -15,26 +15,18 @@ static inline uint32_t ms_to_us(uint16_t ms)
     return 1000 * (uint32_t) ms;
 }
 
-struct AnimationFade *anim_fade_new_empty()
+void anim_fade_init_empty(struct AnimationFade *fade)
 {
-    struct AnimationFade *fade = calloc(1, sizeof(struct AnimationFade));
-    if (fade == NULL) {
-        return NULL;
-    }
+    memset(fade, 0, sizeof(struct AnimationFade));
 
     fade->target_count = 2;
     anim_fade_set_fade_time_us(fade, 0, ms_to_us(1000));
     anim_fade_set_fade_time_us(fade, 1, ms_to_us(1000));
-
-    return fade;
 }
 
-struct AnimationFade *anim_fade_new_breathe(struct AnimationBreatheReportData *data)
+void anim_fade_init_breathe(struct AnimationFade *fade, struct AnimationBreatheReportData *data)
 {
-    struct AnimationFade *fade = anim_fade_new_empty();
-    if (fade == NULL) {
-        return NULL;
-    }
+    anim_fade_init_empty(fade);
 
     struct Lab targets[2];
     targets[0] = linear_rgb_to_oklab(rgb_to_linear_rgb(rgb_from_u8(data->on_color)));
@@ -45,16 +37,11 @@ struct AnimationFade *anim_fade_new_breathe(struct AnimationBreatheReportData *d
     anim_fade_set_hold_time_us(fade, 0, ms_to_us(data->on_time_ms));
     anim_fade_set_fade_time_us(fade, 1, ms_to_us(data->off_fade_time_ms > 0 ? data->off_fade_time_ms : data->on_fade_time_ms));
     anim_fade_set_hold_time_us(fade, 1, ms_to_us(data->off_time_ms));
-
-    return fade;
 }
 
-struct AnimationFade *anim_fade_new_fade(struct AnimationFadeReportData *data)
+void anim_fade_init_fade(struct AnimationFade *fade, struct AnimationFadeReportData *data)
 {
-    struct AnimationFade *fade = anim_fade_new_empty();
-    if (fade == NULL) {
-        return NULL;
-    }
+    anim_fade_init_empty(fade);
 
     uint8_t color_count = data->color_count;
     if (color_count > MAX_FADE_TARGETS) {
@@ -69,17 +56,28 @@ struct AnimationFade *anim_fade_new_fade(struct AnimationFadeReportData *data)
         anim_fade_set_hold_time_us(fade, i, ms_to_us(data->hold_time_ms));
     }
     anim_fade_set_targets(fade, targets, data->color_count);
-
-    return fade;
 }
 
 void anim_fade_set_targets(struct AnimationFade *fade, struct Lab *targets, uint8_t count)
 {
     count = count > MAX_FADE_TARGETS ? MAX_FADE_TARGETS : count;
 
-    memcpy(fade->targets, targets, count * sizeof(struct Lab));
+    // Interpolate in Oklab space from each target to the next
+    for (uint8_t t = 0; t < count; t++) {
+        struct Lab from = targets[t];
+        struct Lab to = targets[(t + 1) % count];
+
+        for (uint8_t i = 0; i < FADE_BLEND_SEGMENTS; i++) {
+            float s = ((float) i) / FADE_BLEND_SEGMENTS;
+            struct Lab lab = {
+                from.L + s * (to.L - from.L),
+                from.a + s * (to.a - from.a),
+                from.b + s * (to.b - from.b),
+            };
+            fade->path[t * FADE_BLEND_SEGMENTS + i] = rgb_to_u16(rgb_from_linear_rgb(oklab_to_linear_rgb(lab)));
+        }
+    }
     fade->target_count = count;
-    fade->current_color = targets[count - 1];
 }
 
 void anim_fade_set_fade_time_us(struct AnimationFade *fade, uint8_t stage, uint32_t fade_time)
@@ -98,81 +96,99 @@ void anim_fade_set_hold_time_us(struct AnimationFade *fade, uint8_t stage, uint3
     fade->hold_frames[stage] = hold_time / ANIM_FRAME_TIME_US;
 }
 
-static void anim_fade_set_diffs(struct AnimationFade *fade, uint8_t dest, uint8_t src)
+/**
+ * @brief Returns a point on the fade path, wrapping around after the last
+ * target.
+ */
+static inline struct RGBu16 *path_point(struct AnimationFade *fade, uint32_t index)
+{
+    uint32_t length = (uint32_t) fade->target_count * FADE_BLEND_SEGMENTS;
+    return &fade->path[index < length ? index : index - length];
+}
+
+/**
+ * @brief Starts a fade from the @p src target to the @p dest target.
+ */
+static void __time_critical_func(anim_fade_start)(struct AnimationFade *fade, uint8_t dest, uint8_t src)
 {
     uint32_t fade_frames = fade->fade_frames[dest];
-    if (fade_frames > 0) {
-        fade->Ldiff = (fade->targets[dest].L - fade->targets[src].L) / ((float) fade_frames);
-        fade->adiff = (fade->targets[dest].a - fade->targets[src].a) / ((float) fade_frames);
-        fade->bdiff = (fade->targets[dest].b - fade->targets[src].b) / ((float) fade_frames);
-    } else {
-        fade->Ldiff = 0.f;
-        fade->adiff = 0.f;
-        fade->bdiff = 0.f;
+    fade->path_start = (uint8_t) (src * FADE_BLEND_SEGMENTS);
+    fade->position = 0;
+    fade->step = fade_frames > 0 ? FADE_POSITION_END / fade_frames : FADE_POSITION_END;
+}
+
+/**
+ * @brief Returns the color at the current position of the fade.
+ */
+static struct RGBu16 __time_critical_func(anim_fade_color)(struct AnimationFade *fade)
+{
+    uint32_t segment = fade->position >> FADE_POSITION_SHIFT;
+    if (segment >= FADE_BLEND_SEGMENTS) {
+        return *path_point(fade, fade->path_start + FADE_BLEND_SEGMENTS);
     }
+
+    uint8_t alpha = (uint8_t) (fade->position >> (FADE_POSITION_SHIFT - 8));
+    struct RGBu16 *a = path_point(fade, fade->path_start + segment);
+    struct RGBu16 *b = path_point(fade, fade->path_start + segment + 1);
+    return (struct RGBu16) {
+        blend_channel(a->r, b->r, alpha),
+        blend_channel(a->g, b->g, alpha),
+        blend_channel(a->b, b->b, alpha),
+    };
 }
 
 #ifdef DEBUG_ANIMATE
-static void log_fade_stage(uint8_t stage, struct Lab current_color, struct Lab target_color)
+static void log_fade_stage(uint8_t stage, struct RGBu16 source_color, struct RGBu16 target_color)
 {
-    struct RGBu16 rgb;
     printf("animate/fade: start stage %d\n", stage);
-
-    rgb = rgb_to_u16(oklab_to_linear_rgb(current_color));
-    printf(
-        "    current color = oklab(% .8f, % .8f, % .8f) | rgb(%5d, %5d, %5d)\n",
-        current_color.L, current_color.a, current_color.b,
-        rgb.r, rgb.g, rgb.b
-    );
-
-    rgb = rgb_to_u16(oklab_to_linear_rgb(target_color));
-    printf(
-        "     target color = oklab(% .8f, % .8f, % .8f) | rgb(%5d, %5d, %5d)\n",
-        target_color.L, target_color.a, target_color.b,
-        rgb.r, rgb.g, rgb.b
-    );
+    printf("    source color = rgb(%5d, %5d, %5d)\n", source_color.r, source_color.g, source_color.b);
+    printf("    target color = rgb(%5d, %5d, %5d)\n", target_color.r, target_color.g, target_color.b);
 }
 #endif
 
-uint8_t anim_fade(controller_t *ctrl, uint8_t lamp_id, struct AnimationState *state)
+uint8_t __time_critical_func(anim_fade)(controller_t *ctrl, uint8_t lamp_id, struct AnimationState *state)
 {
     struct AnimationFade *fade = (struct AnimationFade *) state->data;
 
-    bool is_dirty = false;
     bool is_hold = (state->stage % 2) == 1;
 
     uint8_t target = state->stage / 2;
+    uint8_t source = (uint8_t) (target == 0 ? fade->target_count - 1 : target - 1);
     uint32_t stage_frames = 0;
 
     if (is_hold) {
+        stage_frames = fade->hold_frames[target];
+
         if (state->stage_frame == 0) {
+            struct RGBu16 color = fade->path[target * FADE_BLEND_SEGMENTS];
 #ifdef DEBUG_ANIMATE
-            log_fade_stage(state->stage, fade->current_color, fade->targets[target]);
+            log_fade_stage(state->stage, color, color);
 #endif
             // first frame of a hold, make sure we show the exact color
-            fade->current_color = fade->targets[target];
-            is_dirty = true;
+            ctrl_update_lamp(ctrl, lamp_id, lamp_value_from_rgb_u16(color), true);
         }
-        stage_frames = fade->hold_frames[target];
     } else {
+        stage_frames = fade->fade_frames[target];
+
         if (state->stage_frame == 0) {
 #ifdef DEBUG_ANIMATE
-            log_fade_stage(state->stage, fade->current_color, fade->targets[target]);
+            log_fade_stage(
+                state->stage,
+                fade->path[source * FADE_BLEND_SEGMENTS],
+                fade->path[target * FADE_BLEND_SEGMENTS]
+            );
 #endif
-            // starting a new fade stage, initialize fade diffs
-            anim_fade_set_diffs(fade, target, (uint8_t) (target == 0 ? fade->target_count - 1 : target - 1));
+            // starting a new fade stage, move to the precomputed blend points
+            anim_fade_start(fade, target, source);
         }
-        stage_frames = fade->fade_frames[target];
 
-        fade->current_color.L += fade->Ldiff;
-        fade->current_color.a += fade->adiff;
-        fade->current_color.b += fade->bdiff;
-        is_dirty = true;
-    }
-
-    if (is_dirty) {
-        struct RGB rgb = oklab_to_linear_rgb(fade->current_color);
-        ctrl_update_lamp(ctrl, lamp_id, lamp_value_from_linear_rgb(rgb), true);
+        if (stage_frames == 0 || state->stage_frame == stage_frames - 1) {
+            // last frame of a fade, make sure we reach the exact color
+            fade->position = FADE_POSITION_END;
+        } else {
+            fade->position += fade->step;
+        }
+        ctrl_update_lamp(ctrl, lamp_id, lamp_value_from_rgb_u16(anim_fade_color(fade)), true);
     }
 
     if (stage_frames == 0 || state->stage_frame == stage_frames - 1) {
@@ -185,6 +201,21 @@ uint8_t anim_fade(controller_t *ctrl, uint8_t lamp_id, struct AnimationState *st
 // Assertions
 // ----------
 
+static_assert(
+    sizeof(struct AnimationFade) <= ANIM_DATA_SIZE,
+    "struct AnimationFade is larger than the animation data block"
+);
+
+static_assert(
+    _Alignof(struct AnimationFade) <= ANIM_DATA_ALIGN,
+    "struct AnimationFade requires more alignment than the animation data block"
+);
+
+static_assert(
+    MAX_FADE_TARGETS * FADE_BLEND_SEGMENTS <= UINT8_MAX,
+    "fade path is too long for the path_start field"
+);
+
 static_assert(
     sizeof(struct AnimationBreatheReportData) <= ANIMATION_REPORT_DATA_SIZE,
     "struct AnimationBreatheReportData is larger than the report data size"
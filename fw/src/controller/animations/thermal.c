@@ -0,0 +1,162 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "color/blend.h"
+#include "color/color.h"
+#include "controller/animations/thermal.h"
+#include "controller/controller.h"
+#include "device/lamp.h"
+#include "device/temperature.h"
+#include "hid/vendor/report.h"
+
+static struct Lab stop_to_oklab(struct AnimationThermalStop *stop)
+{
+    return linear_rgb_to_oklab(rgb_to_linear_rgb(rgb_from_u8(stop->color)));
+}
+
+/**
+ * @brief Returns the gradient color at @p temperature, interpolating between
+ * stops in Oklab space.
+ */
+static struct RGBu16 gradient_color(struct AnimationThermalStop *stops, uint8_t count, float temperature)
+{
+    uint8_t next = 1;
+    while (next < count - 1 && stops[next].temperature < temperature) {
+        next++;
+    }
+
+    struct AnimationThermalStop *lo = &stops[next - 1];
+    struct AnimationThermalStop *hi = &stops[next];
+
+    float range = (float) (hi->temperature - lo->temperature);
+    float t = range > 0 ? (temperature - (float) lo->temperature) / range : 1.0f;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+
+    struct Lab from = stop_to_oklab(lo);
+    struct Lab to = stop_to_oklab(hi);
+    struct Lab lab = {
+        from.L + t * (to.L - from.L),
+        from.a + t * (to.a - from.a),
+        from.b + t * (to.b - from.b),
+    };
+    return rgb_to_u16(rgb_from_linear_rgb(oklab_to_linear_rgb(lab)));
+}
+
+void anim_thermal_init(struct AnimationThermal *thermal, struct AnimationThermalReportData *data)
+{
+    memset(thermal, 0, sizeof(struct AnimationThermal));
+
+    uint8_t count = data->stop_count;
+    if (count > MAX_THERMAL_STOPS) {
+        count = MAX_THERMAL_STOPS;
+    }
+
+    if (count > 0) {
+        struct AnimationThermalStop *stops = data->stops;
+        thermal->min_temperature = stops[0].temperature;
+        thermal->max_temperature = stops[count - 1].temperature;
+
+        if (count == 1 || thermal->max_temperature <= thermal->min_temperature) {
+            // A single color, so every table position is the same
+            struct RGBu16 color = rgb_to_u16(rgb_from_u8(stops[0].color));
+            for (uint8_t i = 0; i <= THERMAL_LUT_SEGMENTS; i++) {
+                thermal->lut[i] = color;
+            }
+            thermal->max_temperature = thermal->min_temperature;
+        } else {
+            float range = (float) (thermal->max_temperature - thermal->min_temperature);
+            for (uint8_t i = 0; i <= THERMAL_LUT_SEGMENTS; i++) {
+                float temperature = (float) thermal->min_temperature + range * (float) i / THERMAL_LUT_SEGMENTS;
+                thermal->lut[i] = gradient_color(stops, count, temperature);
+            }
+
+            uint32_t span = (uint32_t) (thermal->max_temperature - thermal->min_temperature);
+            thermal->lut_scale = ((uint32_t) THERMAL_LUT_SEGMENTS << THERMAL_POSITION_SHIFT) / span;
+        }
+    }
+
+    // A first-order filter with coefficient dt / (tau + dt) per frame
+    uint32_t tau_frames = 1000 * (uint32_t) data->smoothing_ms / ANIM_FRAME_TIME_US;
+    thermal->smooth_step = (1u << 16) / (tau_frames + 1);
+    thermal->hysteresis = data->hysteresis;
+
+    int16_t temperature = temperature_read();
+    thermal->smoothed = (int32_t) temperature * (1 << THERMAL_SMOOTH_SHIFT);
+    thermal->displayed = temperature;
+}
+
+/**
+ * @brief Returns the table color for a temperature.
+ */
+static struct RGBu16 __time_critical_func(anim_thermal_color)(struct AnimationThermal *thermal, int16_t temperature)
+{
+    if (temperature <= thermal->min_temperature) {
+        return thermal->lut[0];
+    }
+    if (temperature >= thermal->max_temperature) {
+        return thermal->lut[THERMAL_LUT_SEGMENTS];
+    }
+
+    uint32_t position = (uint32_t) (temperature - thermal->min_temperature) * thermal->lut_scale;
+    uint32_t index = position >> THERMAL_POSITION_SHIFT;
+    if (index >= THERMAL_LUT_SEGMENTS) {
+        return thermal->lut[THERMAL_LUT_SEGMENTS];
+    }
+
+    uint8_t alpha = (uint8_t) (position >> (THERMAL_POSITION_SHIFT - 8));
+    struct RGBu16 *a = &thermal->lut[index];
+    struct RGBu16 *b = &thermal->lut[index + 1];
+    return (struct RGBu16) {
+        blend_channel(a->r, b->r, alpha),
+        blend_channel(a->g, b->g, alpha),
+        blend_channel(a->b, b->b, alpha),
+    };
+}
+
+/**
+ * @brief Divides by 2^shift, rounding halves away from zero so that the
+ * filter settles on the target from above and below alike.
+ */
+static inline int32_t round_shift(int64_t value, unsigned shift)
+{
+    int64_t half = (int64_t) 1 << (shift - 1);
+    return value >= 0 ? (int32_t) ((value + half) >> shift) : -(int32_t) ((half - value) >> shift);
+}
+
+uint8_t __time_critical_func(anim_thermal)(controller_t *ctrl, uint8_t lamp_id, struct AnimationState *state)
+{
+    struct AnimationThermal *thermal = (struct AnimationThermal *) state->data;
+
+    // The temperature reading is cached, so this is cheap enough for every frame
+    int32_t target = (int32_t) temperature_read() * (1 << THERMAL_SMOOTH_SHIFT);
+    thermal->smoothed += round_shift(((int64_t) target - thermal->smoothed) * thermal->smooth_step, 16);
+
+    int16_t smoothed = (int16_t) round_shift(thermal->smoothed, THERMAL_SMOOTH_SHIFT);
+    if (state->frame == 0 || abs(smoothed - thermal->displayed) >= thermal->hysteresis) {
+        thermal->displayed = smoothed;
+        ctrl_update_lamp(ctrl, lamp_id, lamp_value_from_rgb_u16(anim_thermal_color(thermal, smoothed)), true);
+    }
+
+    return 0;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    sizeof(struct AnimationThermal) <= ANIM_DATA_SIZE,
+    "struct AnimationThermal is larger than the animation data block"
+);
+
+static_assert(
+    _Alignof(struct AnimationThermal) <= ANIM_DATA_ALIGN,
+    "struct AnimationThermal requires more alignment than the animation data block"
+);
+
+static_assert(
+    sizeof(struct AnimationThermalReportData) <= ANIMATION_REPORT_DATA_SIZE,
+    "struct AnimationThermalReportData is larger than the report data size"
+);
@@ -0,0 +1,186 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "color/blend.h"
+#include "controller/calibration.h"
+#include "controller/persist.h"
+#include "device/lamp.h"
+#include "device/specs.h"
+#include "hid/vendor/report.h"
+
+/*
+ * Each channel of each lamp has its own curve. Curves are stored in flash as
+ * one record per channel. At startup and whenever a curve changes, the curve
+ * is combined with sRGB decoding into a table with the PWM duty for each 8-bit
+ * lamp level, so applying calibration in the commit path is one table lookup
+ * and one blend per channel.
+ */
+
+#define CALIBRATION_KEY(lamp_id, channel) ((uint8_t) ((lamp_id) * CALIBRATION_CHANNELS + (channel)))
+#define CALIBRATION_SEGMENT_MASK ((1u << CALIBRATION_SEGMENT_BITS) - 1)
+
+/**
+ * The linear light output for each 8-bit sRGB level, where 65535 is full
+ * output.
+ */
+static const uint16_t srgb_to_linear[CALIBRATION_TABLE_SIZE] = {
+        0,    20,    40,    60,    80,    99,   119,   139,
+      159,   179,   199,   219,   241,   264,   288,   313,
+      340,   367,   396,   427,   458,   491,   526,   562,
+      599,   637,   677,   718,   761,   805,   851,   898,
+      947,   997,  1048,  1101,  1156,  1212,  1270,  1330,
+     1391,  1453,  1517,  1583,  1651,  1720,  1790,  1863,
+     1937,  2013,  2090,  2170,  2250,  2333,  2418,  2504,
+     2592,  2681,  2773,  2866,  2961,  3058,  3157,  3258,
+     3360,  3464,  3570,  3678,  3788,  3900,  4014,  4129,
+     4247,  4366,  4488,  4611,  4736,  4864,  4993,  5124,
+     5257,  5392,  5530,  5669,  5810,  5953,  6099,  6246,
+     6395,  6547,  6700,  6856,  7014,  7174,  7335,  7500,
+     7666,  7834,  8004,  8177,  8352,  8528,  8708,  8889,
+     9072,  9258,  9445,  9635,  9828, 10022, 10219, 10417,
+    10619, 10822, 11028, 11235, 11446, 11658, 11873, 12090,
+    12309, 12530, 12754, 12980, 13209, 13440, 13673, 13909,
+    14146, 14387, 14629, 14874, 15122, 15371, 15623, 15878,
+    16135, 16394, 16656, 16920, 17187, 17456, 17727, 18001,
+    18277, 18556, 18837, 19121, 19407, 19696, 19987, 20281,
+    20577, 20876, 21177, 21481, 21787, 22096, 22407, 22721,
+    23038, 23357, 23678, 24002, 24329, 24658, 24990, 25325,
+    25662, 26001, 26344, 26688, 27036, 27386, 27739, 28094,
+    28452, 28813, 29176, 29542, 29911, 30282, 30656, 31033,
+    31412, 31794, 32179, 32567, 32957, 33350, 33745, 34143,
+    34544, 34948, 35355, 35764, 36176, 36591, 37008, 37429,
+    37852, 38278, 38706, 39138, 39572, 40009, 40449, 40891,
+    41337, 41785, 42236, 42690, 43147, 43606, 44069, 44534,
+    45002, 45473, 45947, 46423, 46903, 47385, 47871, 48359,
+    48850, 49344, 49841, 50341, 50844, 51349, 51858, 52369,
+    52884, 53401, 53921, 54445, 54971, 55500, 56032, 56567,
+    57105, 57646, 58190, 58737, 59287, 59840, 60396, 60955,
+    61517, 62082, 62650, 63221, 63795, 64372, 64952, 65535,
+};
+
+static struct CalibrationCurve curves[LAMP_COUNT][CALIBRATION_CHANNELS];
+static uint16_t tables[LAMP_COUNT][CALIBRATION_CHANNELS][CALIBRATION_TABLE_SIZE + 1];
+
+static uint8_t selected_lamp_id;
+static uint8_t selected_channel;
+
+static void set_identity(struct CalibrationCurve *curve)
+{
+    for (uint32_t i = 0; i < CALIBRATION_POINTS; i++) {
+        uint32_t value = i << CALIBRATION_SEGMENT_BITS;
+        curve->points[i] = value > UINT16_MAX ? UINT16_MAX : (uint16_t) value;
+    }
+}
+
+static uint16_t apply_curve(const struct CalibrationCurve *curve, uint16_t value)
+{
+    uint32_t index = value >> CALIBRATION_SEGMENT_BITS;
+    int32_t frac = (int32_t) (value & CALIBRATION_SEGMENT_MASK);
+
+    int32_t a = curve->points[index];
+    int32_t b = curve->points[index + 1];
+    return (uint16_t) (a + (((b - a) * frac) >> CALIBRATION_SEGMENT_BITS));
+}
+
+static void build_table(uint8_t lamp_id, uint8_t channel)
+{
+    const struct CalibrationCurve *curve = &curves[lamp_id][channel];
+    uint16_t *table = tables[lamp_id][channel];
+    for (uint32_t i = 0; i < CALIBRATION_TABLE_SIZE; i++) {
+        table[i] = apply_curve(curve, srgb_to_linear[i]);
+    }
+    table[CALIBRATION_TABLE_SIZE] = table[CALIBRATION_TABLE_SIZE - 1];
+}
+
+/**
+ * @brief Looks up a 16-bit sRGB channel value in a table.
+ *
+ * Level i of the table is the 16-bit value i * 257. Subtracting value >> 8
+ * maps those values exactly to i << 8, including 65535 to the last level, and
+ * the low 8 bits then blend to the next level.
+ */
+static inline uint16_t lookup(const uint16_t *table, uint16_t value)
+{
+    uint32_t position = (uint32_t) (value - (value >> 8));
+    uint32_t index = position >> 8;
+    return blend_channel(table[index], table[index + 1], (uint8_t) position);
+}
+
+void ctrl_calibration_init()
+{
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        for (uint8_t channel = 0; channel < CALIBRATION_CHANNELS; channel++) {
+            uint16_t length;
+            const struct CalibrationCurve *saved =
+                ctrl_persist_find(PERSIST_RECORD_CALIBRATION, CALIBRATION_KEY(id, channel), &length);
+            if (saved != NULL && length == sizeof(struct CalibrationCurve)) {
+                curves[id][channel] = *saved;
+            } else {
+                set_identity(&curves[id][channel]);
+            }
+            build_table(id, channel);
+        }
+    }
+
+    selected_lamp_id = 0;
+    selected_channel = 0;
+}
+
+struct LampValue __time_critical_func(ctrl_calibration_apply)(uint8_t lamp_id, struct LampValue value)
+{
+    const uint16_t (*lamp_tables)[CALIBRATION_TABLE_SIZE + 1] = tables[lamp_id];
+    value.r = lookup(lamp_tables[0], value.r);
+    value.g = lookup(lamp_tables[1], value.g);
+    value.b = lookup(lamp_tables[2], value.b);
+    return value;
+}
+
+const struct CalibrationCurve *ctrl_calibration_get(uint8_t lamp_id, uint8_t channel)
+{
+    return &curves[lamp_id][channel];
+}
+
+void ctrl_calibration_set(uint8_t lamp_id, uint8_t channel, const struct CalibrationCurve *curve)
+{
+    curves[lamp_id][channel] = *curve;
+    build_table(lamp_id, channel);
+}
+
+bool ctrl_calibration_save(uint8_t lamp_id, uint8_t channel)
+{
+    return ctrl_persist_save_async(PERSIST_RECORD_CALIBRATION, CALIBRATION_KEY(lamp_id, channel),
+                                   &curves[lamp_id][channel], sizeof(struct CalibrationCurve));
+}
+
+bool ctrl_calibration_reset(uint8_t lamp_id, uint8_t channel)
+{
+    set_identity(&curves[lamp_id][channel]);
+    build_table(lamp_id, channel);
+    return ctrl_persist_save_async(PERSIST_RECORD_CALIBRATION, CALIBRATION_KEY(lamp_id, channel), NULL, 0);
+}
+
+void ctrl_calibration_select(uint8_t lamp_id, uint8_t channel)
+{
+    selected_lamp_id = lamp_id;
+    selected_channel = channel;
+}
+
+void ctrl_calibration_get_selected(uint8_t *lamp_id, uint8_t *channel)
+{
+    *lamp_id = selected_lamp_id;
+    *channel = selected_channel;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    (CALIBRATION_POINTS - 1) << CALIBRATION_SEGMENT_BITS == 1 << 16,
+    "calibration points must span the 16-bit input range"
+);
+
+static_assert(CALIBRATION_TABLE_SIZE == 1 << 8, "calibration tables must have one level per 8-bit sRGB value");
+
+static_assert(CALIBRATION_POINTS == CALIBRATION_REPORT_POINTS, "calibration report must have one value per point");
@@ -1,19 +1,31 @@
 #include <stdbool.h>
 #include <stdint.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "hardware/sync.h"
 #include "pico/time.h"
 
 #include "controller/animations/fade.h"
+#include "controller/animations/thermal.h"
+#include "controller/calibration.h"
 #include "controller/controller.h"
+#include "controller/persist.h"
+#include "controller/power.h"
 #include "device/lamp.h"
 #include "device/specs.h"
+#include "device/temperature.h"
 #include "hid/lights/report.h"
+#include "events.h"
+#include "latency.h"
+#include "stats.h"
+#include "trace.h"
 
-static struct AnimationState get_initial_animation_state(void *);
+static void reset_animation_state(struct AnimationState *);
 static void ctrl_animation_frame(controller_t *, uint8_t);
+static void commit_lamp_updates(controller_t *);
+static void checkpoint_lamp_state(controller_t *);
+static void record_first_light(controller_t *);
+static void set_lamp_output(controller_t *, uint8_t, struct LampValue);
 
 void ctrl_init(controller_t *ctrl)
 {
@@ -22,16 +34,26 @@ void ctrl_init(controller_t *ctrl)
     ctrl->next_lamp_id = 0;
 
     ctrl->do_update = false;
+    ctrl->refresh_lamps = true;
     memset(ctrl->lamp_state, 0, sizeof(ctrl->lamp_state));
 
+    ctrl_power_init(&ctrl->power);
+    ctrl->last_power_update = nil_time;
+
     for (uint8_t i = 0; i < LAMP_COUNT; i++) {
-        ctrl->animation[i] = get_initial_animation_state(NULL);
+        reset_animation_state(&ctrl->animation[i]);
         ctrl->frame_cb[i] = NULL;
     }
     ctrl->last_frame = nil_time;
+    ctrl->missed_frames = 0;
+
+    ctrl->checkpoint_dirty = false;
+    ctrl->last_checkpoint = nil_time;
+
+    ctrl->first_light_us = 0;
 }
 
-void ctrl_task(controller_t *ctrl)
+void __time_critical_func(ctrl_task)(controller_t *ctrl)
 {
     if (ctrl->is_suspended) {
         return;
@@ -42,29 +64,135 @@ void ctrl_task(controller_t *ctrl)
         absolute_time_t now = get_absolute_time();
         int64_t elapsed_us = absolute_time_diff_us(ctrl->last_frame, now);
         if (elapsed_us >= ANIM_FRAME_TIME_US) {
-            for (uint8_t id = 0; id < LAMP_COUNT; id++) {
-                ctrl_animation_frame(ctrl, id);
+            // If the main loop was blocked for more than one frame (e.g. by a
+            // flash operation), run the missed frames so animations stay in
+            // phase. Only the last frame is visible. After long gaps, like
+            // the first frame or leaving host mode, just start again.
+            uint32_t frames = 1;
+            if (!is_nil_time(ctrl->last_frame) && elapsed_us < ANIM_MAX_CATCHUP_FRAMES * ANIM_FRAME_TIME_US) {
+                frames = (uint32_t) elapsed_us / ANIM_FRAME_TIME_US;
+                ctrl->last_frame = delayed_by_us(ctrl->last_frame, frames * ANIM_FRAME_TIME_US);
+            } else {
+                ctrl->last_frame = now;
+            }
+            ctrl->missed_frames += frames - 1;
+            STATS_COUNT(STATS_COUNTER_FRAME_OVERRUNS, frames - 1);
+            if (frames > 1) {
+                TRACE(TRACE_EVENT_FRAME_OVERRUN, 0, 0, frames - 1);
+            }
+
+            for (uint32_t f = 0; f < frames; f++) {
+                for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+                    STATS_TIME(STATS_TIMER_ANIMATION_FRAME, ctrl_animation_frame(ctrl, id));
+                }
             }
-            ctrl->last_frame = now;
         }
     }
 
-    // Apply pending changes to LEDs
-    if (ctrl->do_update) {
-        for (uint8_t id = 0; id < LAMP_COUNT; id++) {
-            lamp_state *state = &ctrl->lamp_state[id];
-            if (state->dirty) {
-                lamp_set_value(id, state->next);
+    // Apply pending changes to LEDs. The power budget also depends on the
+    // temperature, so update it periodically even if nothing changed.
+    int64_t since_power_update = absolute_time_diff_us(ctrl->last_power_update, get_absolute_time());
+    if (ctrl->do_update || ctrl->refresh_lamps || since_power_update >= POWER_DERATE_INTERVAL_US) {
+        commit_lamp_updates(ctrl);
+    }
+
+#if CFG_RGB_PERSIST_LAMP_STATE
+    if (ctrl->checkpoint_dirty) {
+        checkpoint_lamp_state(ctrl);
+    }
+#endif
+}
+
+/**
+ * @brief Sets pending lamp values on the PWM outputs, calibrated and dimmed to
+ * stay within the power budget.
+ */
+static void __time_critical_func(commit_lamp_updates)(controller_t *ctrl)
+{
+    bool changed[LAMP_COUNT];
+    struct LampValue values[LAMP_COUNT];
+
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        lamp_state *state = &ctrl->lamp_state[id];
+        changed[id] = ctrl->do_update && state->dirty;
+        if (changed[id]) {
+            state->current = state->next;
+            memset(&state->next, 0, sizeof(struct LampValue));
+            state->dirty = false;
+        }
+        values[id] = ctrl_calibration_apply(id, state->current);
+    }
+
+    // If the dimming or calibration changed, every lamp must be set again
+    bool rescaled = ctrl_power_update(&ctrl->power, values, temperature_read());
+    ctrl->last_power_update = get_absolute_time();
 
-                state->current = state->next;
-                memset(&state->next, 0, sizeof(struct LampValue));
-                state->dirty = false;
+    bool refresh = rescaled || ctrl->refresh_lamps;
+    ctrl->refresh_lamps = false;
+
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        if (changed[id] || refresh) {
+            set_lamp_output(ctrl, id, ctrl_power_apply(&ctrl->power, values[id]));
+            if (ctrl->first_light_us == 0 && values[id].i > 0) {
+                record_first_light(ctrl);
             }
         }
+    }
+    LATENCY_LATCHED();
+
+    if (ctrl->do_update) {
         ctrl->do_update = false;
+
+        // Animations are restored from their saved defaults, so only host
+        // updates need a checkpoint
+        if (!ctrl->is_autonomous) {
+            ctrl->checkpoint_dirty = true;
+        }
     }
 }
 
+/**
+ * @brief Queues a save of the current lamp state if enough time has passed
+ * since the last save.
+ */
+static void checkpoint_lamp_state(controller_t *ctrl)
+{
+    absolute_time_t now = get_absolute_time();
+    if (absolute_time_diff_us(ctrl->last_checkpoint, now) < CFG_RGB_PERSIST_LAMP_STATE_INTERVAL * 1000ll) {
+        return;
+    }
+
+    struct LampStateCheckpoint checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+
+    checkpoint.is_autonomous = ctrl->is_autonomous;
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        checkpoint.values[id] = ctrl->lamp_state[id].current;
+    }
+
+    // If the queue is full, stay dirty and try again after the next interval
+    if (ctrl_persist_save_async(PERSIST_RECORD_LAMP_STATE, 0, &checkpoint, sizeof(checkpoint))) {
+        ctrl->checkpoint_dirty = false;
+    }
+    ctrl->last_checkpoint = now;
+}
+
+static void __time_critical_func(record_first_light)(controller_t *ctrl)
+{
+    // Reported to the host in the status report
+    ctrl->first_light_us = (uint32_t) time_us_64();
+}
+
+/**
+ * @brief Writes a duty to a lamp's outputs and remembers it for warm boot
+ * snapshots.
+ */
+static void __time_critical_func(set_lamp_output)(controller_t *ctrl, uint8_t lamp_id, struct LampValue value)
+{
+    ctrl->lamp_state[lamp_id].output = value;
+    lamp_set_value(lamp_id, value);
+}
+
 void ctrl_suspend(controller_t *ctrl)
 {
     // turn off all lamps immediately, but mark them as dirty for the next task
@@ -74,7 +202,7 @@ void ctrl_suspend(controller_t *ctrl)
         state->dirty = true;
         state->next = state->current;
 
-        lamp_set_value(id, lamp_value_off());
+        set_lamp_output(ctrl, id, lamp_value_off());
     }
 
     ctrl->is_suspended = true;
@@ -86,21 +214,19 @@ void ctrl_resume(controller_t *ctrl)
     ctrl->is_suspended = false;
 }
 
-static inline struct AnimationState get_initial_animation_state(void *data)
+static inline void reset_animation_state(struct AnimationState *state)
 {
-    struct AnimationState state = {
-        .stage = 0,
-        .frame = 0,
-        .stage_frame = 0,
-        .data = data,
-    };
-    return state;
+    state->type = ANIMATION_TYPE_NONE;
+    state->stage = 0;
+    state->frame = 0;
+    state->stage_frame = 0;
+    memset(state->data, 0, sizeof(state->data));
 }
 
 /**
  * @brief Processes a single frame of animation for a lamp.
  */
-static void ctrl_animation_frame(controller_t *ctrl, uint8_t lamp_id)
+static void __time_critical_func(ctrl_animation_frame)(controller_t *ctrl, uint8_t lamp_id)
 {
     FrameCallback frame_cb = ctrl->frame_cb[lamp_id];
     if (frame_cb == NULL) {
@@ -116,6 +242,7 @@ static void ctrl_animation_frame(controller_t *ctrl, uint8_t lamp_id)
     if (state->stage != next_stage) {
         state->stage = next_stage;
         state->stage_frame = 0;
+        EVENTS_POST(EVENTS_ANIMATION_STAGE, lamp_id, next_stage);
 
         // returning to stage 0 resets the full animation
         if (next_stage == 0) {
@@ -154,9 +281,48 @@ void ctrl_get_lamp_attributes(controller_t *ctrl, struct LampAttributesResponseR
     report->input_binding = 0x00;
 }
 
-void ctrl_update_lamp(controller_t *ctrl, uint8_t lamp_id, struct LampValue value, bool apply)
+void ctrl_get_status(controller_t *ctrl, struct Vendor12VRGBStatusReport *report)
+{
+    report->flags = 0;
+    if (ctrl->is_autonomous) {
+        report->flags |= VENDOR_STATUS_FLAG_AUTONOMOUS;
+    }
+    if (ctrl->is_suspended) {
+        report->flags |= VENDOR_STATUS_FLAG_SUSPENDED;
+    }
+    if (ctrl_persist_find(PERSIST_RECORD_LAMP_STATE, 0, NULL) != NULL) {
+        report->flags |= VENDOR_STATUS_FLAG_CHECKPOINT_SAVED;
+    }
+
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        struct LampValue current = ctrl->lamp_state[id].current;
+        report->red[id] = current.r;
+        report->green[id] = current.g;
+        report->blue[id] = current.b;
+        report->intensity[id] = current.i;
+
+        const struct AnimationState *state = &ctrl->animation[id];
+        report->animation_type[id] = state->type;
+        report->animation_stage[id] = state->stage;
+        report->animation_frame[id] = state->frame;
+
+        const struct Vendor12VRGBAnimationReport *saved = ctrl_persist_find_report(id);
+        report->default_animation_type[id] = saved != NULL ? saved->type : VENDOR_STATUS_NO_DEFAULT;
+    }
+
+    report->first_light_us = ctrl->first_light_us;
+}
+
+void __time_critical_func(ctrl_update_lamp)(controller_t *ctrl, uint8_t lamp_id, struct LampValue value, bool apply)
 {
     lamp_state *state = &ctrl->lamp_state[lamp_id];
+
+    // Animations may run several frames before a commit to catch up, so only
+    // count host values that are replaced
+    if (state->dirty && !ctrl->is_autonomous) {
+        STATS_COUNT(STATS_COUNTER_DROPPED_UPDATES, 1);
+    }
+
     state->next = value;
     state->dirty = true;
 
@@ -170,8 +336,16 @@ void ctrl_apply_lamp_updates(controller_t *ctrl)
     ctrl->do_update = true;
 }
 
+void ctrl_refresh_lamps(controller_t *ctrl)
+{
+    ctrl->refresh_lamps = true;
+}
+
 void ctrl_set_autonomous_mode(controller_t *ctrl, bool autonomous)
 {
+    if (ctrl->is_autonomous != autonomous) {
+        ctrl->checkpoint_dirty = true;
+    }
     ctrl->is_autonomous = autonomous;
 }
 
@@ -180,15 +354,34 @@ bool ctrl_get_autonomous_mode(controller_t *ctrl)
     return ctrl->is_autonomous;
 }
 
-void ctrl_set_animation(controller_t *ctrl, uint8_t lamp_id, FrameCallback frame_cb, void *data)
+bool ctrl_restore_checkpoint(controller_t *ctrl)
 {
-    void *old_data = ctrl->animation[lamp_id].data;
-    if (old_data != NULL) {
-        free(old_data);
+    uint16_t length;
+    const struct LampStateCheckpoint *checkpoint = ctrl_persist_find(PERSIST_RECORD_LAMP_STATE, 0, &length);
+    if (checkpoint == NULL || length != sizeof(struct LampStateCheckpoint)) {
+        return false;
     }
 
+    // Set the current values instead of using ctrl_update_lamp so that
+    // restoring the state does not trigger another checkpoint
+    ctrl->is_autonomous = checkpoint->is_autonomous;
+    if (!ctrl->is_autonomous) {
+        for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+            ctrl->lamp_state[id].current = checkpoint->values[id];
+        }
+        ctrl_refresh_lamps(ctrl);
+    }
+    return true;
+}
+
+void *ctrl_set_animation(controller_t *ctrl, uint8_t lamp_id, FrameCallback frame_cb)
+{
+    struct AnimationState *state = &ctrl->animation[lamp_id];
+
     ctrl->frame_cb[lamp_id] = frame_cb;
-    ctrl->animation[lamp_id] = get_initial_animation_state(data);
+    reset_animation_state(state);
+
+    return state->data;
 }
 
 // --------------------------
@@ -199,21 +392,28 @@ static void set_animation_none(controller_t *ctrl, struct Vendor12VRGBAnimationR
 {
     // Setting the "none" animation will also turn off the lamp
     ctrl_update_lamp(ctrl, report->lamp_id, lamp_value_off(), true);
-    ctrl_set_animation(ctrl, report->lamp_id, NULL, NULL);
+    ctrl_set_animation(ctrl, report->lamp_id, NULL);
 }
 
 static void set_animation_breathe(controller_t *ctrl, struct Vendor12VRGBAnimationReport *report)
 {
     struct AnimationBreatheReportData *data = (struct AnimationBreatheReportData *) report->data;
-    struct AnimationFade *fade = anim_fade_new_breathe(data);
-    ctrl_set_animation(ctrl, report->lamp_id, anim_fade, fade);
+    struct AnimationFade *fade = ctrl_set_animation(ctrl, report->lamp_id, anim_fade);
+    anim_fade_init_breathe(fade, data);
 }
 
 static void set_animation_fade(controller_t *ctrl, struct Vendor12VRGBAnimationReport *report)
 {
     struct AnimationFadeReportData *data = (struct AnimationFadeReportData *) report->data;
-    struct AnimationFade *fade = anim_fade_new_fade(data);
-    ctrl_set_animation(ctrl, report->lamp_id, anim_fade, fade);
+    struct AnimationFade *fade = ctrl_set_animation(ctrl, report->lamp_id, anim_fade);
+    anim_fade_init_fade(fade, data);
+}
+
+static void set_animation_thermal(controller_t *ctrl, struct Vendor12VRGBAnimationReport *report)
+{
+    struct AnimationThermalReportData *data = (struct AnimationThermalReportData *) report->data;
+    struct AnimationThermal *thermal = ctrl_set_animation(ctrl, report->lamp_id, anim_thermal);
+    anim_thermal_init(thermal, data);
 }
 
 void ctrl_set_animation_from_report(controller_t *ctrl, struct Vendor12VRGBAnimationReport *report)
@@ -230,5 +430,14 @@ void ctrl_set_animation_from_report(controller_t *ctrl, struct Vendor12VRGBAnima
     case ANIMATION_TYPE_FADE:
         set_animation_fade(ctrl, report);
         break;
+
+    case ANIMATION_TYPE_THERMAL:
+        set_animation_thermal(ctrl, report);
+        break;
+
+    default:
+        return;
     }
+
+    ctrl->animation[report->lamp_id].type = report->type;
 }
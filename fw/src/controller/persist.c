@@ -1,208 +1,740 @@
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "hardware/flash.h"
 #include "hardware/sync.h"
+#include "pico/time.h"
 
+#include "controller/controller.h"
 #include "controller/persist.h"
 #include "debug.h"
 #include "device/lamp.h"
 #include "device/specs.h"
+#include "events.h"
 #include "hid/vendor/report.h"
+#include "stats.h"
+#include "trace.h"
 
 /*
- * Default settings are stored in flash as report structs used in the HID
- * interface. This makes it easy to use the same code to initialize animations
- * on startup.
+ * Settings are stored in the last PERSIST_FLASH_SIZE bytes of flash as a log
+ * of typed records spread over PERSIST_SECTOR_COUNT sectors.
  *
- * Settings are stored in the last PERSIST_FLASH_SIZE bytes of flash. Reports
- * are written from the start of the sector until it is full, with
- * PERSIST_REPORTS_PER_PAGE reports in each flash page.
+ * Each sector starts with a header containing a magic value, the number of
+ * times the sector was erased, and a sequence number. The sequence number is
+ * left erased (0xFFFFFFFF) until the sector becomes active, so an erased sector
+ * with a header is a spare. Both values are stored with an inverted copy so
+ * that an interrupted write is detected.
  *
- * To load settings, walk through reports to find the last report for the lamp
- * ID. To save settings, find the first empty slot and write the report there.
+ * After the header, records are appended to the active sector. Each record is
+ * an 8-byte header (marker, type, key, length, CRC) followed by the data,
+ * padded to PERSIST_RECORD_ALIGN bytes. A record with a length of 0 deletes
+ * any earlier record with the same type and key. Records never span sectors.
  *
- * Each slot starts with a two-byte marker (0x01ed, "led"). If this marker word
- * is 0xFFFF, assume the slot is empty.
+ * On startup, read all sectors in sequence order and store the address of the
+ * last record for each type and key in a RAM index. Lookups only use the
+ * index. If a record is corrupt (e.g. power was lost while writing it), ignore
+ * it and the rest of the sector and consider the sector full.
  *
- * On startup, check the marker word in all slots. If any slot has a marker
- * that is not empty and is not the expected value, erase memory range.
+ * When the active sector is full, activate the spare sector. Then copy any
+ * records in the oldest sector that are still in the index to the new active
+ * sector and erase the oldest sector to create a new spare. Because records
+ * are copied before the erase, losing power at any point loses at most the
+ * record being written. Sectors are used in rotation, spreading wear evenly.
  *
- * If all slots are full, reclaim space by finding the most recent report for
- * each lamp, erasing flash, and then writing the most recent reports at the
- * start of the sector. This reduces wear from write-erase cycles.
+ * Programming and erasing flash disables interrupts, so the USB callbacks only
+ * queue records with ctrl_persist_save_async. ctrl_persist_task then performs
+ * one flash operation per call: writing a record, activating a sector and
+ * copying live records to it, or erasing a reclaimed sector. Queued records
+ * for the same type and key are combined, so only the latest data is written.
+ * Erasing takes much longer than writing, so a reclaimed sector is only erased
+ * once no records have been queued for PERSIST_ERASE_DELAY_US. If the active
+ * sector fills up before then, activating the spare finishes the erase first.
  */
 
-#define EACH_REPORT_SLOT \
-    (void *slot = PERSIST_ADDR(0); slot < PERSIST_ADDR(PERSIST_FLASH_SIZE); slot += PERSIST_REPORT_SLOT_SIZE) 
+#define SECTOR_MAGIC        0x52474231 /* "RGB1" */
+#define SEQUENCE_SPARE      0xFFFFFFFF
 
-static bool is_empty_slot(void *slot);
-static bool is_flash_in_known_state();
-static struct Vendor12VRGBAnimationReport *get_report(void *slot);
-static void *reclaim_report_slots(uint8_t *pagebuf, uint8_t target_lamp_id);
-static void write_flash_page(uint8_t *pagebuf, uint32_t page_num);
-static void write_reports(uint8_t *pagebuf, uint32_t offset, struct Vendor12VRGBAnimationReport *reports, uint8_t count);
+#define SECTOR_ADDR(sector) PERSIST_ADDR((sector) * FLASH_SECTOR_SIZE)
+
+#define RECORD_SIZE(length) \
+    ((uint32_t) ((sizeof(struct PersistRecord) + (length) + PERSIST_RECORD_ALIGN - 1) & ~(PERSIST_RECORD_ALIGN - 1u)))
+
+#define RECORD_DATA_OFFSET  (RECORD_SIZE(0))
+
+struct PersistSectorHeader {
+    uint32_t magic;
+    uint32_t erase_count;
+    uint32_t erase_count_inv;
+    uint32_t sequence;
+    uint32_t sequence_inv;
+    uint32_t reserved;
+};
+
+struct PersistRecord {
+    uint16_t marker;
+    uint8_t type;
+    uint8_t key;
+    uint16_t length;
+    uint16_t crc;
+};
+
+enum SectorState {
+    SECTOR_INVALID,
+    SECTOR_SPARE,
+    SECTOR_USED,
+};
+
+struct SectorInfo {
+    enum SectorState state;
+    uint32_t erase_count;
+    uint32_t sequence;
+    uint32_t write_offset;
+};
+
+struct RecordTypeInfo {
+    uint16_t index;
+    uint16_t keys;
+};
+
+// The start of each record type's entries in the index
+#define INDEX_ANIMATION     0
+#define INDEX_LAMP_STATE    (INDEX_ANIMATION + PERSIST_ANIMATION_KEYS)
+#define INDEX_SCENE_LAMP    (INDEX_LAMP_STATE + PERSIST_LAMP_STATE_KEYS)
+#define INDEX_SCENE_NAME    (INDEX_SCENE_LAMP + PERSIST_SCENE_LAMP_KEYS)
+#define INDEX_SCENE_RULES   (INDEX_SCENE_NAME + PERSIST_SCENE_NAME_KEYS)
+#define INDEX_CALIBRATION   (INDEX_SCENE_RULES + PERSIST_SCENE_RULES_KEYS)
+#define INDEX_SIZE          (INDEX_CALIBRATION + PERSIST_CALIBRATION_KEYS)
+
+static const struct RecordTypeInfo record_types[PERSIST_RECORD_TYPE_COUNT] = {
+    [PERSIST_RECORD_ANIMATION]      = { .index = INDEX_ANIMATION, .keys = PERSIST_ANIMATION_KEYS },
+    [PERSIST_RECORD_LAMP_STATE]     = { .index = INDEX_LAMP_STATE, .keys = PERSIST_LAMP_STATE_KEYS },
+    [PERSIST_RECORD_SCENE_LAMP]     = { .index = INDEX_SCENE_LAMP, .keys = PERSIST_SCENE_LAMP_KEYS },
+    [PERSIST_RECORD_SCENE_NAME]     = { .index = INDEX_SCENE_NAME, .keys = PERSIST_SCENE_NAME_KEYS },
+    [PERSIST_RECORD_SCENE_RULES]    = { .index = INDEX_SCENE_RULES, .keys = PERSIST_SCENE_RULES_KEYS },
+    [PERSIST_RECORD_CALIBRATION]    = { .index = INDEX_CALIBRATION, .keys = PERSIST_CALIBRATION_KEYS },
+};
+
+static const struct PersistRecord *record_index[INDEX_SIZE];
+
+static struct SectorInfo sectors[PERSIST_SECTOR_COUNT];
+static uint8_t active_sector;
+static uint32_t next_sequence;
+
+struct PersistQueueEntry {
+    uint8_t type;
+    uint8_t key;
+    uint16_t length;
+    uint8_t data[PERSIST_QUEUE_DATA_SIZE];
+};
+
+static struct PersistQueueEntry queue[PERSIST_QUEUE_LENGTH];
+static uint8_t queue_head;
+static uint8_t queue_count;
+static uint8_t queue_head_rotations;
+
+static int pending_erase = -1;
+static uint64_t last_step_us;
+static uint64_t last_queued_us;
+
+static uint16_t failed_writes;
+static uint16_t completed_writes;
+
+static struct PersistStats stats;
+
+static void scan_sector(uint8_t sector);
+static bool is_erased(const void *addr, uint32_t len);
+static bool is_valid_record(const struct PersistRecord *record, uint32_t max_size);
+static const struct PersistRecord **find_index_entry(uint8_t type, uint8_t key);
+static bool append_record(const struct PersistRecord *header, const void *data);
+static void activate_spare_sector();
+static void reclaim_oldest_sector();
+static void forget_sector_records(uint8_t sector);
+static void finish_reclaim();
+static void erase_sector(uint8_t sector);
+static void make_record_header(struct PersistRecord *header, uint8_t type, uint8_t key, const void *data, uint16_t length);
+static int find_sector(enum SectorState state, bool oldest);
+static int find_next_sector(uint8_t sector);
+static uint16_t crc16(uint16_t crc, const void *data, uint32_t len);
+static uint16_t record_crc(const struct PersistRecord *header, const void *data);
+static void write_record(uint32_t offset, const struct PersistRecord *header, const void *data);
+static void write_flash(uint32_t offset, const void *data, uint32_t len);
+static void copy_to_page(uint8_t *pagebuf, uint32_t page_offset, uint32_t offset, const void *data, uint32_t len);
+static void program_page(uint32_t page_offset, uint8_t *pagebuf);
+static void record_flash_stall(uint64_t start_us);
 
 void ctrl_persist_init()
 {
-    if (!is_flash_in_known_state()) {
-        ctrl_persist_clear();
+    next_sequence = 0;
+
+    for (uint8_t s = 0; s < PERSIST_SECTOR_COUNT; s++) {
+        struct SectorInfo *info = &sectors[s];
+        const struct PersistSectorHeader *hdr = SECTOR_ADDR(s);
+
+        info->state = SECTOR_INVALID;
+        info->erase_count = 0;
+        info->sequence = SEQUENCE_SPARE;
+        info->write_offset = sizeof(struct PersistSectorHeader);
+
+        if (hdr->magic != SECTOR_MAGIC || hdr->erase_count != ~hdr->erase_count_inv) {
+            continue;
+        }
+        info->erase_count = hdr->erase_count;
+
+        if (hdr->sequence == SEQUENCE_SPARE && hdr->sequence_inv == SEQUENCE_SPARE) {
+            if (is_erased(hdr + 1, FLASH_SECTOR_SIZE - sizeof(*hdr))) {
+                info->state = SECTOR_SPARE;
+            }
+        } else if (hdr->sequence == ~hdr->sequence_inv) {
+            info->state = SECTOR_USED;
+            info->sequence = hdr->sequence;
+            if (hdr->sequence >= next_sequence) {
+                next_sequence = hdr->sequence + 1;
+            }
+        }
+    }
+
+    // Erase anything that isn't a valid sector; this covers the first boot
+    // and interrupted erases
+    for (uint8_t s = 0; s < PERSIST_SECTOR_COUNT; s++) {
+        if (sectors[s].state == SECTOR_INVALID) {
+            erase_sector(s);
+        }
+    }
+
+    // Build the index by reading used sectors from oldest to newest
+    memset(record_index, 0, sizeof(record_index));
+    for (int s = find_sector(SECTOR_USED, true); s >= 0; s = find_next_sector((uint8_t) s)) {
+        scan_sector((uint8_t) s);
+        active_sector = (uint8_t) s;
+    }
+
+    if (find_sector(SECTOR_USED, false) < 0) {
+        activate_spare_sector();
+    }
+
+    // If power was lost after activating a sector but before reclaiming the
+    // oldest one, finish the reclaim now
+    pending_erase = -1;
+    if (find_sector(SECTOR_SPARE, true) < 0) {
+        reclaim_oldest_sector();
+        finish_reclaim();
     }
 }
 
 void ctrl_persist_clear()
 {
-    uint32_t interupts = save_and_disable_interrupts(); 
-    flash_range_erase(PERSIST_FLASH_OFFSET, PERSIST_FLASH_SIZE);
-    restore_interrupts(interupts);
+    queue_count = 0;
+    pending_erase = -1;
+
+    for (uint8_t s = 0; s < PERSIST_SECTOR_COUNT; s++) {
+        if (sectors[s].state != SECTOR_SPARE) {
+            erase_sector(s);
+        }
+    }
+    memset(record_index, 0, sizeof(record_index));
+    activate_spare_sector();
 }
 
-void ctrl_persist_save_report(struct Vendor12VRGBAnimationReport *report)
+bool ctrl_persist_save_async(uint8_t type, uint8_t key, const void *data, uint16_t length)
 {
-    uint8_t pagebuf[FLASH_PAGE_SIZE];
+    if (find_index_entry(type, key) == NULL || length > PERSIST_QUEUE_DATA_SIZE) {
+        failed_writes++;
+        return false;
+    }
 
-    void *target_slot = NULL;
-    for EACH_REPORT_SLOT {
-        if (is_empty_slot(slot)) {
-            target_slot = slot;
-            break;
+    // Replace the data of a queued record with the same type and key, unless
+    // it is at the head of the queue and may be partially written
+    struct PersistQueueEntry *entry = NULL;
+    for (uint8_t i = 0; i < queue_count; i++) {
+        struct PersistQueueEntry *e = &queue[(queue_head + i) % PERSIST_QUEUE_LENGTH];
+        if (e->type == type && e->key == key && (i > 0 || queue_head_rotations == 0)) {
+            entry = e;
+        }
+    }
+
+    if (entry == NULL) {
+        if (queue_count == PERSIST_QUEUE_LENGTH) {
+            failed_writes++;
+            return false;
+        }
+        entry = &queue[(queue_head + queue_count) % PERSIST_QUEUE_LENGTH];
+        queue_count++;
+    }
+
+    entry->type = type;
+    entry->key = key;
+    entry->length = length;
+    if (length > 0) {
+        memcpy(entry->data, data, length);
+    }
+    last_queued_us = time_us_64();
+
+    return true;
+}
+
+uint8_t ctrl_persist_queue_space()
+{
+    return (uint8_t) (PERSIST_QUEUE_LENGTH - queue_count);
+}
+
+void ctrl_persist_task()
+{
+    if (pending_erase < 0 && queue_count == 0) {
+        return;
+    }
+
+    // Leave time between operations for USB and animation frames
+    uint64_t now = time_us_64();
+    if (now - last_step_us < PERSIST_STEP_INTERVAL_US) {
+        return;
+    }
+
+    if (queue_count == 0) {
+        // Only an erase is pending; wait for the host to stop saving
+        if (now - last_queued_us < PERSIST_ERASE_DELAY_US) {
+            return;
+        }
+        finish_reclaim();
+    } else {
+        struct PersistQueueEntry *entry = &queue[queue_head];
+
+        struct PersistRecord header;
+        make_record_header(&header, entry->type, entry->key, entry->data, entry->length);
+
+        bool done = append_record(&header, entry->data);
+        if (done) {
+            completed_writes++;
+            EVENTS_POST(EVENTS_PERSIST, false, (uint16_t) (entry->type << 8 | entry->key));
+        } else if (queue_head_rotations < PERSIST_SECTOR_COUNT) {
+            // Make space; the record is written after the oldest sector is
+            // erased in a later step
+            activate_spare_sector();
+            reclaim_oldest_sector();
+            queue_head_rotations++;
+        } else {
+            failed_writes++;
+            EVENTS_POST(EVENTS_PERSIST, true, (uint16_t) (entry->type << 8 | entry->key));
+            done = true;
+        }
+
+        if (done) {
+            queue_head = (uint8_t) ((queue_head + 1) % PERSIST_QUEUE_LENGTH);
+            queue_count--;
+            queue_head_rotations = 0;
         }
     }
 
-    // All of our flash sectors are full, reclaim space for this report
-    if (target_slot == NULL) {
-        target_slot = reclaim_report_slots(pagebuf, report->lamp_id);
+    last_step_us = time_us_64();
+}
+
+void ctrl_persist_get_status(struct PersistStatus *status)
+{
+    status->pending_writes = queue_count;
+    status->pending_erases = pending_erase >= 0 ? 1 : 0;
+    status->failed_writes = failed_writes;
+    status->completed_writes = completed_writes;
+}
+
+const void *ctrl_persist_find(uint8_t type, uint8_t key, uint16_t *length)
+{
+    const struct PersistRecord **entry = find_index_entry(type, key);
+    if (entry == NULL || *entry == NULL) {
+        return NULL;
+    }
+    if (length != NULL) {
+        *length = (*entry)->length;
     }
+    return ((const uint8_t *) *entry) + RECORD_DATA_OFFSET;
+}
 
-    uint32_t pos = PERSIST_OFFSET(target_slot) % FLASH_PAGE_SIZE;
-    write_reports(pagebuf, pos, report, 1);
-    write_flash_page(pagebuf, PERSIST_OFFSET(target_slot) / FLASH_PAGE_SIZE);
+bool ctrl_persist_save_report(struct Vendor12VRGBAnimationReport *report)
+{
+    return ctrl_persist_save_async(PERSIST_RECORD_ANIMATION, report->lamp_id, report, sizeof(*report));
 }
 
 struct Vendor12VRGBAnimationReport *ctrl_persist_find_report(uint8_t lamp_id)
 {
-    struct Vendor12VRGBAnimationReport *last_report = NULL;
-    for EACH_REPORT_SLOT {
-        if (is_empty_slot(slot)) {
+    uint16_t length;
+    const void *data = ctrl_persist_find(PERSIST_RECORD_ANIMATION, lamp_id, &length);
+    if (data == NULL || length != sizeof(struct Vendor12VRGBAnimationReport)) {
+        return NULL;
+    }
+    return (struct Vendor12VRGBAnimationReport *) data;
+}
+
+/**
+ * @brief Reads the records in a sector, updates the index, and sets the write
+ * offset for the sector.
+ */
+static void scan_sector(uint8_t sector)
+{
+    const uint8_t *base = SECTOR_ADDR(sector);
+    uint32_t offset = sizeof(struct PersistSectorHeader);
+
+    while (offset + sizeof(struct PersistRecord) <= FLASH_SECTOR_SIZE) {
+        const struct PersistRecord *record = (const struct PersistRecord *) (base + offset);
+        if (is_erased(record, sizeof(*record))) {
             break;
         }
-        struct Vendor12VRGBAnimationReport *r = get_report(slot);
-        if (r->lamp_id == lamp_id) {
-            last_report = r;
+        if (!is_valid_record(record, FLASH_SECTOR_SIZE - offset)) {
+            offset = FLASH_SECTOR_SIZE;
+            break;
+        }
+
+        // Ignore records with unknown types or keys, which may have been
+        // written by a different firmware version
+        const struct PersistRecord **entry = find_index_entry(record->type, record->key);
+        if (entry != NULL) {
+            *entry = record->length > 0 ? record : NULL;
+        }
+        offset += RECORD_SIZE(record->length);
+    }
+
+    sectors[sector].write_offset = offset;
+}
+
+static bool is_erased(const void *addr, uint32_t len)
+{
+    const uint8_t *p = addr;
+    for (uint32_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool is_valid_record(const struct PersistRecord *record, uint32_t max_size)
+{
+    return record->marker == PERSIST_RECORD_MARKER
+        && RECORD_SIZE(record->length) <= max_size
+        && record->crc == record_crc(record, ((const uint8_t *) record) + RECORD_DATA_OFFSET);
+}
+
+static const struct PersistRecord **find_index_entry(uint8_t type, uint8_t key)
+{
+    if (type >= PERSIST_RECORD_TYPE_COUNT || key >= record_types[type].keys) {
+        return NULL;
+    }
+    return &record_index[record_types[type].index + key];
+}
+
+/**
+ * @brief Writes a record to the end of the active sector and updates the index.
+ *
+ * @returns false if there is not enough space in the active sector
+ */
+static bool append_record(const struct PersistRecord *header, const void *data)
+{
+    struct SectorInfo *info = &sectors[active_sector];
+    uint32_t size = RECORD_SIZE(header->length);
+    if (info->write_offset + size > FLASH_SECTOR_SIZE) {
+        return false;
+    }
+
+    uint32_t offset = active_sector * FLASH_SECTOR_SIZE + info->write_offset;
+    write_record(offset, header, data);
+    info->write_offset += size;
+
+    const struct PersistRecord **entry = find_index_entry(header->type, header->key);
+    *entry = header->length > 0 ? PERSIST_ADDR(offset) : NULL;
+
+    return true;
+}
+
+static void activate_spare_sector()
+{
+    // Callers reclaim a sector after each activation, so a spare only goes
+    // missing if that erase is still pending; finish it now
+    if (find_sector(SECTOR_SPARE, true) < 0) {
+        finish_reclaim();
+    }
+
+    // Never reuse a sector that holds records without erasing it. If there is
+    // still no spare, give up the records in the oldest sector on purpose
+    // rather than writing over them.
+    if (find_sector(SECTOR_SPARE, true) < 0) {
+        uint8_t oldest = (uint8_t) find_sector(SECTOR_USED, true);
+        forget_sector_records(oldest);
+        erase_sector(oldest);
+    }
+
+    // There is only one spare in normal operation; after a clear, prefer the
+    // sector with the least wear
+    uint8_t sector = (uint8_t) find_sector(SECTOR_SPARE, true);
+    for (uint8_t s = 0; s < PERSIST_SECTOR_COUNT; s++) {
+        if (sectors[s].state == SECTOR_SPARE && sectors[s].erase_count < sectors[sector].erase_count) {
+            sector = s;
         }
     }
-    return last_report;
+
+    struct SectorInfo *info = &sectors[sector];
+    info->state = SECTOR_USED;
+    info->sequence = next_sequence++;
+    info->write_offset = sizeof(struct PersistSectorHeader);
+
+    uint32_t seq[2] = { info->sequence, ~info->sequence };
+    write_flash(sector * FLASH_SECTOR_SIZE + offsetof(struct PersistSectorHeader, sequence), seq, sizeof(seq));
+
+    active_sector = sector;
 }
 
-static void *reclaim_report_slots(uint8_t *pagebuf, uint8_t target_lamp_id)
+/**
+ * @brief Copies records that are still live from the oldest sector to the
+ * active sector and marks the oldest sector for erasing.
+ */
+static void reclaim_oldest_sector()
 {
-    struct Vendor12VRGBAnimationReport *report_addrs[LAMP_COUNT] = { NULL };
-    struct Vendor12VRGBAnimationReport reports[LAMP_COUNT-1];
-    
-    // Find the most recent report for each lamp
-    for EACH_REPORT_SLOT {
-        struct Vendor12VRGBAnimationReport *r = get_report(slot);
-        report_addrs[r->lamp_id] = r;
+    uint8_t sector = (uint8_t) find_sector(SECTOR_USED, true);
+
+    const uint8_t *start = SECTOR_ADDR(sector);
+    const uint8_t *end = start + FLASH_SECTOR_SIZE;
+
+    for (uint16_t i = 0; i < INDEX_SIZE; i++) {
+        const struct PersistRecord *record = record_index[i];
+        if ((const uint8_t *) record < start || (const uint8_t *) record >= end) {
+            continue;
+        }
+
+        // The active sector is empty apart from other records copied from
+        // this sector, so this cannot run out of space
+        struct PersistRecord header = *record;
+        append_record(&header, ((const uint8_t *) record) + RECORD_DATA_OFFSET);
     }
 
-    // Copy the relevant reports in to RAM so we can erase flash
-    uint32_t report_count = 0;
-    for (uint8_t id = 0; id <= MAX_LAMP_ID; id++) {
-        if (id != target_lamp_id && report_addrs[id] != NULL) {
-            reports[report_count] = *report_addrs[id];
-            report_count++;
+    pending_erase = sector;
+}
+
+/**
+ * @brief Removes index entries for records stored in a sector.
+ */
+static void forget_sector_records(uint8_t sector)
+{
+    const uint8_t *start = SECTOR_ADDR(sector);
+    const uint8_t *end = start + FLASH_SECTOR_SIZE;
+
+    for (uint16_t i = 0; i < INDEX_SIZE; i++) {
+        const uint8_t *record = (const uint8_t *) record_index[i];
+        if (record >= start && record < end) {
+            record_index[i] = NULL;
         }
     }
+}
+
+/**
+ * @brief Erases the sector marked by reclaim_oldest_sector, if any.
+ */
+static void finish_reclaim()
+{
+    if (pending_erase >= 0) {
+        erase_sector((uint8_t) pending_erase);
+        pending_erase = -1;
+    }
+}
+
+/**
+ * @brief Erases a sector and writes a spare sector header.
+ */
+static void erase_sector(uint8_t sector)
+{
+    struct SectorInfo *info = &sectors[sector];
+
+    uint64_t start_us = time_us_64();
+    uint32_t interupts = save_and_disable_interrupts();
+    flash_range_erase(PERSIST_FLASH_OFFSET + sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE);
+    restore_interrupts(interupts);
+    record_flash_stall(start_us);
 
-    // Erase flash
-    ctrl_persist_clear();
+    info->state = SECTOR_SPARE;
+    info->erase_count++;
+    info->sequence = SEQUENCE_SPARE;
+    info->write_offset = sizeof(struct PersistSectorHeader);
 
-    // If the entire storage was filled with reports for the lamp we're
-    // updating, there's nothing saved to write back to flash; return the
-    // address of the first slot
-    if (report_count == 0) {
-        return PERSIST_ADDR(0);
+    struct PersistSectorHeader hdr = {
+        .magic = SECTOR_MAGIC,
+        .erase_count = info->erase_count,
+        .erase_count_inv = ~info->erase_count,
+        .sequence = SEQUENCE_SPARE,
+        .sequence_inv = SEQUENCE_SPARE,
+        .reserved = 0xFFFFFFFF,
+    };
+    write_flash(sector * FLASH_SECTOR_SIZE, &hdr, sizeof(hdr));
+}
+
+/**
+ * @brief Returns the sector in the given state with the lowest (or highest)
+ * sequence number, or -1 if there is no sector in the state.
+ */
+static int find_sector(enum SectorState state, bool oldest)
+{
+    int found = -1;
+    for (uint8_t s = 0; s < PERSIST_SECTOR_COUNT; s++) {
+        if (sectors[s].state != state) {
+            continue;
+        }
+        if (found < 0
+                || (oldest && sectors[s].sequence < sectors[found].sequence)
+                || (!oldest && sectors[s].sequence > sectors[found].sequence)) {
+            found = s;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Returns the used sector that follows @p sector in sequence order, or
+ * -1 if @p sector is the newest sector.
+ */
+static int find_next_sector(uint8_t sector)
+{
+    int found = -1;
+    for (uint8_t s = 0; s < PERSIST_SECTOR_COUNT; s++) {
+        if (sectors[s].state != SECTOR_USED || sectors[s].sequence <= sectors[sector].sequence) {
+            continue;
+        }
+        if (found < 0 || sectors[s].sequence < sectors[found].sequence) {
+            found = s;
+        }
     }
+    return found;
+}
 
-    // Write saved reports back to flash by page
-    uint32_t page_count = ((report_count - 1) / PERSIST_REPORTS_PER_PAGE) + 1; 
-    for (uint32_t page = 0; page < page_count; page++) {
-        uint32_t ridx = page * PERSIST_REPORTS_PER_PAGE;
-        write_reports(pagebuf, 0, reports + ridx, (report_count - ridx) % PERSIST_REPORTS_PER_PAGE);
-        write_flash_page(pagebuf, page);
+static void make_record_header(struct PersistRecord *header, uint8_t type, uint8_t key, const void *data, uint16_t length)
+{
+    header->marker = PERSIST_RECORD_MARKER;
+    header->type = type;
+    header->key = key;
+    header->length = length;
+    header->crc = record_crc(header, data);
+}
+
+/**
+ * @brief Computes a CRC-16/CCITT-FALSE checksum.
+ */
+static uint16_t crc16(uint16_t crc, const void *data, uint32_t len)
+{
+    const uint8_t *p = data;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= (uint16_t) (p[i] << 8);
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+        }
     }
+    return crc;
+}
 
-    return PERSIST_ADDR(report_count * PERSIST_REPORT_SLOT_SIZE);
+static uint16_t record_crc(const struct PersistRecord *header, const void *data)
+{
+    uint16_t crc = crc16(0xFFFF, &header->type, offsetof(struct PersistRecord, crc) - offsetof(struct PersistRecord, type));
+    return crc16(crc, data, header->length);
 }
 
 /**
- * @brief Checks each report location to determine if the sectors of flash used
- * for persistence are in a known state.
+ * @brief Programs a record header and its data at an offset in the persistent
+ * flash storage.
  *
- * Flash is in a know state if first word of all report slots is either empty
- * (0xFFFF) or the marker value.
+ * @param offset the offset in the persistent flash storage
+ * @param header the record header
+ * @param data   the record data, which may point to flash
  */
-static bool is_flash_in_known_state()
+static void write_record(uint32_t offset, const struct PersistRecord *header, const void *data)
 {
-    for EACH_REPORT_SLOT {
-        uint16_t marker = *((uint16_t *) slot);
-        if (marker != 0xFFFF && marker != PERSIST_REPORT_MARKER) {
-            return false;
-        }
+    uint8_t pagebuf[FLASH_PAGE_SIZE];
+
+    uint32_t end = offset + RECORD_DATA_OFFSET + header->length;
+    for (uint32_t page = offset - (offset % FLASH_PAGE_SIZE); page < end; page += FLASH_PAGE_SIZE) {
+        memset(pagebuf, 0xFF, FLASH_PAGE_SIZE);
+        copy_to_page(pagebuf, page, offset, header, sizeof(*header));
+        copy_to_page(pagebuf, page, offset + RECORD_DATA_OFFSET, data, header->length);
+        program_page(page, pagebuf);
     }
-    return true;
 }
 
-static bool is_empty_slot(void *slot)
+/**
+ * @brief Programs data at an offset in the persistent flash storage.
+ *
+ * @param offset the offset in the persistent flash storage
+ * @param data   the data to write, which may point to flash
+ * @param len    the number of bytes to write
+ */
+static void write_flash(uint32_t offset, const void *data, uint32_t len)
 {
-    return *((uint16_t *) slot) == 0xFFFF;
+    uint8_t pagebuf[FLASH_PAGE_SIZE];
+
+    uint32_t end = offset + len;
+    for (uint32_t page = offset - (offset % FLASH_PAGE_SIZE); page < end; page += FLASH_PAGE_SIZE) {
+        memset(pagebuf, 0xFF, FLASH_PAGE_SIZE);
+        copy_to_page(pagebuf, page, offset, data, len);
+        program_page(page, pagebuf);
+    }
 }
 
-static struct Vendor12VRGBAnimationReport *get_report(void *slot)
+/**
+ * @brief Copies the part of @p data that overlaps a flash page to the page
+ * buffer.
+ *
+ * The rest of the page buffer should be 0xFF, i.e. the erased state of flash.
+ * This means we can "overwrite" existing data in the page without changing it,
+ * reducing erase cycles. Because the data is copied to RAM before programming,
+ * it can point to flash.
+ *
+ * @param pagebuf     the buffer for the page, must contain FLASH_PAGE_SIZE elements
+ * @param page_offset the offset of the page in the persistent flash storage
+ * @param offset      the offset of @p data in the persistent flash storage
+ * @param data        the data to copy
+ * @param len         the number of bytes in @p data
+ */
+static void copy_to_page(uint8_t *pagebuf, uint32_t page_offset, uint32_t offset, const void *data, uint32_t len)
 {
-    return (struct Vendor12VRGBAnimationReport *)(slot + PERSIST_REPORT_MARKER_BYTES);
+    uint32_t start = MAX(offset, page_offset);
+    uint32_t end = MIN(offset + len, page_offset + FLASH_PAGE_SIZE);
+    if (start < end) {
+        memcpy(pagebuf + (start - page_offset), ((const uint8_t *) data) + (start - offset), end - start);
+    }
 }
 
 /**
  * @brief Writes a page to flash.
  *
- * @param pagebuf  the buffer to write, must contain FLASH_PAGE_SIZE elements
- * @param page_num the page number in the report sector to write
+ * @param page_offset the offset of the page in the persistent flash storage
+ * @param pagebuf     the buffer to write, must contain FLASH_PAGE_SIZE elements
  */
-static void write_flash_page(uint8_t *pagebuf, uint32_t page_num)
+static void program_page(uint32_t page_offset, uint8_t *pagebuf)
 {
-    uint32_t interupts = save_and_disable_interrupts(); 
-    flash_range_program(PERSIST_FLASH_OFFSET + page_num * FLASH_PAGE_SIZE, pagebuf, FLASH_PAGE_SIZE);
+    uint64_t start_us = time_us_64();
+    uint32_t interupts = save_and_disable_interrupts();
+    flash_range_program(PERSIST_FLASH_OFFSET + page_offset, pagebuf, FLASH_PAGE_SIZE);
     restore_interrupts(interupts);
+    record_flash_stall(start_us);
 }
 
 /**
- * @brief Stores reports in the page buffer for writing to flash.
- *
- * This function initializes pagebuf to all 0xFF before writing. As a result,
- * calls cannot stack and a single call should write all the reports for the
- * page.
- *
- * @param pagebuf the buffer to write to, must contain FLASH_PAGE_SIZE elements
- * @param offset  the offset within @p pagebuf to start at, must be aligned to
- *                a slot boundary and allow enough space for @p count reports
- * @param reports pointer to the reports to write
- * @param count   the number of reports pointed to by @p reports
+ * @brief Records the time the main loop was blocked by a flash operation that
+ * started at @p start_us.
  */
-static void write_reports(uint8_t *pagebuf, uint32_t offset, struct Vendor12VRGBAnimationReport *reports, uint8_t count)
+static void record_flash_stall(uint64_t start_us)
 {
-    // Set the buffer to all 0xFF, i.e. the erased state of flash. This means
-    // we can "overwrite" existing data in the page without changing it,
-    // reducing erase cycles
-    memset(pagebuf, 0xFF, FLASH_PAGE_SIZE);
+    uint32_t stall_us = (uint32_t) (time_us_64() - start_us);
+
+    STATS_COUNT(STATS_COUNTER_FLASH_STALLS, 1);
+    TRACE(TRACE_EVENT_FLASH_STALL, 0, 0, stall_us);
 
-    for (uint8_t i = 0; i < count; i++) {
-        uint8_t *p = pagebuf + offset + (i * PERSIST_REPORT_SLOT_SIZE);
-        *((uint16_t *) p) = PERSIST_REPORT_MARKER;
-        *((struct Vendor12VRGBAnimationReport *) (p + PERSIST_REPORT_MARKER_BYTES)) = reports[i];
+    stats.flash_ops++;
+    stats.stall_us_total += stall_us;
+    if (stall_us > stats.stall_us_max) {
+        stats.stall_us_max = stall_us;
+    }
+}
+
+void ctrl_persist_get_stats(struct PersistStats *out)
+{
+    *out = stats;
+    for (uint8_t s = 0; s < PERSIST_SECTOR_COUNT; s++) {
+        out->sector_erases[s] = sectors[s].erase_count;
     }
 }
 
@@ -216,12 +748,51 @@ void ctrl_persist_dump()
 // ----------
 
 static_assert(
-    PERSIST_REPORT_SLOT_SIZE >= (PERSIST_REPORT_MARKER_BYTES + sizeof(struct Vendor12VRGBAnimationReport)),
-    "struct Vendor12VRGBAnimationReport is too large for the defined slot size"
+    sizeof(struct PersistSectorHeader) % PERSIST_RECORD_ALIGN == 0,
+    "sector header size must preserve record alignment"
+);
+
+static_assert(
+    sizeof(struct PersistRecord) == RECORD_DATA_OFFSET,
+    "record header size must be a multiple of the record alignment"
+);
+
+static_assert(
+    PERSIST_QUEUE_DATA_SIZE >= sizeof(struct Vendor12VRGBAnimationReport),
+    "persistence queue entries are too small for struct Vendor12VRGBAnimationReport"
+);
+
+static_assert(
+    PERSIST_QUEUE_DATA_SIZE >= sizeof(struct LampStateCheckpoint),
+    "persistence queue entries are too small for struct LampStateCheckpoint"
+);
+
+static_assert(
+    PERSIST_QUEUE_DATA_SIZE >= sizeof(struct SceneRules) && PERSIST_QUEUE_DATA_SIZE >= SCENE_NAME_SIZE,
+    "persistence queue entries are too small for scene records"
 );
 
 static_assert(
-    LAMP_COUNT <= PERSIST_REPORTS_PER_PAGE * (PERSIST_FLASH_SIZE / FLASH_PAGE_SIZE),
-    "insufficient space to save default Vendor12VRGBAnimationReport for every lamp"
+    PERSIST_QUEUE_DATA_SIZE >= sizeof(struct CalibrationCurve),
+    "persistence queue entries are too small for struct CalibrationCurve"
 );
 
+static_assert(PERSIST_SCENE_LAMP_KEYS <= UINT8_MAX + 1, "too many scenes for 8-bit record keys");
+
+static_assert(
+    PERSIST_SECTOR_COUNT >= 3,
+    "persistence requires an active sector, a spare sector, and a sector to reclaim"
+);
+
+// Reclaiming the oldest sector only frees space if the live records do not
+// fill every sector other than the active sector and the spare
+static_assert(
+    PERSIST_ANIMATION_KEYS * RECORD_SIZE(sizeof(struct Vendor12VRGBAnimationReport))
+        + PERSIST_LAMP_STATE_KEYS * RECORD_SIZE(sizeof(struct LampStateCheckpoint))
+        + PERSIST_SCENE_LAMP_KEYS * RECORD_SIZE(sizeof(struct Vendor12VRGBAnimationReport))
+        + PERSIST_SCENE_NAME_KEYS * RECORD_SIZE(SCENE_NAME_SIZE)
+        + PERSIST_SCENE_RULES_KEYS * RECORD_SIZE(sizeof(struct SceneRules))
+        + PERSIST_CALIBRATION_KEYS * RECORD_SIZE(sizeof(struct CalibrationCurve))
+        <= (PERSIST_SECTOR_COUNT - 2) * (FLASH_SECTOR_SIZE - sizeof(struct PersistSectorHeader)),
+    "insufficient space to save all persistent records"
+);
@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "controller/power.h"
+#include "device/lamp.h"
+#include "device/specs.h"
+#include "device/temperature.h"
+#include "events.h"
+#include "hid/vendor/report.h"
+
+#define DERATE_START_CENTI  (CFG_RGB_POWER_DERATE_START_TEMP * 100)
+#define DERATE_END_CENTI    (CFG_RGB_POWER_DERATE_END_TEMP * 100)
+
+static const uint16_t lamp_power[LAMP_COUNT][3] = {
+    CFG_RGB_LAMP_POWER
+};
+
+#if CFG_RGB_TEMP_COMPENSATION
+// Each entry is {temperature, red gain, green gain, blue gain}
+static const int16_t compensation[][4] = {
+    CFG_RGB_TEMP_COMPENSATION_TABLE
+};
+
+#define COMPENSATION_COUNT (sizeof(compensation) / sizeof(compensation[0]))
+
+// scale_channel supports scales up to twice POWER_SCALE_ONE
+#define COMPENSATION_GAIN_MAX 2000
+#endif
+
+/**
+ * @brief Returns the scale for a channel with a gain in thousandths.
+ */
+static uint32_t gain_scale(uint32_t gain)
+{
+    return (uint32_t) (((uint64_t) gain * POWER_SCALE_ONE + 500) / 1000);
+}
+
+/**
+ * @brief Sets the temperature compensation gain of each channel.
+ */
+static void compensation_gain(int16_t temperature, uint32_t gain[3])
+{
+#if CFG_RGB_TEMP_COMPENSATION
+    const int16_t *lo = compensation[0];
+    const int16_t *hi = compensation[COMPENSATION_COUNT - 1];
+    for (uint32_t i = 1; i < COMPENSATION_COUNT; i++) {
+        if (temperature < compensation[i][0] * 100) {
+            lo = compensation[i - 1];
+            hi = compensation[i];
+            break;
+        }
+    }
+
+    int32_t span = (hi[0] - lo[0]) * 100;
+    int32_t offset = temperature - lo[0] * 100;
+    if (span <= 0 || offset <= 0) {
+        offset = 0;
+        span = 1;
+    } else if (offset > span) {
+        offset = span;
+    }
+
+    for (uint8_t j = 0; j < 3; j++) {
+        int32_t g = lo[j + 1] + (hi[j + 1] - lo[j + 1]) * offset / span;
+        if (g < 0) {
+            g = 0;
+        } else if (g > COMPENSATION_GAIN_MAX) {
+            g = COMPENSATION_GAIN_MAX;
+        }
+        gain[j] = gain_scale((uint32_t) g);
+    }
+#else
+    for (uint8_t j = 0; j < 3; j++) {
+        gain[j] = POWER_SCALE_ONE;
+    }
+#endif
+}
+
+/**
+ * @brief Scales a channel value, saturating at full duty. Scales up to twice
+ * POWER_SCALE_ONE are supported.
+ */
+static inline uint16_t __time_critical_func(scale_channel)(uint16_t value, uint32_t scale)
+{
+    // Drop the lowest bit of the scale so the product fits in 32 bits
+    uint32_t scaled = (value * (scale >> 1)) >> 15;
+    return scaled > UINT16_MAX ? UINT16_MAX : (uint16_t) scaled;
+}
+
+/**
+ * @brief Returns the estimated load of a lamp in milliwatts. The load of each
+ * channel is proportional to its PWM duty after compensation.
+ */
+static uint32_t lamp_load(uint8_t lamp_id, struct LampValue value, const uint32_t gain[3])
+{
+    if (value.i == 0) {
+        return 0;
+    }
+
+    const uint16_t *power = lamp_power[lamp_id];
+    return ((scale_channel(value.r, gain[0]) * (uint32_t) power[0]) >> 16)
+         + ((scale_channel(value.g, gain[1]) * (uint32_t) power[1]) >> 16)
+         + ((scale_channel(value.b, gain[2]) * (uint32_t) power[2]) >> 16);
+}
+
+/**
+ * @brief Returns the budget in milliwatts at the given temperature.
+ */
+static uint32_t derated_budget(int16_t temperature)
+{
+    if (CFG_RGB_POWER_BUDGET == 0 || temperature <= DERATE_START_CENTI) {
+        return CFG_RGB_POWER_BUDGET;
+    }
+    if (temperature >= DERATE_END_CENTI) {
+        return CFG_RGB_POWER_DERATE_MIN_BUDGET;
+    }
+
+    uint32_t reduction = (uint32_t) (CFG_RGB_POWER_BUDGET - CFG_RGB_POWER_DERATE_MIN_BUDGET)
+        * (uint32_t) (temperature - DERATE_START_CENTI)
+        / (DERATE_END_CENTI - DERATE_START_CENTI);
+    return CFG_RGB_POWER_BUDGET - reduction;
+}
+
+void ctrl_power_init(struct PowerGovernor *power)
+{
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        power->lamp_load[id] = 0;
+    }
+    power->requested_load = 0;
+    power->budget = CFG_RGB_POWER_BUDGET;
+    power->scale = POWER_SCALE_ONE;
+    for (uint8_t j = 0; j < 3; j++) {
+        power->channel_gain[j] = POWER_SCALE_ONE;
+        power->channel_scale[j] = POWER_SCALE_ONE;
+    }
+}
+
+bool ctrl_power_update(struct PowerGovernor *power, const struct LampValue *values, int16_t temperature)
+{
+    compensation_gain(temperature, power->channel_gain);
+
+    uint32_t total = 0;
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        power->lamp_load[id] = lamp_load(id, values[id], power->channel_gain);
+        total += power->lamp_load[id];
+    }
+    power->requested_load = total;
+    power->budget = derated_budget(temperature);
+
+    uint32_t scale = POWER_SCALE_ONE;
+    if (power->budget > 0 && total > power->budget) {
+        scale = (uint32_t) (((uint64_t) power->budget << 16) / total);
+    }
+
+    bool dimming = scale < POWER_SCALE_ONE;
+    if (dimming != (power->scale < POWER_SCALE_ONE)) {
+        EVENTS_POST(EVENTS_THROTTLE, dimming, (uint16_t) ((scale * POWER_REPORT_SCALE_MAX) >> 16));
+    }
+    power->scale = scale;
+
+    bool changed = false;
+    for (uint8_t j = 0; j < 3; j++) {
+        uint32_t channel_scale = (uint32_t) (((uint64_t) scale * power->channel_gain[j]) >> 16);
+        changed |= channel_scale != power->channel_scale[j];
+        power->channel_scale[j] = channel_scale;
+    }
+    return changed;
+}
+
+struct LampValue __time_critical_func(ctrl_power_apply)(const struct PowerGovernor *power, struct LampValue value)
+{
+    if (power->channel_scale[0] == POWER_SCALE_ONE
+        && power->channel_scale[1] == POWER_SCALE_ONE
+        && power->channel_scale[2] == POWER_SCALE_ONE) {
+        return value;
+    }
+
+    value.r = scale_channel(value.r, power->channel_scale[0]);
+    value.g = scale_channel(value.g, power->channel_scale[1]);
+    value.b = scale_channel(value.b, power->channel_scale[2]);
+    return value;
+}
+
+void ctrl_power_get_report(const struct PowerGovernor *power, struct Vendor12VRGBPowerReport *report)
+{
+    uint32_t total = 0;
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        uint32_t load = (uint32_t) (((uint64_t) power->lamp_load[id] * power->scale) >> 16);
+        report->lamp_load[id] = load > UINT16_MAX ? UINT16_MAX : (uint16_t) load;
+        total += load;
+    }
+
+    report->requested_load = power->requested_load;
+    report->total_load = total;
+    report->budget = power->budget;
+    report->scale = (uint16_t) ((power->scale * POWER_REPORT_SCALE_MAX) >> 16);
+    report->temperature_min = temperature_read_min();
+    report->temperature_max = temperature_read_max();
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    CFG_RGB_POWER_DERATE_MIN_BUDGET <= CFG_RGB_POWER_BUDGET,
+    "CFG_RGB_POWER_DERATE_MIN_BUDGET must not be more than CFG_RGB_POWER_BUDGET"
+);
+
+static_assert(
+    CFG_RGB_POWER_DERATE_START_TEMP < CFG_RGB_POWER_DERATE_END_TEMP,
+    "CFG_RGB_POWER_DERATE_START_TEMP must be less than CFG_RGB_POWER_DERATE_END_TEMP"
+);
+
+#if CFG_RGB_TEMP_COMPENSATION
+static_assert(
+    COMPENSATION_COUNT >= 1,
+    "CFG_RGB_TEMP_COMPENSATION_TABLE must have at least one entry"
+);
+#endif
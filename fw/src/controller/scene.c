@@ -0,0 +1,253 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "controller/controller.h"
+#include "controller/persist.h"
+#include "controller/scene.h"
+#include "device/lamp.h"
+#include "device/specs.h"
+#include "device/temperature.h"
+#include "events.h"
+#include "hid/vendor/report.h"
+
+/*
+ * Scenes are stored in flash as one record per lamp, containing the same
+ * animation report used to set default animations, plus an optional name
+ * record. The rule table is a single record that is copied to RAM at startup,
+ * so handling an event is a table lookup followed by one index lookup per
+ * lamp.
+ */
+
+#define SCENE_LAMP_KEY(scene_id, lamp_id) ((uint8_t) ((scene_id) * LAMP_COUNT + (lamp_id)))
+
+void ctrl_scene_init(scene_controller_t *scenectrl)
+{
+    uint16_t length;
+    const struct SceneRules *rules = ctrl_persist_find(PERSIST_RECORD_SCENE_RULES, 0, &length);
+    if (rules != NULL && length == sizeof(struct SceneRules)) {
+        scenectrl->rules = *rules;
+    } else {
+        memset(scenectrl->rules.scenes, SCENE_NONE, sizeof(scenectrl->rules.scenes));
+        // Neither threshold can be reached until the host sets them
+        scenectrl->rules.temperature_high = INT16_MAX;
+        scenectrl->rules.temperature_normal = INT16_MIN;
+    }
+
+    scenectrl->active_scene = SCENE_NONE;
+    scenectrl->selected_scene = 0;
+    scenectrl->is_temperature_high = false;
+    scenectrl->has_host_update = false;
+    scenectrl->last_temperature_check = nil_time;
+}
+
+void ctrl_scene_task(scene_controller_t *scenectrl, controller_t *ctrl)
+{
+    struct SceneRules *rules = &scenectrl->rules;
+    if (rules->scenes[SCENE_EVENT_TEMPERATURE_HIGH] == SCENE_NONE
+            && rules->scenes[SCENE_EVENT_TEMPERATURE_NORMAL] == SCENE_NONE) {
+        return;
+    }
+
+    absolute_time_t now = get_absolute_time();
+    if (absolute_time_diff_us(scenectrl->last_temperature_check, now) < SCENE_TEMPERATURE_INTERVAL_US) {
+        return;
+    }
+    scenectrl->last_temperature_check = now;
+
+    int16_t temperature = temperature_read();
+    if (!scenectrl->is_temperature_high && temperature >= rules->temperature_high) {
+        scenectrl->is_temperature_high = true;
+        ctrl_scene_handle_event(scenectrl, ctrl, SCENE_EVENT_TEMPERATURE_HIGH);
+    } else if (scenectrl->is_temperature_high && temperature <= rules->temperature_normal) {
+        scenectrl->is_temperature_high = false;
+        ctrl_scene_handle_event(scenectrl, ctrl, SCENE_EVENT_TEMPERATURE_NORMAL);
+    }
+}
+
+/**
+ * @brief Switches to a scene, recording the cause for the scene event, which is
+ * a SceneEvent or EVENTS_SCENE_BY_HOST.
+ */
+static bool activate(scene_controller_t *scenectrl, controller_t *ctrl, uint8_t scene_id, uint16_t cause)
+{
+    if (scene_id >= SCENE_COUNT) {
+        return false;
+    }
+
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        uint16_t length;
+        struct Vendor12VRGBAnimationReport *report = (struct Vendor12VRGBAnimationReport *)
+            ctrl_persist_find(PERSIST_RECORD_SCENE_LAMP, SCENE_LAMP_KEY(scene_id, id), &length);
+
+        if (report != NULL && length == sizeof(struct Vendor12VRGBAnimationReport)) {
+            ctrl_set_animation_from_report(ctrl, report);
+        }
+    }
+
+    scenectrl->active_scene = scene_id;
+    EVENTS_POST(EVENTS_SCENE, scene_id, cause);
+    return true;
+}
+
+bool ctrl_scene_handle_event(scene_controller_t *scenectrl, controller_t *ctrl, enum SceneEvent event)
+{
+    // Wait for a new host update after the host goes away
+    if (event == SCENE_EVENT_SUSPEND || event == SCENE_EVENT_DISCONNECT) {
+        scenectrl->has_host_update = false;
+    }
+
+    uint8_t scene_id = scenectrl->rules.scenes[event];
+    if (scene_id == SCENE_NONE) {
+        return false;
+    }
+
+    if (event == SCENE_EVENT_SUSPEND || event == SCENE_EVENT_DISCONNECT) {
+        ctrl_set_autonomous_mode(ctrl, true);
+    }
+    return activate(scenectrl, ctrl, scene_id, (uint16_t) event);
+}
+
+void ctrl_scene_handle_host_update(scene_controller_t *scenectrl, controller_t *ctrl)
+{
+    if (!scenectrl->has_host_update) {
+        scenectrl->has_host_update = true;
+        ctrl_scene_handle_event(scenectrl, ctrl, SCENE_EVENT_HOST_UPDATE);
+    }
+}
+
+bool ctrl_scene_activate(scene_controller_t *scenectrl, controller_t *ctrl, uint8_t scene_id)
+{
+    return activate(scenectrl, ctrl, scene_id, EVENTS_SCENE_BY_HOST);
+}
+
+uint8_t ctrl_scene_get_active(scene_controller_t *scenectrl)
+{
+    return scenectrl->active_scene;
+}
+
+void ctrl_scene_select(scene_controller_t *scenectrl, uint8_t scene_id)
+{
+    if (scene_id < SCENE_COUNT) {
+        scenectrl->selected_scene = scene_id;
+    }
+}
+
+uint8_t ctrl_scene_get_selected(scene_controller_t *scenectrl)
+{
+    return scenectrl->selected_scene;
+}
+
+bool ctrl_scene_exists(uint8_t scene_id)
+{
+    if (scene_id >= SCENE_COUNT) {
+        return false;
+    }
+    if (ctrl_persist_find(PERSIST_RECORD_SCENE_NAME, scene_id, NULL) != NULL) {
+        return true;
+    }
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        if (ctrl_persist_find(PERSIST_RECORD_SCENE_LAMP, SCENE_LAMP_KEY(scene_id, id), NULL) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *ctrl_scene_get_name(uint8_t scene_id)
+{
+    if (scene_id >= SCENE_COUNT) {
+        return NULL;
+    }
+    return ctrl_persist_find(PERSIST_RECORD_SCENE_NAME, scene_id, NULL);
+}
+
+bool ctrl_scene_save_lamp(uint8_t scene_id, struct Vendor12VRGBAnimationReport *report)
+{
+    if (scene_id >= SCENE_COUNT || report->lamp_id > MAX_LAMP_ID) {
+        return false;
+    }
+    return ctrl_persist_save_async(
+        PERSIST_RECORD_SCENE_LAMP, SCENE_LAMP_KEY(scene_id, report->lamp_id),
+        report, sizeof(struct Vendor12VRGBAnimationReport)
+    );
+}
+
+bool ctrl_scene_save_name(uint8_t scene_id, const char *name)
+{
+    if (scene_id >= SCENE_COUNT) {
+        return false;
+    }
+    return ctrl_persist_save_async(PERSIST_RECORD_SCENE_NAME, scene_id, name, SCENE_NAME_SIZE);
+}
+
+bool ctrl_scene_delete(scene_controller_t *scenectrl, uint8_t scene_id)
+{
+    if (scene_id >= SCENE_COUNT) {
+        return false;
+    }
+
+    // Queue all of the deletes or none of them, so a scene is never left
+    // partly deleted
+    if (ctrl_persist_queue_space() < 1 + LAMP_COUNT) {
+        return false;
+    }
+
+    ctrl_persist_save_async(PERSIST_RECORD_SCENE_NAME, scene_id, NULL, 0);
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        ctrl_persist_save_async(PERSIST_RECORD_SCENE_LAMP, SCENE_LAMP_KEY(scene_id, id), NULL, 0);
+    }
+
+    if (scenectrl->active_scene == scene_id) {
+        scenectrl->active_scene = SCENE_NONE;
+    }
+    return true;
+}
+
+void ctrl_scene_get_rules(scene_controller_t *scenectrl, struct SceneRules *rules)
+{
+    *rules = scenectrl->rules;
+}
+
+bool ctrl_scene_rules_valid(const struct SceneRules *rules)
+{
+    for (uint8_t e = 0; e < SCENE_EVENT_COUNT; e++) {
+        if (rules->scenes[e] != SCENE_NONE && rules->scenes[e] >= SCENE_COUNT) {
+            return false;
+        }
+    }
+
+    // Thresholds without hysteresis would switch scenes on every temperature
+    // check. The thresholds are unused, and may have been saved by older
+    // firmware, while no temperature event has a scene.
+    bool uses_temperature = rules->scenes[SCENE_EVENT_TEMPERATURE_HIGH] != SCENE_NONE
+        || rules->scenes[SCENE_EVENT_TEMPERATURE_NORMAL] != SCENE_NONE;
+    return !uses_temperature || rules->temperature_normal < rules->temperature_high;
+}
+
+bool ctrl_scene_set_rules(scene_controller_t *scenectrl, const struct SceneRules *rules)
+{
+    if (!ctrl_scene_rules_valid(rules)) {
+        return false;
+    }
+    if (!ctrl_persist_save_async(PERSIST_RECORD_SCENE_RULES, 0, rules, sizeof(struct SceneRules))) {
+        return false;
+    }
+
+    scenectrl->rules = *rules;
+    scenectrl->is_temperature_high = false;
+    return true;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(SCENE_NAME_SIZE == SCENE_REPORT_NAME_SIZE, "scene report name size must match SCENE_NAME_SIZE");
+
+static_assert(SCENE_EVENT_COUNT == SCENE_REPORT_EVENT_COUNT, "scene rules report must have one scene per event");
+
+static_assert(PERSIST_QUEUE_LENGTH >= 1 + LAMP_COUNT, "persistence queue is too short to delete a scene");
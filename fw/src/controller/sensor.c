@@ -1,9 +1,13 @@
+#include <assert.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "pico/time.h"
 #include "tusb.h"
 
 #include "controller/sensor.h"
+#include "device/specs.h"
 #include "device/temperature.h"
 #include "hid/descriptor.h"
 #include "hid/sensor/report.h"
@@ -16,26 +20,131 @@ void ctrl_sensor_init(sensor_controller_t *ctrl)
     ctrl->reporting_state = SENSOR_REPORTING_STATE_REPORT_NO_EVENTS;
     ctrl->power_state = SENSOR_POWER_STATE_D4_POWER_OFF;
     ctrl->report_interval = INITIAL_REPORT_INTERVAL_MS;
+    ctrl->change_sensitivity_abs = CFG_RGB_TEMP_SENSOR_CHANGE_SENSITIVITY;
+    ctrl->change_sensitivity_rel_pct = 0;
     ctrl->last_report = nil_time;
+    ctrl->last_report_temperature = 0;
+
+    ctrl_sensor_set_batch_config(ctrl, 0, 0, 0);
+}
+
+static bool is_change_reportable(sensor_controller_t *ctrl, int16_t temperature)
+{
+    if (ctrl->change_sensitivity_abs == 0 && ctrl->change_sensitivity_rel_pct == 0) {
+        return true;
+    }
+
+    int32_t change = abs((int32_t) temperature - ctrl->last_report_temperature);
+    if (ctrl->change_sensitivity_abs != 0 && change >= ctrl->change_sensitivity_abs) {
+        return true;
+    }
+
+    // Compare change / |last| >= rel_pct / 10000 without dividing
+    int32_t base = abs((int32_t) ctrl->last_report_temperature);
+    if (ctrl->change_sensitivity_rel_pct != 0 && 10000 * change >= ctrl->change_sensitivity_rel_pct * base) {
+        return true;
+    }
+
+    return false;
+}
+
+static void batch_sample(struct SensorBatch *batch, absolute_time_t now)
+{
+    if (absolute_time_diff_us(batch->last_sample, now) < 1000 * (int64_t) batch->sample_interval_ms) {
+        return;
+    }
+    batch->last_sample = now;
+
+    // Drop the oldest sample if the host is not keeping up
+    if (batch->count == SENSOR_BATCH_BUFFER_SIZE) {
+        batch->head = (uint8_t) ((batch->head + 1) % SENSOR_BATCH_BUFFER_SIZE);
+        batch->count--;
+        if (batch->dropped < UINT8_MAX) {
+            batch->dropped++;
+        }
+    }
+
+    uint8_t tail = (uint8_t) ((batch->head + batch->count) % SENSOR_BATCH_BUFFER_SIZE);
+    batch->samples[tail].timestamp_ms = to_ms_since_boot(now);
+    batch->samples[tail].temperature = temperature_read();
+    batch->count++;
+}
+
+static bool batch_task(struct SensorBatch *batch, absolute_time_t now)
+{
+    if (batch->size == 0) {
+        return false;
+    }
+
+    batch_sample(batch, now);
+    if (batch->count == 0 || !tud_hid_ready()) {
+        return false;
+    }
+
+    struct SensorSample *oldest = &batch->samples[batch->head];
+    uint32_t age_ms = to_ms_since_boot(now) - oldest->timestamp_ms;
+    if (batch->count < batch->size && age_ms < batch->max_latency_ms) {
+        return false;
+    }
+
+    struct Vendor12VRGBSensorBatchReport report = {0};
+    report.sample_count = (uint8_t) MIN(batch->count, SENSOR_BATCH_REPORT_SAMPLES);
+    report.dropped_samples = batch->dropped;
+    report.timestamp_ms = oldest->timestamp_ms;
+
+    for (uint8_t i = 0; i < report.sample_count; i++) {
+        struct SensorSample *sample = &batch->samples[batch->head];
+        // Samples delayed by a stalled main loop get the largest offset
+        // instead of wrapping
+        uint32_t offset_ms = sample->timestamp_ms - report.timestamp_ms;
+        report.offset_ms[i] = (uint16_t) MIN(offset_ms, UINT16_MAX);
+        report.temperature[i] = sample->temperature;
+
+        batch->head = (uint8_t) ((batch->head + 1) % SENSOR_BATCH_BUFFER_SIZE);
+        batch->count--;
+    }
+    batch->dropped = 0;
+
+    tud_hid_report(HID_REPORT_ID_VENDOR_12VRGB_SENSOR_BATCH, &report, sizeof(report));
+    return true;
 }
 
 void ctrl_sensor_task(sensor_controller_t *ctrl)
 {
+    absolute_time_t now = get_absolute_time();
+
+    // Only one report can be queued at a time, so the temperature report waits
+    // until the next call if a batch was sent
+    if (batch_task(&ctrl->batch, now)) {
+        return;
+    }
+
     if (ctrl->reporting_state == SENSOR_REPORTING_STATE_REPORT_NO_EVENTS ||
             ctrl->power_state == SENSOR_POWER_STATE_D4_POWER_OFF) {
         return;
     }
 
-    absolute_time_t now = get_absolute_time();
     int64_t elapsed_us = absolute_time_diff_us(ctrl->last_report, now);
 
-    if (tud_hid_ready() && elapsed_us >= 1000 * ctrl->report_interval) {
+    // The report interval is the minimum time between reports. After that,
+    // only report when the temperature changes enough or the maximum interval
+    // expires, so a stable temperature produces almost no USB traffic.
+    if (elapsed_us < 1000 * (int64_t) ctrl->report_interval || !tud_hid_ready()) {
+        return;
+    }
+
+    int16_t temperature = temperature_read();
+    bool is_expired = is_nil_time(ctrl->last_report)
+        || (CFG_RGB_TEMP_SENSOR_MAX_REPORT_INTERVAL > 0 && elapsed_us >= 1000 * (int64_t) CFG_RGB_TEMP_SENSOR_MAX_REPORT_INTERVAL);
+
+    if (is_expired || is_change_reportable(ctrl, temperature)) {
         struct EnvironmentalTemperatureInputReport report;
         ctrl_sensor_get_temperature(ctrl, &report);
         report.sensor_event = SENSOR_EVENT_DATA_UPDATED;
 
         tud_hid_report(HID_REPORT_ID_TEMPERATURE, &report, sizeof(report));
         ctrl->last_report = now;
+        ctrl->last_report_temperature = report.temperature;
     }
 }
 
@@ -47,6 +156,8 @@ void ctrl_sensor_get_features(sensor_controller_t *ctrl, struct EnvironmentalTem
     report->reporting_state = ctrl->reporting_state;
     report->power_state = ctrl->power_state;
     report->report_interval = ctrl->report_interval;
+    report->change_sensitivity_abs = ctrl->change_sensitivity_abs;
+    report->change_sensitivity_rel_pct = ctrl->change_sensitivity_rel_pct;
 }
 
 void ctrl_sensor_get_temperature(sensor_controller_t *ctrl, struct EnvironmentalTemperatureInputReport *report)
@@ -70,3 +181,46 @@ void ctrl_sensor_set_report_interval(sensor_controller_t *ctrl, uint32_t interva
 {
     ctrl->report_interval = interval;
 }
+
+void ctrl_sensor_set_change_sensitivity(sensor_controller_t *ctrl, uint16_t absolute, uint16_t rel_pct)
+{
+    ctrl->change_sensitivity_abs = absolute;
+    ctrl->change_sensitivity_rel_pct = rel_pct;
+}
+
+void ctrl_sensor_set_batch_config(sensor_controller_t *ctrl, uint8_t size, uint16_t sample_interval_ms, uint16_t max_latency_ms)
+{
+    struct SensorBatch *batch = &ctrl->batch;
+
+    batch->size = MIN(size, SENSOR_BATCH_REPORT_SAMPLES);
+    batch->sample_interval_ms = MIN(MAX(sample_interval_ms, SENSOR_BATCH_MIN_INTERVAL_MS), SENSOR_BATCH_MAX_INTERVAL_MS);
+    batch->max_latency_ms = MIN(max_latency_ms, SENSOR_BATCH_MAX_LATENCY_MS);
+
+    batch->head = 0;
+    batch->count = 0;
+    batch->dropped = 0;
+    batch->last_sample = nil_time;
+}
+
+void ctrl_sensor_get_batch_config(sensor_controller_t *ctrl, struct Vendor12VRGBSensorBatchConfigReport *report)
+{
+    report->batch_size = ctrl->batch.size;
+    report->sample_interval_ms = ctrl->batch.sample_interval_ms;
+    report->max_latency_ms = ctrl->batch.max_latency_ms;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    sizeof(struct Vendor12VRGBSensorBatchReport) <= CFG_TUD_HID_EP_BUFSIZE - 1,
+    "sensor batch report must fit in one packet with the report ID"
+);
+
+static_assert(
+    (SENSOR_BATCH_REPORT_SAMPLES - 1) * SENSOR_BATCH_MAX_INTERVAL_MS <= UINT16_MAX,
+    "sensor batch sample offsets must fit in uint16_t"
+);
+
+static_assert(SENSOR_BATCH_BUFFER_SIZE <= UINT8_MAX, "sensor batch buffer indexes must fit in uint8_t");
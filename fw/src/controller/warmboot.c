@@ -0,0 +1,217 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hardware/watchdog.h"
+#include "pico/time.h"
+
+#include "controller/animations/fade.h"
+#include "controller/animations/thermal.h"
+#include "controller/controller.h"
+#include "controller/sensor.h"
+#include "controller/warmboot.h"
+#include "device/lamp.h"
+#include "device/specs.h"
+
+/*
+ * The controller state is copied to one of two snapshot buffers in RAM that
+ * is not initialized by the C runtime, so it survives a watchdog or software
+ * reset. After each copy completes, the watchdog scratch registers record
+ * which buffer is valid. If a reset happens during a copy, the registers
+ * still point at the previous complete snapshot.
+ *
+ * The scratch registers are cleared by a power-on reset, so stale RAM contents
+ * are never used after a power cycle.
+ *
+ * Frame callbacks are saved as an index into a table instead of as a pointer,
+ * so a snapshot never calls into unexpected code. Animation data must not
+ * contain pointers.
+ */
+
+#define WARMBOOT_MAGIC      0x57524d42 /* "WRMB" */
+
+/**
+ * Identifies the snapshot layout, so that a snapshot saved by different
+ * firmware is ignored. Increment the version when the meaning of a saved
+ * field changes without changing the snapshot size.
+ */
+#define WARMBOOT_VERSION    3
+#define WARMBOOT_LAYOUT     ((WARMBOOT_VERSION << 16) | sizeof(struct WarmbootSnapshot))
+
+struct WarmbootSnapshot {
+    uint32_t layout;
+
+    bool is_autonomous;
+    struct LampValue lamp_values[LAMP_COUNT];
+    struct LampValue lamp_outputs[LAMP_COUNT];
+
+    uint8_t frame_cb[LAMP_COUNT];
+    struct AnimationState animation[LAMP_COUNT];
+
+    enum SensorReportingState reporting_state;
+    enum SensorPowerState power_state;
+    uint32_t report_interval;
+    uint16_t change_sensitivity_abs;
+    uint16_t change_sensitivity_rel_pct;
+};
+
+static const FrameCallback frame_callbacks[] = {
+    NULL,
+    anim_fade,
+    anim_thermal,
+};
+
+#define FRAME_CALLBACK_COUNT (sizeof(frame_callbacks) / sizeof(frame_callbacks[0]))
+
+static struct WarmbootSnapshot __uninitialized_ram(snapshots)[2];
+
+static absolute_time_t last_snapshot;
+static bool is_resume_stable;
+
+static uint8_t frame_callback_index(FrameCallback frame_cb);
+
+void ctrl_warmboot_init()
+{
+    last_snapshot = nil_time;
+    is_resume_stable = false;
+
+#if CFG_RGB_WATCHDOG_TIMEOUT > 0
+    watchdog_enable(CFG_RGB_WATCHDOG_TIMEOUT, true);
+#endif
+}
+
+bool ctrl_warmboot_restore(controller_t *ctrl, sensor_controller_t *sensectrl)
+{
+    if (watchdog_hw->scratch[WARMBOOT_SCRATCH_MAGIC] != WARMBOOT_MAGIC) {
+        return false;
+    }
+
+    uint32_t select = watchdog_hw->scratch[WARMBOOT_SCRATCH_SELECT];
+    uint32_t resumes = watchdog_hw->scratch[WARMBOOT_SCRATCH_RESUMES];
+    if (select > 1 || resumes >= WARMBOOT_MAX_RESUMES) {
+        ctrl_warmboot_invalidate();
+        return false;
+    }
+
+    const struct WarmbootSnapshot *snapshot = &snapshots[select];
+    if (snapshot->layout != WARMBOOT_LAYOUT) {
+        ctrl_warmboot_invalidate();
+        return false;
+    }
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        if (snapshot->frame_cb[id] >= FRAME_CALLBACK_COUNT) {
+            ctrl_warmboot_invalidate();
+            return false;
+        }
+    }
+
+    watchdog_hw->scratch[WARMBOOT_SCRATCH_RESUMES] = resumes + 1;
+
+    // Set the lamps first to minimize the time they are dark. Calibration and
+    // the temperature are not loaded yet, so write the duty that was on the
+    // outputs before the reset; the first task computes it again.
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        ctrl->lamp_state[id].current = snapshot->lamp_values[id];
+        ctrl->lamp_state[id].output = snapshot->lamp_outputs[id];
+        lamp_set_value(id, snapshot->lamp_outputs[id]);
+    }
+    ctrl->is_autonomous = snapshot->is_autonomous;
+
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        ctrl->frame_cb[id] = frame_callbacks[snapshot->frame_cb[id]];
+        ctrl->animation[id] = snapshot->animation[id];
+    }
+
+    sensectrl->reporting_state = snapshot->reporting_state;
+    sensectrl->power_state = snapshot->power_state;
+    sensectrl->report_interval = snapshot->report_interval;
+    sensectrl->change_sensitivity_abs = snapshot->change_sensitivity_abs;
+    sensectrl->change_sensitivity_rel_pct = snapshot->change_sensitivity_rel_pct;
+
+    return true;
+}
+
+void ctrl_warmboot_task(controller_t *ctrl, sensor_controller_t *sensectrl)
+{
+#if CFG_RGB_WATCHDOG_TIMEOUT > 0
+    watchdog_update();
+#endif
+
+    absolute_time_t now = get_absolute_time();
+    if (absolute_time_diff_us(last_snapshot, now) >= ANIM_FRAME_TIME_US) {
+        ctrl_warmboot_save(ctrl, sensectrl);
+        last_snapshot = now;
+    }
+
+    if (!is_resume_stable && to_us_since_boot(now) >= WARMBOOT_STABLE_TIME_US) {
+        watchdog_hw->scratch[WARMBOOT_SCRATCH_RESUMES] = 0;
+        is_resume_stable = true;
+    }
+}
+
+void ctrl_warmboot_save(controller_t *ctrl, sensor_controller_t *sensectrl)
+{
+    // Write the buffer that is not currently valid
+    uint32_t select = 0;
+    if (watchdog_hw->scratch[WARMBOOT_SCRATCH_MAGIC] == WARMBOOT_MAGIC) {
+        select = watchdog_hw->scratch[WARMBOOT_SCRATCH_SELECT] == 0 ? 1 : 0;
+    }
+
+    struct WarmbootSnapshot *snapshot = &snapshots[select];
+    snapshot->layout = WARMBOOT_LAYOUT;
+
+    snapshot->is_autonomous = ctrl->is_autonomous;
+    for (uint8_t id = 0; id < LAMP_COUNT; id++) {
+        snapshot->lamp_values[id] = ctrl->lamp_state[id].current;
+        snapshot->lamp_outputs[id] = ctrl->lamp_state[id].output;
+        snapshot->frame_cb[id] = frame_callback_index(ctrl->frame_cb[id]);
+        snapshot->animation[id] = ctrl->animation[id];
+    }
+
+    snapshot->reporting_state = sensectrl->reporting_state;
+    snapshot->power_state = sensectrl->power_state;
+    snapshot->report_interval = sensectrl->report_interval;
+    snapshot->change_sensitivity_abs = sensectrl->change_sensitivity_abs;
+    snapshot->change_sensitivity_rel_pct = sensectrl->change_sensitivity_rel_pct;
+
+    watchdog_hw->scratch[WARMBOOT_SCRATCH_SELECT] = select;
+    watchdog_hw->scratch[WARMBOOT_SCRATCH_MAGIC] = WARMBOOT_MAGIC;
+}
+
+void ctrl_warmboot_invalidate()
+{
+    watchdog_hw->scratch[WARMBOOT_SCRATCH_MAGIC] = 0;
+    watchdog_hw->scratch[WARMBOOT_SCRATCH_RESUMES] = 0;
+}
+
+void ctrl_warmboot_pause_watchdog(bool pause)
+{
+#if CFG_RGB_WATCHDOG_TIMEOUT > 0
+    if (pause) {
+        hw_clear_bits(&watchdog_hw->ctrl, WATCHDOG_CTRL_ENABLE_BITS);
+    } else {
+        watchdog_enable(CFG_RGB_WATCHDOG_TIMEOUT, true);
+    }
+#endif
+}
+
+static uint8_t frame_callback_index(FrameCallback frame_cb)
+{
+    for (uint8_t i = 0; i < FRAME_CALLBACK_COUNT; i++) {
+        if (frame_callbacks[i] == frame_cb) {
+            return i;
+        }
+    }
+    // Unknown callbacks are not resumed
+    return 0;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    FRAME_CALLBACK_COUNT <= UINT8_MAX,
+    "too many frame callbacks for warm boot snapshots"
+);
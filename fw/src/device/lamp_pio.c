@@ -0,0 +1,217 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+
+#include "device/lamp.h"
+#include "device/specs.h"
+#include "device/sysclk.h"
+
+#if CFG_RGB_LAMP_BACKEND == LAMP_BACKEND_PIO
+
+#include "lamp_bcm.pio.h"
+
+/**
+ * The number of PIO cycles for the least significant bit plane. The program
+ * needs at least 3 cycles per plane, and 4 makes every plane a power of two.
+ */
+#define BCM_LSB_CYCLES      4
+#define BCM_PERIOD_CYCLES   (BCM_LSB_CYCLES * ((1u << CFG_RGB_PIO_BIT_DEPTH) - 1))
+
+/**
+ * The number of planes the TX FIFO holds. With the FIFO joined, DMA runs this
+ * many planes ahead of the state machine.
+ */
+#define BCM_FIFO_PLANES     4
+
+#define BCM_PIO             pio0
+#define BCM_DMA_IRQ         DMA_IRQ_0
+
+struct BitPlane {
+    uint32_t pins;
+    uint32_t delay;
+};
+
+// The planes set by lamp_set_value, copied to the inactive buffer at the start
+// of the next period
+static struct BitPlane planes[CFG_RGB_PIO_BIT_DEPTH];
+static volatile bool planes_dirty;
+
+// The control DMA channel reads the active buffer address at the start of each
+// period and starts the data channel with it
+static struct BitPlane buffers[2][CFG_RGB_PIO_BIT_DEPTH];
+static struct BitPlane *volatile active_buffer;
+
+static uint sm;
+static uint data_channel;
+static uint control_channel;
+static uint pin_base;
+
+/**
+ * @brief Returns the PIO clock divider for CFG_RGB_PIO_FREQUENCY at the
+ * current system clock.
+ */
+static float pio_clock_divider()
+{
+    float div = (float) clock_get_hz(clk_sys) / ((float) CFG_RGB_PIO_FREQUENCY * BCM_PERIOD_CYCLES);
+    return div < 1.0f ? 1.0f : div;
+}
+
+/**
+ * @brief Swaps in the latest planes at the start of a period. The buffer that
+ * was active is not read again until the next period, so it is safe to write.
+ */
+static void __time_critical_func(bcm_period_handler)()
+{
+    dma_channel_acknowledge_irq0(control_channel);
+
+    if (planes_dirty) {
+        struct BitPlane *next = active_buffer == buffers[0] ? buffers[1] : buffers[0];
+        memcpy(next, planes, sizeof(planes));
+        active_buffer = next;
+        planes_dirty = false;
+    }
+}
+
+void lamp_init()
+{
+    // Output pins are a contiguous range starting from the lowest lamp GPIO
+    uint pin_max = 0;
+    pin_base = NUM_BANK0_GPIOS;
+    for (uint8_t i = 0; i < LAMP_COUNT; i++) {
+        for (uint8_t j = 0; j < 3; j++) {
+            uint pin = lamp_gpios[i][j];
+            pin_base = pin < pin_base ? pin : pin_base;
+            pin_max = pin > pin_max ? pin : pin_max;
+        }
+    }
+
+    for (uint8_t i = 0; i < CFG_RGB_PIO_BIT_DEPTH; i++) {
+        planes[i].pins = 0;
+        planes[i].delay = ((uint32_t) BCM_LSB_CYCLES << i) - 3;
+    }
+    memcpy(buffers[0], planes, sizeof(planes));
+    memcpy(buffers[1], planes, sizeof(planes));
+    active_buffer = buffers[0];
+    planes_dirty = false;
+
+    // The outputs stay low until the first period starts
+    uint offset = pio_add_program(BCM_PIO, &lamp_bcm_program);
+    sm = (uint) pio_claim_unused_sm(BCM_PIO, true);
+    lamp_bcm_program_init(BCM_PIO, sm, offset, pin_base, pin_max - pin_base + 1, pio_clock_divider());
+    for (uint8_t i = 0; i < LAMP_COUNT; i++) {
+        for (uint8_t j = 0; j < 3; j++) {
+            pio_gpio_init(BCM_PIO, lamp_gpios[i][j]);
+        }
+    }
+
+    data_channel = (uint) dma_claim_unused_channel(true);
+    control_channel = (uint) dma_claim_unused_channel(true);
+
+    // The data channel sends one period of planes to the state machine, then
+    // triggers the control channel to restart it
+    dma_channel_config data_config = dma_channel_get_default_config(data_channel);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&data_config, true);
+    channel_config_set_write_increment(&data_config, false);
+    channel_config_set_dreq(&data_config, pio_get_dreq(BCM_PIO, sm, true));
+    channel_config_set_chain_to(&data_config, control_channel);
+    dma_channel_configure(data_channel, &data_config, &BCM_PIO->txf[sm], NULL,
+                          CFG_RGB_PIO_BIT_DEPTH * sizeof(struct BitPlane) / sizeof(uint32_t), false);
+
+    dma_channel_config control_config = dma_channel_get_default_config(control_channel);
+    channel_config_set_transfer_data_size(&control_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&control_config, false);
+    channel_config_set_write_increment(&control_config, false);
+    dma_channel_configure(control_channel, &control_config, &dma_hw->ch[data_channel].al3_read_addr_trig,
+                          &active_buffer, 1, false);
+
+    dma_channel_set_irq0_enabled(control_channel, true);
+    irq_set_exclusive_handler(BCM_DMA_IRQ, bcm_period_handler);
+    irq_set_enabled(BCM_DMA_IRQ, true);
+
+    pio_sm_set_enabled(BCM_PIO, sm, true);
+    dma_channel_start(control_channel);
+}
+
+void lamp_update_clock()
+{
+    pio_sm_set_clkdiv(BCM_PIO, sm, pio_clock_divider());
+}
+
+void __time_critical_func(lamp_set_value)(uint8_t lamp_id, struct LampValue value)
+{
+    if (lamp_id > MAX_LAMP_ID) {
+        return;
+    }
+
+    uint32_t levels[3] = { 0, 0, 0 };
+    if (value.i > 0) {
+        levels[0] = value.r >> (16 - CFG_RGB_PIO_BIT_DEPTH);
+        levels[1] = value.g >> (16 - CFG_RGB_PIO_BIT_DEPTH);
+        levels[2] = value.b >> (16 - CFG_RGB_PIO_BIT_DEPTH);
+    }
+
+    uint32_t lamp_mask = 0;
+    for (uint8_t j = 0; j < 3; j++) {
+        lamp_mask |= 1u << (lamp_gpios[lamp_id][j] - pin_base);
+    }
+
+    // Keep the period handler from copying a partially updated lamp
+    uint32_t status = save_and_disable_interrupts();
+    for (uint8_t i = 0; i < CFG_RGB_PIO_BIT_DEPTH; i++) {
+        uint32_t pins = planes[i].pins & ~lamp_mask;
+        for (uint8_t j = 0; j < 3; j++) {
+            pins |= ((levels[j] >> i) & 1) << (lamp_gpios[lamp_id][j] - pin_base);
+        }
+        planes[i].pins = pins;
+    }
+    planes_dirty = true;
+    restore_interrupts(status);
+}
+
+uint16_t __time_critical_func(lamp_get_phase)(uint8_t lamp_id)
+{
+    (void) lamp_id;
+
+    // All lamps share one period. The data channel counts down the words left
+    // in it, two per plane, and the state machine is running the plane before
+    // those in the FIFO. Only the start of that plane is known.
+    uint32_t words = CFG_RGB_PIO_BIT_DEPTH * sizeof(struct BitPlane) / sizeof(uint32_t);
+    uint32_t sent = (words - dma_hw->ch[data_channel].transfer_count) / 2;
+    uint32_t plane = (sent + CFG_RGB_PIO_BIT_DEPTH - 1 - BCM_FIFO_PLANES) % CFG_RGB_PIO_BIT_DEPTH;
+    uint32_t cycles = BCM_LSB_CYCLES * ((1u << plane) - 1);
+    return (uint16_t) ((uint64_t) cycles * 0x10000 / BCM_PERIOD_CYCLES);
+}
+
+uint32_t __time_critical_func(lamp_get_update_delay_us)(uint8_t lamp_id)
+{
+    // New planes are copied at the start of the next period, after the control
+    // channel has already read the buffer for it, so they are shown from the
+    // period after that
+    float period_us = pio_clock_divider() * BCM_PERIOD_CYCLES * 1e6f / (float) clock_get_hz(clk_sys);
+    return (uint32_t) (period_us * (float) (0x20000 - lamp_get_phase(lamp_id)) / 65536.0f);
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    CFG_RGB_PIO_BIT_DEPTH >= 8 && CFG_RGB_PIO_BIT_DEPTH <= 16,
+    "CFG_RGB_PIO_BIT_DEPTH must be in range [8, 16]"
+);
+
+static_assert(
+    (uint64_t) CFG_RGB_PIO_FREQUENCY * BCM_PERIOD_CYCLES <= (CFG_RGB_CLOCK_SCALING ? SYSCLK_REDUCED_HZ : SYSCLK_FULL_HZ),
+    "CFG_RGB_PIO_FREQUENCY is too high for CFG_RGB_PIO_BIT_DEPTH at the system clock"
+);
+
+#endif // CFG_RGB_LAMP_BACKEND == LAMP_BACKEND_PIO
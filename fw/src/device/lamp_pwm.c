@@ -0,0 +1,155 @@
+#include <assert.h>
+
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+#include "pico/platform.h"
+
+#include "device/lamp.h"
+#include "device/specs.h"
+
+#if CFG_RGB_LAMP_BACKEND == LAMP_BACKEND_PWM
+
+/**
+ * The system clock frequency that CFG_RGB_PWM_CLOCK_DIVIDER is relative to.
+ *
+ * Units: Hertz
+ */
+#define PWM_REFERENCE_SYS_HZ 125000000
+
+/**
+ * Phase-correct counters count up and then down, which doubles the period.
+ */
+#define PWM_PERIOD_MULTIPLIER (CFG_RGB_PWM_PHASE_CORRECT ? 2 : 1)
+
+static uint32_t slice_mask;
+
+/**
+ * @brief Returns the PWM clock divider that gives the same PWM frequency at the
+ * current system clock as CFG_RGB_PWM_CLOCK_DIVIDER does at 125 MHz.
+ */
+static float pwm_clock_divider()
+{
+    float div = CFG_RGB_PWM_CLOCK_DIVIDER * ((float) clock_get_hz(clk_sys) / PWM_REFERENCE_SYS_HZ);
+    div /= PWM_PERIOD_MULTIPLIER;
+    return div < 1.0f ? 1.0f : div;
+}
+
+/**
+ * @brief Enables all used PWM slices at once.
+ *
+ * With CFG_RGB_PWM_STAGGER, each slice's counter starts at a different offset
+ * so the channels of different slices turn on at different times in each
+ * period, instead of all at the start. Slices share the same clock, so the
+ * offsets are kept until the next reset.
+ */
+static void start_slices()
+{
+#if CFG_RGB_PWM_STAGGER
+    uint32_t slice_count = (uint32_t) __builtin_popcount(slice_mask);
+    uint32_t index = 0;
+    for (uint slice = 0; slice < NUM_PWM_SLICES; slice++) {
+        if ((slice_mask & (uint32_t) (1 << slice)) != 0) {
+            pwm_set_counter(slice, (uint16_t) (index * 0x10000 / slice_count));
+            index++;
+        }
+    }
+#endif
+
+    pwm_set_mask_enabled(slice_mask);
+}
+
+void lamp_init()
+{
+    pwm_config config = pwm_get_default_config();
+    pwm_config_set_clkdiv(&config, pwm_clock_divider());
+    pwm_config_set_phase_correct(&config, CFG_RGB_PWM_PHASE_CORRECT);
+
+    slice_mask = 0;
+    for (uint8_t i = 0; i < LAMP_COUNT; i++) {
+        for (uint8_t j = 0; j < 3; j++) {
+            uint8_t pin = lamp_gpios[i][j];
+            gpio_set_function(pin, GPIO_FUNC_PWM);
+
+            uint slice = pwm_gpio_to_slice_num(pin);
+            if ((slice_mask & (uint32_t) (1 << slice)) == 0) {
+                pwm_init(slice, &config, false);
+                slice_mask |= (uint32_t) (1 << slice);
+            }
+            pwm_set_chan_level(slice, pwm_gpio_to_channel(pin), 0);
+        }
+    }
+
+    start_slices();
+}
+
+void lamp_update_clock()
+{
+    float div = pwm_clock_divider();
+    for (uint slice = 0; slice < NUM_PWM_SLICES; slice++) {
+        if ((slice_mask & (uint32_t) (1 << slice)) != 0) {
+            pwm_set_clkdiv(slice, div);
+        }
+    }
+}
+
+void __time_critical_func(lamp_set_value)(uint8_t lamp_id, struct LampValue value)
+{
+    if (lamp_id > MAX_LAMP_ID) {
+        return;
+    }
+
+    uint8_t rp = lamp_gpios[lamp_id][0];
+    uint8_t gp = lamp_gpios[lamp_id][1];
+    uint8_t bp = lamp_gpios[lamp_id][2];
+
+    if (value.i > 0) {
+        pwm_set_gpio_level(rp, value.r);
+        pwm_set_gpio_level(gp, value.g);
+        pwm_set_gpio_level(bp, value.b);
+    } else {
+        pwm_set_gpio_level(rp, 0);
+        pwm_set_gpio_level(gp, 0);
+        pwm_set_gpio_level(bp, 0);
+    }
+}
+
+uint16_t __time_critical_func(lamp_get_phase)(uint8_t lamp_id)
+{
+    if (lamp_id > MAX_LAMP_ID) {
+        return 0;
+    }
+
+    uint slice = pwm_gpio_to_slice_num(lamp_gpios[lamp_id][0]);
+    uint16_t counter = pwm_get_counter(slice);
+
+#if CFG_RGB_PWM_PHASE_CORRECT
+    // The counter reads the same counting up and down, so wait for the next
+    // count to find the direction
+    uint16_t next;
+    while ((next = pwm_get_counter(slice)) == counter) {
+        tight_loop_contents();
+    }
+    return next > counter ? (uint16_t) (next >> 1) : (uint16_t) (0xFFFF - (next >> 1));
+#else
+    return counter;
+#endif
+}
+
+uint32_t __time_critical_func(lamp_get_update_delay_us)(uint8_t lamp_id)
+{
+    // Levels are latched when the counter wraps at the end of the period
+    float period_us = 65536.0f * PWM_PERIOD_MULTIPLIER * pwm_clock_divider() * 1e6f / (float) clock_get_hz(clk_sys);
+    return (uint32_t) (period_us * (float) (0x10000 - lamp_get_phase(lamp_id)) / 65536.0f);
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    CFG_RGB_PWM_CLOCK_DIVIDER / PWM_PERIOD_MULTIPLIER >= 1.0f,
+    "CFG_RGB_PWM_CLOCK_DIVIDER is too small for phase-correct PWM"
+);
+
+#endif // CFG_RGB_LAMP_BACKEND == LAMP_BACKEND_PWM
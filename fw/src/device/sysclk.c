@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "pico/time.h"
+
+#include "device/lamp.h"
+#include "device/specs.h"
+#include "device/sysclk.h"
+#include "trace.h"
+
+/**
+ * The USB PLL always runs at 48 MHz for USB, and also drives the ADC and
+ * peripheral clocks.
+ */
+#define USB_PLL_HZ 48000000
+
+static enum SysclkMode mode = SYSCLK_MODE_FULL;
+static uint64_t residency_us[SYSCLK_MODE_COUNT];
+static uint64_t mode_start_us;
+
+void sysclk_init()
+{
+    // By default, the peripheral clock follows the system clock. Run it from
+    // the USB PLL instead so the UART baud rate does not change with the mode.
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_PLL_HZ, USB_PLL_HZ);
+
+    // Nothing uses the RTC
+    clock_stop(clk_rtc);
+
+    mode = SYSCLK_MODE_FULL;
+    mode_start_us = time_us_64();
+}
+
+void sysclk_set_mode(enum SysclkMode next)
+{
+#if CFG_RGB_CLOCK_SCALING
+    if (next == mode) {
+        return;
+    }
+
+    if (next == SYSCLK_MODE_FULL) {
+        // Restart the system PLL with the same settings as the SDK's startup
+        // code: 12 MHz / 1 * 125 = 1500 MHz, then / 6 / 2 = 125 MHz
+        pll_init(pll_sys, 1, 1500000000, 6, 2);
+        clock_configure(clk_sys,
+                        CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                        CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS,
+                        SYSCLK_FULL_HZ, SYSCLK_FULL_HZ);
+    } else if (mode == SYSCLK_MODE_FULL) {
+        clock_configure(clk_sys,
+                        CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                        CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                        USB_PLL_HZ, SYSCLK_REDUCED_HZ);
+        pll_deinit(pll_sys);
+    }
+
+    if (next == SYSCLK_MODE_SLEEP) {
+        // Temperatures are not read while sleeping
+        clock_stop(clk_adc);
+    } else if (mode == SYSCLK_MODE_SLEEP) {
+        clock_configure(clk_adc, 0, CLOCKS_CLK_ADC_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_PLL_HZ, USB_PLL_HZ);
+    }
+
+    lamp_update_clock();
+
+    uint64_t now = time_us_64();
+    residency_us[mode] += now - mode_start_us;
+    mode_start_us = now;
+    TRACE(TRACE_EVENT_CLOCK_MODE, next, mode, (uint32_t) (residency_us[mode] / 1000));
+    mode = next;
+#endif
+}
+
+enum SysclkMode sysclk_get_mode()
+{
+    return mode;
+}
+
+uint64_t sysclk_get_residency_us(enum SysclkMode m)
+{
+    uint64_t residency = residency_us[m];
+    if (m == mode) {
+        residency += time_us_64() - mode_start_us;
+    }
+    return residency;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    !CFG_RGB_CLOCK_SCALING || CFG_RGB_LAMP_BACKEND != LAMP_BACKEND_PWM
+        || CFG_RGB_PWM_CLOCK_DIVIDER * SYSCLK_REDUCED_HZ / SYSCLK_FULL_HZ / (CFG_RGB_PWM_PHASE_CORRECT ? 2 : 1) >= 1.0f,
+    "CFG_RGB_PWM_CLOCK_DIVIDER is too small to keep the PWM frequency at the reduced clock"
+);
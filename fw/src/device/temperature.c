@@ -1,36 +1,171 @@
+#include <assert.h>
 #include <stdint.h>
 
 #include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "pico/time.h"
 
 #include "device/specs.h"
 #include "device/temperature.h"
 
 #define TEMP_SENSOR_ADC_INPUT 4
 
+/**
+ * The ADC clock frequency. This is fixed at 48 MHz by the USB PLL.
+ *
+ * Units: Hertz
+ */
+#define ADC_CLOCK_HZ 48000000
+
+/**
+ * How often to average the sample buffer and update the filtered value.
+ *
+ * Units: Microseconds
+ */
+#define TEMP_UPDATE_INTERVAL_US 10000
+
+/**
+ * The filtered value is the raw 12-bit ADC value with 8 fractional bits.
+ */
+#define TEMP_FILTER_FRAC_BITS 8
+
+/*
+ * Convert from ADC units to centidegrees with the formula from the RP2040
+ * datasheet, T = 27 - (V - 0.706) / 0.001721, rearranged as
+ *
+ *   T = offset - slope * adc_value
+ *
+ * so that the conversion is one multiply in fixed point. The slope has 16
+ * fractional bits. The compiler evaluates the float math at build time.
+ */
+#define TEMP_OFFSET_CENTI \
+    ((int32_t) (100.0f * (27.0f + 0.706f / 0.001721f + CFG_RGB_TEMP_SENSOR_ADJUST)))
+#define TEMP_SLOPE_Q16 \
+    ((int64_t) (65536.0f * 100.0f * CFG_RGB_TEMP_SENSOR_REF_VOLTAGE / (1 << 12) / 0.001721f))
+
+// Written continuously by DMA. The DMA ring wraps on the buffer size, so the
+// buffer must be aligned to its size.
+static uint16_t samples[CFG_RGB_TEMP_SENSOR_SAMPLES]
+    __attribute__ ((aligned (CFG_RGB_TEMP_SENSOR_SAMPLES * sizeof(uint16_t))));
+
+static int dma_channel;
+
+static int32_t filtered;
+static int16_t temperature;
+static int16_t temperature_min;
+static int16_t temperature_max;
+static absolute_time_t last_update;
+
+static int16_t filtered_to_centidegrees(int32_t value)
+{
+    int64_t scaled = ((int64_t) value * TEMP_SLOPE_Q16) >> (16 + TEMP_FILTER_FRAC_BITS);
+    return (int16_t) (TEMP_OFFSET_CENTI - scaled);
+}
+
+static void start_dma()
+{
+    // The ring wraps the write address, so the transfer count only limits how
+    // long the channel runs before temperature_task restarts it (~50 days at
+    // 1 kHz).
+    dma_channel_config config = dma_channel_get_default_config((uint) dma_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, (uint) __builtin_ctz(sizeof(samples)));
+    channel_config_set_dreq(&config, DREQ_ADC);
+
+    dma_channel_configure((uint) dma_channel, &config, samples, &adc_hw->fifo, UINT32_MAX, true);
+}
+
 void temperature_init()
 {
     adc_init();
     adc_set_temp_sensor_enabled(true);
     adc_select_input(TEMP_SENSOR_ADC_INPUT);
+
+    // Take one blocking reading so the cached value is valid immediately
+    uint16_t first = adc_read();
+    for (uint16_t i = 0; i < CFG_RGB_TEMP_SENSOR_SAMPLES; i++) {
+        samples[i] = first;
+    }
+    filtered = (int32_t) first << TEMP_FILTER_FRAC_BITS;
+    temperature = filtered_to_centidegrees(filtered);
+    temperature_min = temperature;
+    temperature_max = temperature;
+    last_update = get_absolute_time();
+
+    // Sample continuously into the ring buffer
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv((float) ADC_CLOCK_HZ / CFG_RGB_TEMP_SENSOR_SAMPLE_RATE - 1);
+
+    dma_channel = dma_claim_unused_channel(true);
+    start_dma();
+
+    adc_run(true);
 }
 
-int16_t temperature_read()
+void temperature_task()
 {
-    // Scale 12-bit ADC values to full voltage range
-    const float volts_per_unit = CFG_RGB_TEMP_SENSOR_REF_VOLTAGE / (1 << 12);
+    if (!dma_channel_is_busy((uint) dma_channel)) {
+        start_dma();
+    }
 
-    // Sample the internal temperature sensor
-    uint32_t adc_value = 0;
-    for (uint8_t i = 0; i < CFG_RGB_TEMP_SENSOR_SAMPLES; i++) {
-        adc_value += adc_read();
+    absolute_time_t now = get_absolute_time();
+    if (absolute_time_diff_us(last_update, now) < TEMP_UPDATE_INTERVAL_US) {
+        return;
     }
+    last_update = now;
 
-    // Average samples and convert to voltage
-    float voltage = (float) (adc_value / CFG_RGB_TEMP_SENSOR_SAMPLES) * volts_per_unit;
+    // Average the ring buffer. DMA writes each halfword atomically, so reading
+    // while it runs only mixes samples from adjacent updates.
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < CFG_RGB_TEMP_SENSOR_SAMPLES; i++) {
+        sum += samples[i];
+    }
+    int32_t average = (int32_t) ((sum << TEMP_FILTER_FRAC_BITS) / CFG_RGB_TEMP_SENSOR_SAMPLES);
 
-    // Compute temperature using formula from RP2040 datasheet
-    float temp = 27.0f - (voltage - 0.706f) / 0.001721f + CFG_RGB_TEMP_SENSOR_ADJUST;
+    // Apply an exponential moving average to remove remaining noise
+    filtered += (average - filtered) >> CFG_RGB_TEMP_SENSOR_FILTER_SHIFT;
+
+    temperature = filtered_to_centidegrees(filtered);
+    if (temperature < temperature_min) {
+        temperature_min = temperature;
+    }
+    if (temperature > temperature_max) {
+        temperature_max = temperature;
+    }
+}
 
-    // Convert to integer centidegrees
-    return (int16_t) (100.0f * temp);
+int16_t temperature_read()
+{
+    return temperature;
 }
+
+int16_t temperature_read_min()
+{
+    return temperature_min;
+}
+
+int16_t temperature_read_max()
+{
+    return temperature_max;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(
+    (CFG_RGB_TEMP_SENSOR_SAMPLES & (CFG_RGB_TEMP_SENSOR_SAMPLES - 1)) == 0,
+    "CFG_RGB_TEMP_SENSOR_SAMPLES must be a power of two"
+);
+
+static_assert(
+    CFG_RGB_TEMP_SENSOR_SAMPLES >= 2 && CFG_RGB_TEMP_SENSOR_SAMPLES <= 256,
+    "CFG_RGB_TEMP_SENSOR_SAMPLES must be in range [2, 256]"
+);
+
+static_assert(
+    CFG_RGB_TEMP_SENSOR_SAMPLE_RATE > ADC_CLOCK_HZ / 65536 && CFG_RGB_TEMP_SENSOR_SAMPLE_RATE <= ADC_CLOCK_HZ / 96,
+    "CFG_RGB_TEMP_SENSOR_SAMPLE_RATE is outside the range supported by the ADC"
+);
@@ -0,0 +1,121 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hardware/watchdog.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "device/specs.h"
+#include "events.h"
+#include "hid/descriptor.h"
+#include "hid/vendor/report.h"
+
+#if CFG_RGB_EVENTS
+
+#define EVENTS_MASK (CFG_RGB_EVENTS_SIZE - 1)
+
+/**
+ * Events are written at head and read from tail. Both count up without
+ * wrapping to the queue size, so the queue is full when they differ by
+ * CFG_RGB_EVENTS_SIZE.
+ */
+static struct Vendor12VRGBEventsEntry queue[CFG_RGB_EVENTS_SIZE];
+static uint32_t head;
+static uint32_t tail;
+static uint32_t dropped;
+
+static uint16_t subscribed;
+
+static uint32_t boot_us;
+static uint8_t reset_cause;
+static bool warm_boot;
+
+static void __time_critical_func(push)(uint32_t timestamp_us, enum EventsType type, uint8_t arg8, uint16_t arg16)
+{
+    if (head - tail == CFG_RGB_EVENTS_SIZE) {
+        tail++;
+        dropped++;
+    }
+    struct Vendor12VRGBEventsEntry *entry = &queue[head & EVENTS_MASK];
+    entry->timestamp_us = timestamp_us;
+    entry->type = (uint8_t) type;
+    entry->arg8 = arg8;
+    entry->arg16 = arg16;
+    head++;
+}
+
+void events_init(bool is_warm_boot)
+{
+    boot_us = time_us_32();
+    warm_boot = is_warm_boot;
+
+    // Any watchdog reset that was not a timeout was requested with
+    // watchdog_reboot, by the reset report or a debugger
+    if (watchdog_enable_caused_reboot()) {
+        reset_cause = EVENTS_RESET_WATCHDOG;
+    } else if (watchdog_caused_reboot()) {
+        reset_cause = EVENTS_RESET_REBOOT;
+    } else {
+        reset_cause = EVENTS_RESET_POWER_ON;
+    }
+}
+
+void __time_critical_func(events_post)(enum EventsType type, uint8_t arg8, uint16_t arg16)
+{
+    if ((subscribed & (1u << type)) == 0) {
+        return;
+    }
+    push(time_us_32(), type, arg8, arg16);
+}
+
+void events_task()
+{
+    if (head == tail || !tud_hid_ready()) {
+        return;
+    }
+
+    struct Vendor12VRGBEventsReport report;
+    uint8_t count = 0;
+    while (count < EVENTS_REPORT_ENTRIES && tail != head) {
+        report.entries[count++] = queue[tail & EVENTS_MASK];
+        tail++;
+    }
+    memset(&report.entries[count], 0, (EVENTS_REPORT_ENTRIES - count) * sizeof(report.entries[0]));
+    report.entry_count = count;
+    report.dropped_entries = (uint8_t) MIN(dropped, UINT8_MAX);
+    dropped = 0;
+
+    tud_hid_report(HID_REPORT_ID_VENDOR_12VRGB_EVENTS, &report, sizeof(report));
+}
+
+void events_get_config(struct Vendor12VRGBEventsConfigReport *report)
+{
+    report->mask = subscribed;
+    report->reset_cause = reset_cause;
+    report->warm_boot = warm_boot;
+}
+
+void events_set_config(const struct Vendor12VRGBEventsConfigReport *report)
+{
+    uint16_t added = (uint16_t) (report->mask & ~subscribed);
+    subscribed = report->mask;
+
+    if (added & (1u << EVENTS_RESET)) {
+        push(boot_us, EVENTS_RESET, reset_cause, warm_boot);
+    }
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert((CFG_RGB_EVENTS_SIZE & EVENTS_MASK) == 0, "event queue size must be a power of 2");
+
+static_assert(sizeof(struct Vendor12VRGBEventsEntry) == 8, "event entry size must match the report descriptor");
+
+static_assert(EVENTS_TYPE_COUNT <= 16, "too many event types for the subscription mask");
+
+#endif // CFG_RGB_EVENTS
@@ -0,0 +1,59 @@
+#ifndef COLOR_BLEND_H_
+#define COLOR_BLEND_H_
+
+#include <stdint.h>
+
+#include "color/color.h"
+
+/**
+ * Integer color blending for per-frame interpolation.
+ *
+ * On the device, blending uses the RP2040 hardware interpolators of the
+ * calling core: INTERP0 in blend mode interpolates between two values and
+ * INTERP1 in clamp mode limits the result to the 16-bit channel range. On
+ * other platforms, a software implementation produces identical results.
+ *
+ * For both implementations, blending channel values a and b computes
+ *
+ *     clamp(a + (((b - a) * alpha) >> 8), 0, 65535)
+ *
+ * where alpha is in [0, 255] and >> is an arithmetic shift.
+ */
+
+/**
+ * @brief Configures the interpolators for blending.
+ *
+ * Must be called on each core that blends colors before the first blend.
+ */
+void blend_init();
+
+/**
+ * @brief Blends two channel values, see above for details.
+ */
+uint16_t blend_channel(int32_t a, int32_t b, uint8_t alpha);
+
+/**
+ * @brief Blends each channel of two colors, see above for details.
+ */
+struct RGBu16 blend_rgb(struct RGBi32 const *a, struct RGBi32 const *b, uint8_t alpha);
+
+/**
+ * @brief The software implementation of blend_channel.
+ *
+ * This is always available so that results can be compared with the hardware
+ * implementation. Build with DEBUG_BLEND to compare them on the device when
+ * the interpolators are configured.
+ */
+static inline uint16_t blend_channel_sw(int32_t a, int32_t b, uint8_t alpha)
+{
+    int32_t v = a + (int32_t) (((int64_t) (b - a) * alpha) >> 8);
+    if (v < 0) {
+        return 0;
+    }
+    if (v > UINT16_MAX) {
+        return UINT16_MAX;
+    }
+    return (uint16_t) v;
+}
+
+#endif /* COLOR_BLEND_H_ */
@@ -24,6 +24,16 @@ struct RGBu16 {
     uint16_t b;
 };
 
+/**
+ * @brief An RGB color with integer channel values scaled so that 65535 is the
+ * maximum value. Channels may be outside [0, 65535] for out-of-gamut colors.
+ */
+struct RGBi32 {
+    int32_t r;
+    int32_t g;
+    int32_t b;
+};
+
 /**
  * @brief An RGB color with float channel values in [0.0, 1.0].
  */
@@ -36,7 +46,9 @@ struct RGB {
 struct RGB rgb_from_u8(struct RGBu8 rgb);
 struct RGBu8 rgb_to_u8(struct RGB rgb);
 struct RGBu16 rgb_to_u16(struct RGB rgb);
+struct RGBi32 rgb_to_i32(struct RGB rgb);
 struct RGB rgb_to_linear_rgb(struct RGB rgb);
+struct RGB rgb_from_linear_rgb(struct RGB rgb);
 
 /**
  * @brief An Oklab (or L*a*b*) color with float channel values.
@@ -9,28 +9,51 @@
 
 #define MAX_FADE_TARGETS 8
 
-struct AnimationFade {
-    struct Lab current_color;
+/**
+ * The number of linear segments used to approximate each fade. The fade path
+ * between each pair of targets is computed in Oklab space when the targets are
+ * set; frames then blend between the segment end points with integer math.
+ */
+#define FADE_BLEND_SEGMENTS 8
 
+/**
+ * The fade position is a fixed-point value where the integer part is the
+ * current segment and the top 8 bits of the fraction are the blend alpha.
+ */
+#define FADE_POSITION_SHIFT 16
+#define FADE_POSITION_END   ((uint32_t) FADE_BLEND_SEGMENTS << FADE_POSITION_SHIFT)
+
+struct AnimationFade {
     uint8_t target_count;
-    struct Lab targets[MAX_FADE_TARGETS];
 
     uint32_t fade_frames[MAX_FADE_TARGETS];
     uint32_t hold_frames[MAX_FADE_TARGETS];
 
-    float Ldiff;
-    float adiff;
-    float bdiff;
+    /*
+     * The segment end points of every fade, in order. Point t *
+     * FADE_BLEND_SEGMENTS is the exact color of target t, and the fade into
+     * target t runs through the points after target t - 1, wrapping around
+     * from the last target to the first.
+     */
+    struct RGBu16 path[MAX_FADE_TARGETS * FADE_BLEND_SEGMENTS];
+
+    uint8_t path_start;     /* the first point of the current fade */
+    uint32_t position;
+    uint32_t step;
 };
 
 /**
- * @brief Allocates new, empty state for a fade animation.
+ * @brief Initializes empty state for a fade animation.
  *
- * Callers must free the state when it is no longer used. The empty animation
- * has no visible output.
+ * The empty animation has no visible output.
  */
-struct AnimationFade *anim_fade_new_empty();
+void anim_fade_init_empty(struct AnimationFade *fade);
 
+/**
+ * @brief Sets the colors to fade between and computes the fade path. This
+ * uses float math, so it runs when the animation is configured rather than in
+ * the frame callback.
+ */
 void anim_fade_set_targets(struct AnimationFade *fade, struct Lab *targets, uint8_t count);
 void anim_fade_set_fade_time_us(struct AnimationFade *fade, uint8_t stage, uint32_t fade_time);
 void anim_fade_set_hold_time_us(struct AnimationFade *fade, uint8_t stage, uint32_t hold_time);
@@ -74,11 +97,9 @@ struct __attribute__ ((packed)) AnimationBreatheReportData {
 };
 
 /**
- * @brief Allocates new state for a breathing animation.
- *
- * Callers must free the state when it is no longer used.
+ * @brief Initializes state for a breathing animation.
  */
-struct AnimationFade *anim_fade_new_breathe(struct AnimationBreatheReportData *data);
+void anim_fade_init_breathe(struct AnimationFade *fade, struct AnimationBreatheReportData *data);
 
 struct __attribute__ ((packed)) AnimationFadeReportData {
     /**
@@ -100,10 +121,8 @@ struct __attribute__ ((packed)) AnimationFadeReportData {
 };
 
 /**
- * @brief Allocates new state for a color-fade animation.
- *
- * Callers must free the state when it is no longer used.
+ * @brief Initializes state for a color-fade animation.
  */
-struct AnimationFade *anim_fade_new_fade(struct AnimationFadeReportData *data);
+void anim_fade_init_fade(struct AnimationFade *fade, struct AnimationFadeReportData *data);
 
 #endif /* CONTROLLER_ANIMATIONS_FADE_H_ */
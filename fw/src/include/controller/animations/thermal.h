@@ -0,0 +1,85 @@
+#ifndef CONTROLLER_ANIMATIONS_THERMAL_H_
+#define CONTROLLER_ANIMATIONS_THERMAL_H_
+
+#include <stdint.h>
+
+#include "color/color.h"
+#include "controller/controller.h"
+#include "hid/vendor/report.h"
+
+#define MAX_THERMAL_STOPS 8
+
+/**
+ * The number of segments in the precomputed color table. The gradient is
+ * evaluated in Oklab space once when the animation is set; frames then blend
+ * between adjacent table entries using integer math.
+ */
+#define THERMAL_LUT_SEGMENTS 32
+
+/**
+ * The table position is a fixed-point value where the integer part is the
+ * table index and the top 8 bits of the fraction are the blend alpha.
+ */
+#define THERMAL_POSITION_SHIFT 16
+
+/**
+ * The smoothed temperature has this many fractional bits. With 16 bits the
+ * filter still moves for gaps far below a centidegree, and any int16_t
+ * temperature still fits in the int32_t accumulator.
+ */
+#define THERMAL_SMOOTH_SHIFT 16
+
+struct AnimationThermal {
+    struct RGBu16 lut[THERMAL_LUT_SEGMENTS + 1];
+
+    int16_t min_temperature;    /* the temperature of the first table entry */
+    int16_t max_temperature;    /* the temperature of the last table entry */
+    uint32_t lut_scale;         /* converts (temperature - min) to a table position */
+
+    uint16_t hysteresis;        /* centidegrees the smoothed value must move to change color */
+    uint32_t smooth_step;       /* per-frame filter coefficient with 16 fractional bits */
+
+    int32_t smoothed;           /* filtered temperature, see THERMAL_SMOOTH_SHIFT */
+    int16_t displayed;          /* the temperature currently shown */
+};
+
+uint8_t anim_thermal(controller_t *ctrl, uint8_t lamp_id, struct AnimationState *state);
+
+// --------------------------------------
+// Constructors and data specific effects
+// --------------------------------------
+
+struct __attribute__ ((packed)) AnimationThermalStop {
+    int16_t temperature;    /* centidegrees celsius */
+    struct RGBu8 color;
+};
+
+struct __attribute__ ((packed)) AnimationThermalReportData {
+    /**
+     * The gradient stops, in increasing temperature order. The first
+     * `stop_count` elements of `stops` should be set. Temperatures below the
+     * first stop or above the last stop use the color of that stop.
+     */
+    uint8_t stop_count;
+    struct AnimationThermalStop stops[MAX_THERMAL_STOPS];
+
+    /**
+     * The change in temperature needed to change the color, in centidegrees.
+     * This keeps the color steady when the temperature is near a boundary.
+     */
+    uint16_t hysteresis;
+
+    /**
+     * The time constant of the low-pass filter applied to the temperature, in
+     * milliseconds. After this time, the displayed temperature has moved 63% of
+     * the way to a new steady value.
+     */
+    uint16_t smoothing_ms;
+};
+
+/**
+ * @brief Initializes state for a temperature gradient animation.
+ */
+void anim_thermal_init(struct AnimationThermal *thermal, struct AnimationThermalReportData *data);
+
+#endif /* CONTROLLER_ANIMATIONS_THERMAL_H_ */
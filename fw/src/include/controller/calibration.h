@@ -0,0 +1,85 @@
+#ifndef CONTROLLER_CALIBRATION_H_
+#define CONTROLLER_CALIBRATION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "device/lamp.h"
+#include "device/specs.h"
+
+/**
+ * The number of points in each calibration curve. The points are evenly
+ * spaced over the 16-bit input range, 2^CALIBRATION_SEGMENT_BITS apart, and
+ * the output is interpolated linearly between them.
+ */
+#define CALIBRATION_POINTS          17
+#define CALIBRATION_SEGMENT_BITS    12
+
+/**
+ * The number of color channels calibrated for each lamp (red, green, blue).
+ */
+#define CALIBRATION_CHANNELS        3
+
+/**
+ * The number of 8-bit sRGB levels in each calibration table. Tables have one
+ * more entry, a copy of the last level, so interpolating from the last level
+ * never reads past the end.
+ */
+#define CALIBRATION_TABLE_SIZE      256
+
+/**
+ * CalibrationCurve maps linear light output to PWM duty for one channel of
+ * one lamp. This is also the format of calibration records in flash.
+ */
+struct CalibrationCurve {
+    uint16_t points[CALIBRATION_POINTS];    /* the output for input i << CALIBRATION_SEGMENT_BITS */
+};
+
+/**
+ * @brief Loads saved calibration curves into RAM. Lamps without a saved curve
+ * use the identity curve.
+ *
+ * Call this after ctrl_persist_init.
+ */
+void ctrl_calibration_init();
+
+/**
+ * @brief Returns the PWM duty for a lamp value. Each channel is interpolated
+ * between the two entries of the channel's table around it, which combine
+ * sRGB decoding with the channel's curve, so the full 16-bit precision of
+ * the lamp value reaches the PWM.
+ */
+struct LampValue ctrl_calibration_apply(uint8_t lamp_id, struct LampValue value);
+
+const struct CalibrationCurve *ctrl_calibration_get(uint8_t lamp_id, uint8_t channel);
+
+/**
+ * @brief Sets the curve used for a channel until the next reset and rebuilds
+ * its table. The caller must call ctrl_refresh_lamps for the change to be
+ * visible.
+ */
+void ctrl_calibration_set(uint8_t lamp_id, uint8_t channel, const struct CalibrationCurve *curve);
+
+/**
+ * @brief Queues the current curve for a channel to be saved to flash.
+ *
+ * @returns false if the persistence queue is full
+ */
+bool ctrl_calibration_save(uint8_t lamp_id, uint8_t channel);
+
+/**
+ * @brief Restores the identity curve for a channel and queues removal of its
+ * saved curve. The caller must call ctrl_refresh_lamps for the change to be
+ * visible.
+ *
+ * @returns false if the persistence queue is full
+ */
+bool ctrl_calibration_reset(uint8_t lamp_id, uint8_t channel);
+
+/**
+ * @brief Selects the channel returned by the calibration feature report.
+ */
+void ctrl_calibration_select(uint8_t lamp_id, uint8_t channel);
+void ctrl_calibration_get_selected(uint8_t *lamp_id, uint8_t *channel);
+
+#endif // CONTROLLER_CALIBRATION_H_
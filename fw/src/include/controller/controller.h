@@ -5,6 +5,7 @@
 
 #include "pico/time.h"
 
+#include "controller/power.h"
 #include "device/lamp.h"
 #include "device/specs.h"
 #include "hid/lights/report.h"
@@ -20,20 +21,44 @@ typedef struct {
     struct LampValue current;
     struct LampValue next;
     bool dirty;
+    struct LampValue output;    /* the duty last written to the outputs, after calibration and dimming */
 } lamp_state;
 
+/**
+ * The lamp state saved to flash when CFG_RGB_PERSIST_LAMP_STATE is enabled.
+ */
+struct LampStateCheckpoint {
+    bool is_autonomous;
+    struct LampValue values[LAMP_COUNT];
+};
+
 // ---------
 // Animation
 // ---------
 
 #define ANIM_FRAME_TIME_US (1000000 / CFG_RGB_ANIMATION_FRAME_RATE)
 
+/**
+ * The maximum number of frames to run at once to catch up after the main loop
+ * was blocked. Longer gaps restart the frame timing instead.
+ */
+#define ANIM_MAX_CATCHUP_FRAMES CFG_RGB_ANIMATION_FRAME_RATE
+
+/**
+ * The size in bytes of the data block reserved for each lamp's animation. Every
+ * animation type asserts at compile time that its data fits in this block.
+ */
+#define ANIM_DATA_SIZE  512
+#define ANIM_DATA_ALIGN 8
+
 struct AnimationState {
+    uint8_t  type;          /* the ANIMATION_TYPE_* value the animation was created from */
     uint8_t  stage;         /* the current stage of the animation, as set by the frame callback */
     uint32_t frame;         /* the current frame in the full animation */
     uint32_t stage_frame;   /* the current frame in the current stage; resets to 0 on stage change */
 
-    void *data;             /* arbitrary data used by the frame callback */
+    /* data used by the frame callback, interpreted according to the animation type */
+    uint8_t data[ANIM_DATA_SIZE] __attribute__ ((aligned(ANIM_DATA_ALIGN)));
 };
 
 typedef uint8_t (*FrameCallback)(controller_t *ctrl, uint8_t lamp_id, struct AnimationState *state);
@@ -48,11 +73,21 @@ struct Controller {
     uint8_t next_lamp_id;
 
     bool do_update;
+    bool refresh_lamps;         /* set all lamps again, e.g. after calibration changes */
     lamp_state lamp_state[LAMP_COUNT];
 
+    struct PowerGovernor power;
+    absolute_time_t last_power_update;
+
     struct AnimationState animation[LAMP_COUNT];
     FrameCallback frame_cb[LAMP_COUNT];
     absolute_time_t last_frame;
+    uint32_t missed_frames;     /* frames that ran late because the main loop was blocked */
+
+    bool checkpoint_dirty;
+    absolute_time_t last_checkpoint;
+
+    uint32_t first_light_us;    /* the time from reset to the first visible lamp update */
 };
 
 void ctrl_init(controller_t *ctrl);
@@ -64,23 +99,46 @@ void ctrl_resume(controller_t *ctrl);
 void ctrl_set_next_lamp_attributes_id(controller_t *ctrl, uint8_t lamp_id);
 void ctrl_get_lamp_attributes(controller_t *ctrl, struct LampAttributesResponseReport *report);
 
+/**
+ * @brief Fills a snapshot of the lamp, animation, and mode state, along with
+ * the defaults saved to flash.
+ */
+void ctrl_get_status(controller_t *ctrl, struct Vendor12VRGBStatusReport *report);
+
 void ctrl_update_lamp(controller_t *ctrl, uint8_t lamp_id, struct LampValue value, bool apply);
 void ctrl_apply_lamp_updates(controller_t *ctrl);
 
+/**
+ * @brief Sets every lamp again on the next task, even if its value did not
+ * change. Call this when the mapping from lamp values to PWM duty changes.
+ */
+void ctrl_refresh_lamps(controller_t *ctrl);
+
 void ctrl_set_autonomous_mode(controller_t *ctrl, bool autonomous);
 bool ctrl_get_autonomous_mode(controller_t *ctrl);
 
+/**
+ * @brief Restores the lamp state saved by the last checkpoint, if any.
+ *
+ * If the device was in host mode, this sets the saved lamp colors and leaves
+ * autonomous mode. The next ctrl_task writes the colors to the outputs through
+ * calibration and dimming.
+ *
+ * @returns true if a checkpoint was restored
+ */
+bool ctrl_restore_checkpoint(controller_t *ctrl);
+
 /**
  * @brief Sets the animation that plays in autonomous mode.
  *
- * When starting an animation, the controller takes full ownership of the
- * animation data. If the controller has an existing animation with non-null
- * data, setting a new animation automatically frees the existing animation
- * state. As a result, data must be allocated dynamically.
+ * Each lamp has a statically allocated data block of ANIM_DATA_SIZE bytes for
+ * animation state. Setting an animation replaces any existing animation and
+ * returns the lamp's data block, cleared to zero, for the caller to
+ * initialize before the next frame.
  *
- * Set a null frame callback and null data to disable animations.
+ * Set a null frame callback to disable animations.
  */
-void ctrl_set_animation(controller_t *ctrl, uint8_t lamp_id, FrameCallback frame_cb, void *data);
+void *ctrl_set_animation(controller_t *ctrl, uint8_t lamp_id, FrameCallback frame_cb);
 
 /**
  * @brief Sets the animation that plays in autonomous mode from a report.
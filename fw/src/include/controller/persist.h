@@ -1,44 +1,170 @@
 #ifndef CONTROLLER_PERSIST_H_
 #define CONTROLLER_PERSIST_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "hardware/flash.h"
 
+#include "controller/calibration.h"
+#include "controller/scene.h"
+#include "device/specs.h"
 #include "hid/vendor/report.h"
 
-// TODO(bkeyes): consider using the availabe 4 bits of the marker to store type
-// information about the record, e.g. animation report or something else. The
-// would provide a place to store non-animation data, like sleep behavior. On
-// the other hand, as long as 0x0 is the marker for "animation record", this
-// would be easy to add later on if needed
-#define PERSIST_REPORT_MARKER       0x01ed
-#define PERSIST_REPORT_MARKER_BYTES 2
-
-#define PERSIST_REPORTS_PER_PAGE    4
-#define PERSIST_REPORT_SLOT_SIZE    (FLASH_PAGE_SIZE / PERSIST_REPORTS_PER_PAGE)
+/**
+ * The number of flash sectors used for persistence. Records are written as a
+ * log that rotates through the sectors, which spreads erase cycles across all
+ * of them. One sector is always kept erased as a spare so that live records
+ * can be copied out of the oldest sector before it is erased.
+ */
+#define PERSIST_SECTOR_COUNT        4
 
-#define PERSIST_FLASH_SIZE          (FLASH_SECTOR_SIZE)
+#define PERSIST_FLASH_SIZE          (PERSIST_SECTOR_COUNT * FLASH_SECTOR_SIZE)
 #define PERSIST_FLASH_OFFSET        (PICO_FLASH_SIZE_BYTES - PERSIST_FLASH_SIZE)
 
 #define PERSIST_ADDR(offset)        ((void *) (XIP_BASE + PERSIST_FLASH_OFFSET + (offset)))
 #define PERSIST_OFFSET(addr)        (((uint32_t) (addr)) - XIP_BASE - PERSIST_FLASH_OFFSET)
 
+/**
+ * The marker value at the start of each record ("led").
+ */
+#define PERSIST_RECORD_MARKER       0x01ed
+
+/**
+ * Records start on multiples of this many bytes.
+ */
+#define PERSIST_RECORD_ALIGN        8
+
+/**
+ * The types of records that can be stored. Each type has a fixed number of
+ * keys, which are used as indices into the RAM index.
+ */
+enum PersistRecordType {
+    PERSIST_RECORD_ANIMATION = 0x00,    /* key: lamp ID */
+    PERSIST_RECORD_LAMP_STATE = 0x01,   /* key: 0 */
+    PERSIST_RECORD_SCENE_LAMP = 0x02,   /* key: scene ID * LAMP_COUNT + lamp ID */
+    PERSIST_RECORD_SCENE_NAME = 0x03,   /* key: scene ID */
+    PERSIST_RECORD_SCENE_RULES = 0x04,  /* key: 0 */
+    PERSIST_RECORD_CALIBRATION = 0x05,  /* key: lamp ID * CALIBRATION_CHANNELS + channel */
+
+    PERSIST_RECORD_TYPE_COUNT,
+};
+
+#define PERSIST_ANIMATION_KEYS      LAMP_COUNT
+#define PERSIST_LAMP_STATE_KEYS     1
+#define PERSIST_SCENE_LAMP_KEYS     (SCENE_COUNT * LAMP_COUNT)
+#define PERSIST_SCENE_NAME_KEYS     SCENE_COUNT
+#define PERSIST_SCENE_RULES_KEYS    1
+#define PERSIST_CALIBRATION_KEYS    (LAMP_COUNT * CALIBRATION_CHANNELS)
+
+/**
+ * The number of records that can wait to be written to flash and the maximum
+ * data size of each queued record.
+ */
+#define PERSIST_QUEUE_LENGTH        8
+#define PERSIST_QUEUE_DATA_SIZE     64
+
+/**
+ * The minimum time between flash operations performed by ctrl_persist_task.
+ *
+ * Units: Microseconds
+ */
+#define PERSIST_STEP_INTERVAL_US    10000
+
+/**
+ * The time the write queue must stay empty before ctrl_persist_task erases a
+ * reclaimed sector. A 4 KB sector is the smallest unit the flash can erase,
+ * and erasing one blocks the main loop and interrupts for about 45 ms, so the
+ * erase waits until a burst of saves has been written.
+ *
+ * Units: Microseconds
+ */
+#define PERSIST_ERASE_DELAY_US      500000
+
+/**
+ * The state of queued flash operations.
+ */
+struct PersistStatus {
+    uint8_t pending_writes;     /* the number of records waiting to be written */
+    uint8_t pending_erases;     /* the number of sectors waiting to be erased */
+    uint16_t failed_writes;     /* the number of records that were dropped */
+    uint16_t completed_writes;  /* the number of records written since startup */
+};
+
+/**
+ * Statistics about flash operations. Interrupts are disabled and code cannot
+ * execute from flash while flash is programmed or erased, so the main loop
+ * stalls for the duration of each operation.
+ */
+struct PersistStats {
+    uint32_t flash_ops;         /* the number of erase and program operations */
+    uint32_t stall_us_total;    /* the total time spent in flash operations */
+    uint32_t stall_us_max;      /* the longest single flash operation */
+
+    /* the lifetime number of erase cycles for each sector */
+    uint32_t sector_erases[PERSIST_SECTOR_COUNT];
+};
+
 /**
  * @brief Initializes persistent flash storage.
  *
- * This checks the content of flash and will perform an erase if the relevant
- * sector is not empty and does not contain valid data.
+ * This scans all sectors once to build the RAM index of records. Sectors that
+ * do not contain valid data are erased.
  */
 void ctrl_persist_init();
 
 /**
  * @brief Clears any existing saved settings in flash storage.
+ *
+ * This discards queued records and erases flash immediately.
  */
 void ctrl_persist_clear();
 
 /**
- * @brief Writes the given report to persistent flash storage.
+ * @brief Queues a record to be written to persistent flash storage by
+ * ctrl_persist_task. This copies the data and never accesses flash. A length
+ * of 0 removes the record.
+ *
+ * @returns false if the type or key is invalid, the data is too large, or the
+ *          queue is full
+ */
+bool ctrl_persist_save_async(uint8_t type, uint8_t key, const void *data, uint16_t length);
+
+/**
+ * @brief Returns the number of records that can be queued before the queue is
+ * full. Callers that queue several related records check this first, so that
+ * either all of them are queued or none are.
+ */
+uint8_t ctrl_persist_queue_space();
+
+/**
+ * @brief Performs at most one pending flash operation.
+ *
+ * This should be called from the main loop. Each call blocks for the duration
+ * of a single program or erase operation.
+ */
+void ctrl_persist_task();
+
+/**
+ * @brief Returns the state of queued flash operations.
+ */
+void ctrl_persist_get_status(struct PersistStatus *status);
+
+/**
+ * @brief Finds the saved record with the given type and key.
+ *
+ * @param length if not NULL, set to the length of the record data
+ *
+ * @returns A pointer to the record data in flash or NULL if no record exists.
+ */
+const void *ctrl_persist_find(uint8_t type, uint8_t key, uint16_t *length);
+
+/**
+ * @brief Queues the given report to be written to persistent flash storage.
+ *
+ * @returns false if the lamp ID is invalid or the queue is full
  */
-void ctrl_persist_save_report(struct Vendor12VRGBAnimationReport *report);
+bool ctrl_persist_save_report(struct Vendor12VRGBAnimationReport *report);
 
 /**
  * @brief Finds the most recent saved report for the lamp ID.
@@ -47,6 +173,11 @@ void ctrl_persist_save_report(struct Vendor12VRGBAnimationReport *report);
  */
 struct Vendor12VRGBAnimationReport *ctrl_persist_find_report(uint8_t lamp_id);
 
+/**
+ * @brief Returns statistics about flash operations since startup.
+ */
+void ctrl_persist_get_stats(struct PersistStats *stats);
+
 /**
  * @brief Dumps the content of the persistent flash storage to stdout for debugging.
  */
@@ -0,0 +1,62 @@
+#ifndef CONTROLLER_POWER_H_
+#define CONTROLLER_POWER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "device/lamp.h"
+#include "device/specs.h"
+#include "hid/vendor/report.h"
+
+/**
+ * How often to update the budget from the temperature when the lamp colors
+ * are not changing.
+ *
+ * Units: Microseconds
+ */
+#define POWER_DERATE_INTERVAL_US 100000
+
+/**
+ * The scale applied to lamp colors when they are not dimmed. Scales have 16
+ * fractional bits.
+ */
+#define POWER_SCALE_ONE (1u << 16)
+
+/**
+ * PowerGovernor estimates the load of the lamps from the colors committed to
+ * the PWM outputs and dims all lamps by the same factor to keep the total load
+ * within a budget. The budget is lowered as the temperature rises.
+ *
+ * With CFG_RGB_TEMP_COMPENSATION, each channel also has a gain for the current
+ * temperature. The gains and the dimming are combined into one scale per
+ * channel, so committing a lamp costs the same with or without compensation.
+ */
+struct PowerGovernor {
+    uint32_t lamp_load[LAMP_COUNT]; /* estimated load of each lamp before dimming, in mW */
+    uint32_t requested_load;        /* sum of lamp_load, in mW */
+    uint32_t budget;                /* in mW, or 0 if unlimited */
+    uint32_t scale;                 /* applied to all lamp colors; POWER_SCALE_ONE is full brightness */
+    uint32_t channel_gain[3];       /* temperature compensation for (R, G, B) */
+    uint32_t channel_scale[3];      /* scale * channel_gain, applied to each channel */
+};
+
+void ctrl_power_init(struct PowerGovernor *power);
+
+/**
+ * @brief Updates the load estimate, budget, and compensation gains for the
+ * given lamp values and temperature.
+ *
+ * @param values the lamp values before dimming
+ * @param temperature the current temperature in centidegrees Celsius
+ * @returns true if any channel scale changed and all lamps must be set again
+ */
+bool ctrl_power_update(struct PowerGovernor *power, const struct LampValue *values, int16_t temperature);
+
+/**
+ * @brief Returns the value to set on the PWM outputs for a lamp value.
+ */
+struct LampValue ctrl_power_apply(const struct PowerGovernor *power, struct LampValue value);
+
+void ctrl_power_get_report(const struct PowerGovernor *power, struct Vendor12VRGBPowerReport *report);
+
+#endif // CONTROLLER_POWER_H_
@@ -0,0 +1,165 @@
+#ifndef CONTROLLER_SCENE_H_
+#define CONTROLLER_SCENE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/time.h"
+
+#include "controller/controller.h"
+
+/**
+ * The number of scenes that can be saved. Each scene sets an animation for
+ * any number of lamps.
+ */
+#define SCENE_COUNT         8
+
+/**
+ * The maximum length of a scene name. Names are not null-terminated if they
+ * use all of the available space.
+ */
+#define SCENE_NAME_SIZE     16
+
+/**
+ * The scene ID used in rules for events that do not change the scene.
+ */
+#define SCENE_NONE          0xFF
+
+/**
+ * How often to check temperature thresholds.
+ *
+ * Units: Microseconds
+ */
+#define SCENE_TEMPERATURE_INTERVAL_US 1000000
+
+/**
+ * Device events that can switch scenes.
+ */
+enum SceneEvent {
+    SCENE_EVENT_SUSPEND             = 0x00, /* the host suspended the device */
+    SCENE_EVENT_RESUME              = 0x01, /* the host resumed the device */
+    SCENE_EVENT_TEMPERATURE_HIGH    = 0x02, /* the temperature reached the high threshold */
+    SCENE_EVENT_TEMPERATURE_NORMAL  = 0x03, /* the temperature fell to the normal threshold */
+    SCENE_EVENT_HOST_UPDATE         = 0x04, /* the host set lamp colors for the first time */
+    SCENE_EVENT_DISCONNECT          = 0x05, /* the device was disconnected from the host */
+
+    SCENE_EVENT_COUNT,
+};
+
+/**
+ * The rule table mapping events to scenes.
+ */
+struct SceneRules {
+    uint8_t scenes[SCENE_EVENT_COUNT];  /* the scene for each event, or SCENE_NONE */
+
+    /* temperature thresholds in centidegrees celsius; the high event fires
+       when the temperature reaches temperature_high and the normal event fires
+       when it falls back to temperature_normal */
+    int16_t temperature_high;
+    int16_t temperature_normal;
+};
+
+struct SceneController {
+    struct SceneRules rules;
+    uint8_t active_scene;
+    uint8_t selected_scene;     /* the scene returned by the scene feature report */
+
+    bool is_temperature_high;
+    bool has_host_update;
+    absolute_time_t last_temperature_check;
+};
+typedef struct SceneController scene_controller_t;
+
+/**
+ * @brief Initializes scenes and loads the saved rule table.
+ *
+ * Call this after ctrl_persist_init.
+ */
+void ctrl_scene_init(scene_controller_t *scenectrl);
+
+/**
+ * @brief Checks temperature thresholds and switches scenes if needed.
+ */
+void ctrl_scene_task(scene_controller_t *scenectrl, controller_t *ctrl);
+
+/**
+ * @brief Switches to the scene for an event, if the rule table has one.
+ *
+ * Disconnect and suspend events also enter autonomous mode, since the host is
+ * no longer controlling the lamps.
+ *
+ * @returns true if the event switched scenes
+ */
+bool ctrl_scene_handle_event(scene_controller_t *scenectrl, controller_t *ctrl, enum SceneEvent event);
+
+/**
+ * @brief Records a host lamp update, sending the host update event if this is
+ * the first update since the device connected or resumed.
+ */
+void ctrl_scene_handle_host_update(scene_controller_t *scenectrl, controller_t *ctrl);
+
+/**
+ * @brief Switches to a scene by setting the saved animation for each lamp.
+ * Lamps without a saved animation in the scene are not changed.
+ *
+ * @returns false if the scene ID is invalid
+ */
+bool ctrl_scene_activate(scene_controller_t *scenectrl, controller_t *ctrl, uint8_t scene_id);
+
+uint8_t ctrl_scene_get_active(scene_controller_t *scenectrl);
+
+/**
+ * @brief Sets the scene whose name and flags are returned to the host.
+ */
+void ctrl_scene_select(scene_controller_t *scenectrl, uint8_t scene_id);
+uint8_t ctrl_scene_get_selected(scene_controller_t *scenectrl);
+
+/**
+ * @brief Returns true if the scene has a saved name or any saved animations.
+ */
+bool ctrl_scene_exists(uint8_t scene_id);
+
+/**
+ * @brief Returns the saved name of a scene, or NULL if it has no name.
+ */
+const char *ctrl_scene_get_name(uint8_t scene_id);
+
+/**
+ * @brief Queues writes to save a lamp's animation in a scene.
+ *
+ * @returns false if the scene or lamp ID is invalid or the write queue is full
+ */
+bool ctrl_scene_save_lamp(uint8_t scene_id, struct Vendor12VRGBAnimationReport *report);
+
+/**
+ * @brief Queues writes to save the name of a scene.
+ *
+ * @returns false if the scene ID is invalid or the write queue is full
+ */
+bool ctrl_scene_save_name(uint8_t scene_id, const char *name);
+
+/**
+ * @brief Queues writes to remove a scene's name and animations. Nothing is
+ * queued unless the queue has room for all of them.
+ *
+ * @returns false if the scene ID is invalid or the write queue is too full
+ */
+bool ctrl_scene_delete(scene_controller_t *scenectrl, uint8_t scene_id);
+
+void ctrl_scene_get_rules(scene_controller_t *scenectrl, struct SceneRules *rules);
+
+/**
+ * @brief Returns true if every rule names a valid scene and, if a temperature
+ * event has a scene, the normal threshold is below the high threshold.
+ */
+bool ctrl_scene_rules_valid(const struct SceneRules *rules);
+
+/**
+ * @brief Replaces the rule table and queues writes to save it.
+ *
+ * @returns false if the rules are invalid or the write queue is full, in
+ * which case the rules are not changed
+ */
+bool ctrl_scene_set_rules(scene_controller_t *scenectrl, const struct SceneRules *rules);
+
+#endif /* CONTROLLER_SCENE_H_ */
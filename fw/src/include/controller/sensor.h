@@ -7,13 +7,56 @@
 
 #include "hid/sensor/report.h"
 #include "hid/sensor/usage.h"
+#include "hid/vendor/report.h"
+
+/**
+ * The number of samples buffered for batch reports. This allows several
+ * reports worth of samples to queue up if the host is slow to read them.
+ */
+#define SENSOR_BATCH_BUFFER_SIZE 64
+
+/**
+ * Limits for the batch configuration. Samples are taken from the filtered
+ * temperature, which updates every 10 ms. Sample offsets in batch reports are
+ * 16-bit unsigned values, so the samples in a full report must span less than
+ * 65.535 s; the maximum interval leaves room for the sampling jitter of the
+ * main loop.
+ *
+ * Units: Milliseconds
+ */
+#define SENSOR_BATCH_MIN_INTERVAL_MS    10
+#define SENSOR_BATCH_MAX_INTERVAL_MS    5000
+#define SENSOR_BATCH_MAX_LATENCY_MS     30000
+
+struct SensorSample {
+    uint32_t timestamp_ms;
+    int16_t temperature;
+};
+
+struct SensorBatch {
+    uint8_t size;                   /* samples per report, or 0 if disabled */
+    uint16_t sample_interval_ms;
+    uint16_t max_latency_ms;
+
+    struct SensorSample samples[SENSOR_BATCH_BUFFER_SIZE];
+    uint8_t head;
+    uint8_t count;
+    uint8_t dropped;
+
+    absolute_time_t last_sample;
+};
 
 struct SensorController {
     enum SensorReportingState reporting_state;
     enum SensorPowerState power_state;
     uint32_t report_interval;
+    uint16_t change_sensitivity_abs;
+    uint16_t change_sensitivity_rel_pct;
 
     absolute_time_t last_report;
+    int16_t last_report_temperature;
+
+    struct SensorBatch batch;
 };
 typedef struct SensorController sensor_controller_t;
 
@@ -27,4 +70,24 @@ void ctrl_sensor_set_reporting_state(sensor_controller_t *ctrl, enum SensorRepor
 void ctrl_sensor_set_power_state(sensor_controller_t *ctrl, enum SensorPowerState state);
 void ctrl_sensor_set_report_interval(sensor_controller_t *ctrl, uint32_t interval);
 
+/**
+ * @brief Sets the change in temperature required to send a new input report.
+ *
+ * @param absolute the absolute change in centidegrees, or 0 to disable
+ * @param rel_pct the change relative to the last report in hundredths of a
+ *        percent, or 0 to disable
+ */
+void ctrl_sensor_set_change_sensitivity(sensor_controller_t *ctrl, uint16_t absolute, uint16_t rel_pct);
+
+/**
+ * @brief Configures batched temperature samples, which are sent in vendor
+ * input reports independently of the sensor reporting state. Setting the
+ * batch size to 0 disables batching and discards buffered samples.
+ *
+ * A batch is sent when `size` samples are buffered or the oldest buffered
+ * sample is `max_latency_ms` old.
+ */
+void ctrl_sensor_set_batch_config(sensor_controller_t *ctrl, uint8_t size, uint16_t sample_interval_ms, uint16_t max_latency_ms);
+void ctrl_sensor_get_batch_config(sensor_controller_t *ctrl, struct Vendor12VRGBSensorBatchConfigReport *report);
+
 #endif /* CONTROLLER_SENSOR_H_ */
@@ -0,0 +1,72 @@
+#ifndef CONTROLLER_WARMBOOT_H_
+#define CONTROLLER_WARMBOOT_H_
+
+#include <stdbool.h>
+
+#include "controller/controller.h"
+#include "controller/sensor.h"
+
+/**
+ * The watchdog scratch registers used to validate snapshots. The Pico SDK uses
+ * scratch registers 4 to 7 for its own reboot handling.
+ */
+#define WARMBOOT_SCRATCH_MAGIC      0
+#define WARMBOOT_SCRATCH_SELECT     1
+#define WARMBOOT_SCRATCH_RESUMES    2
+
+/**
+ * The number of consecutive warm boots allowed before starting from scratch.
+ * This prevents a reboot loop if the saved state causes a crash.
+ */
+#define WARMBOOT_MAX_RESUMES        3
+
+/**
+ * The time after a warm boot after which the firmware is considered stable and
+ * the resume count is cleared.
+ *
+ * Units: Microseconds
+ */
+#define WARMBOOT_STABLE_TIME_US     10000000
+
+/**
+ * @brief Initializes warm boot support and starts the hardware watchdog if
+ * CFG_RGB_WATCHDOG_TIMEOUT is set.
+ */
+void ctrl_warmboot_init();
+
+/**
+ * @brief Restores the controller state saved before the last reboot.
+ *
+ * This only succeeds after a software or watchdog reset, when RAM contents are
+ * preserved. The lamps are set to their saved values immediately and
+ * animations continue from the saved frame.
+ *
+ * Call this after ctrl_init and ctrl_sensor_init.
+ *
+ * @returns true if the state was restored
+ */
+bool ctrl_warmboot_restore(controller_t *ctrl, sensor_controller_t *sensectrl);
+
+/**
+ * @brief Saves the controller state once per animation frame and feeds the
+ * hardware watchdog.
+ */
+void ctrl_warmboot_task(controller_t *ctrl, sensor_controller_t *sensectrl);
+
+/**
+ * @brief Saves the controller state immediately, e.g. before a reboot.
+ */
+void ctrl_warmboot_save(controller_t *ctrl, sensor_controller_t *sensectrl);
+
+/**
+ * @brief Discards any saved state so that the next boot starts from scratch.
+ */
+void ctrl_warmboot_invalidate();
+
+/**
+ * @brief Pauses or restarts the hardware watchdog. The watchdog is paused
+ * while the device is suspended because the main loop waits for USB events.
+ */
+void ctrl_warmboot_pause_watchdog(bool pause);
+
+#endif /* CONTROLLER_WARMBOOT_H_ */
@@ -9,7 +9,9 @@
 #define MAX_LAMP_ID (LAMP_COUNT - 1)
 
 /**
- * LampValue is a value that can be set on a lamp.
+ * LampValue is a value that can be set on a lamp. Values set by the host and
+ * animations have sRGB-encoded channels scaled so that 65535 is full output;
+ * calibration turns them into the PWM duty passed to lamp_set_value.
  */
 struct LampValue {
     uint16_t r;
@@ -23,11 +25,30 @@ extern const uint16_t lamp_purposes[LAMP_COUNT];
 extern const uint8_t  lamp_gpios[LAMP_COUNT][3];
 
 void lamp_init();
+
+/**
+ * @brief Recalculates the lamp output clock dividers after the system clock
+ * changes.
+ */
+void lamp_update_clock();
 void lamp_set_value(uint8_t lamp_id, struct LampValue value);
 
-static inline struct LampValue lamp_value_from_linear_rgb(struct RGB rgb)
+/**
+ * @brief Returns how far the output of a lamp is through its current period,
+ * from 0 at the start to 65535 at the end.
+ */
+uint16_t lamp_get_phase(uint8_t lamp_id);
+
+/**
+ * @brief Returns the time until a value set now with lamp_set_value is
+ * visible on a lamp.
+ *
+ * Units: Microseconds
+ */
+uint32_t lamp_get_update_delay_us(uint8_t lamp_id);
+
+static inline struct LampValue lamp_value_from_rgb_u16(struct RGBu16 u16)
 {
-    struct RGBu16 u16 = rgb_to_u16(rgb);
     struct LampValue value = {
         .r = u16.r,
         .g = u16.g,
@@ -39,11 +60,12 @@ static inline struct LampValue lamp_value_from_linear_rgb(struct RGB rgb)
 
 static inline struct LampValue lamp_value_from_u8_tuple(uint8_t const *rgbi)
 {
-    // squaring values is a simple approximation for gamma correction
+    // Scale to the full range so 255 is full output; calibration applies the
+    // gamma
     struct LampValue value = {
-        .r = (uint16_t) (rgbi[0] * rgbi[0]),
-        .g = (uint16_t) (rgbi[1] * rgbi[1]),
-        .b = (uint16_t) (rgbi[2] * rgbi[2]),
+        .r = (uint16_t) (rgbi[0] * 257),
+        .g = (uint16_t) (rgbi[1] * 257),
+        .b = (uint16_t) (rgbi[2] * 257),
         .i = rgbi[3],
     };
     return value;
@@ -17,10 +17,19 @@
 #include "config.h"
 
 /**
- * The number of independently addressable lamps (channels) in the system.
+ * The number of independently addressable lamps (channels) in the system. The
+ * PIO lamp backend can drive up to 10 lamps from GPIOs 0-29; the lamp lists in
+ * config.h must have one entry per lamp.
  */
 #define LAMP_COUNT 4
 
+/**
+ * The hardware used to drive the lamp outputs, selected by
+ * CFG_RGB_LAMP_BACKEND.
+ */
+#define LAMP_BACKEND_PWM 0
+#define LAMP_BACKEND_PIO 1
+
 /**
  * The number of levels the for red, green, and blue color channels of each lamp.
  */
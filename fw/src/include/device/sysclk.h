@@ -0,0 +1,43 @@
+#ifndef DEVICE_SYSCLK_H_
+#define DEVICE_SYSCLK_H_
+
+#include <stdint.h>
+
+/**
+ * The system clock frequencies used by the clock modes.
+ *
+ * Units: Hertz
+ */
+#define SYSCLK_FULL_HZ      125000000
+#define SYSCLK_REDUCED_HZ   48000000
+
+enum SysclkMode {
+    SYSCLK_MODE_FULL,       /* host updates; 125 MHz from the system PLL */
+    SYSCLK_MODE_REDUCED,    /* autonomous animations; 48 MHz from the USB PLL */
+    SYSCLK_MODE_SLEEP,      /* suspended with the lamps off; reduced, and the ADC clock is stopped */
+
+    SYSCLK_MODE_COUNT,
+};
+
+/**
+ * @brief Moves the peripheral clock off the system clock and stops unused
+ * clocks. Call this before any peripherals are initialized.
+ */
+void sysclk_init();
+
+/**
+ * @brief Switches the system clock to the frequency for a mode and adjusts the
+ * lamp output dividers to match. Does nothing if CFG_RGB_CLOCK_SCALING is
+ * disabled or the mode is already set.
+ */
+void sysclk_set_mode(enum SysclkMode mode);
+
+enum SysclkMode sysclk_get_mode();
+
+/**
+ * @brief Returns the total time spent in a mode since startup, including the
+ * time in the current mode.
+ */
+uint64_t sysclk_get_residency_us(enum SysclkMode mode);
+
+#endif /* DEVICE_SYSCLK_H_ */
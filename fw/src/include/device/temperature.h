@@ -1,11 +1,31 @@
 #ifndef DEVICE_TEMPERATURE_H_
 #define DEVICE_TEMPERATURE_H_
 
+#include <stdint.h>
+
+/**
+ * @brief Starts sampling the internal temperature sensor in the background.
+ */
 void temperature_init();
 
+/**
+ * @brief Updates the filtered temperature from the latest samples. Call this
+ * from the main loop.
+ */
+void temperature_task();
+
 /**
  * @brief Returns the current internal temperature in centidegrees celsius.
+ *
+ * This returns a cached value and is safe to call from USB callbacks.
  */
 int16_t temperature_read();
 
+/**
+ * @brief Returns the lowest and highest temperatures since startup in
+ * centidegrees celsius.
+ */
+int16_t temperature_read_min();
+int16_t temperature_read_max();
+
 #endif /* DEVICE_TEMPERATURE_H_ */
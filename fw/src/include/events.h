@@ -0,0 +1,81 @@
+/**
+ * A stream of device events for the host, so host software can react to
+ * changes on the device instead of polling for them. The host selects the
+ * event types it wants with the events feature report, and the main loop
+ * sends queued events in the events input report. All events are posted
+ * through EVENTS_POST, which compiles to nothing when CFG_RGB_EVENTS is 0.
+ */
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "device/specs.h"
+#include "hid/vendor/report.h"
+
+/**
+ * Event types. Each type is one bit of the subscription mask. The CLI decodes
+ * events by type, so only add types at the end.
+ */
+enum EventsType {
+    EVENTS_RESET,               /* arg8: EventsResetCause, arg16: 1 after a warm boot */
+    EVENTS_ANIMATION_STAGE,     /* arg8: lamp ID, arg16: the new stage */
+    EVENTS_SCENE,               /* arg8: scene ID, arg16: the SceneEvent that switched it, or EVENTS_SCENE_BY_HOST */
+    EVENTS_THROTTLE,            /* arg8: 1 when dimming to the power budget starts, 0 when it stops, arg16: scale */
+    EVENTS_PERSIST,             /* arg8: 1 if the write failed, arg16: record type << 8 | key */
+
+    EVENTS_TYPE_COUNT,
+};
+
+/**
+ * Why the device last started. The CLI decodes causes by value, so only add
+ * causes at the end.
+ */
+enum EventsResetCause {
+    EVENTS_RESET_POWER_ON,      /* power-on or the RUN pin */
+    EVENTS_RESET_WATCHDOG,      /* the watchdog expired */
+    EVENTS_RESET_REBOOT,        /* a reboot requested by the host or a debugger */
+};
+
+/**
+ * The scene switch cause for scenes activated directly by the host.
+ */
+#define EVENTS_SCENE_BY_HOST 0xFFFF
+
+#if CFG_RGB_EVENTS
+
+/**
+ * @brief Records the reset cause. Call this once at startup.
+ */
+void events_init(bool is_warm_boot);
+
+/**
+ * @brief Queues an event if the host subscribed to its type, replacing the
+ * oldest event if the queue is full. Call this from the main loop only.
+ */
+void events_post(enum EventsType type, uint8_t arg8, uint16_t arg16);
+
+/**
+ * @brief Sends queued events to the host. Call this from the main loop.
+ */
+void events_task();
+
+void events_get_config(struct Vendor12VRGBEventsConfigReport *report);
+
+/**
+ * @brief Sets the subscription mask. Subscribing to EVENTS_RESET queues a
+ * reset event with the time and cause of the last reset.
+ */
+void events_set_config(const struct Vendor12VRGBEventsConfigReport *report);
+
+#define EVENTS_POST(type, arg8, arg16)  events_post((type), (arg8), (arg16))
+
+#else
+
+#define EVENTS_POST(type, arg8, arg16)  do { } while (0)
+
+#endif // CFG_RGB_EVENTS
+
+#endif // EVENTS_H_
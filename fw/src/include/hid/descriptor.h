@@ -36,6 +36,14 @@
     HID_REPORT_COUNT    (COUNT),            \
     HID_##TYPE          (FLAGS)
 
+// Adds COUNT int16 items of TYPE to the report with FLAGS
+#define HID_ITEM_INT16(TYPE, COUNT, FLAGS)  \
+    HID_LOGICAL_MIN_N   (INT16_MIN, 2),     \
+    HID_LOGICAL_MAX_N   (INT16_MAX, 2),     \
+    HID_REPORT_SIZE     (16),               \
+    HID_REPORT_COUNT    (COUNT),            \
+    HID_##TYPE          (FLAGS)
+
 // Adds COUNT int32 items of TYPE to the report with FLAGS
 #define HID_ITEM_INT32(TYPE, COUNT, FLAGS)  \
     HID_LOGICAL_MIN     (0),                \
@@ -57,8 +65,22 @@ enum {
     HID_REPORT_ID_TEMPERATURE   = 0x20,
 
     // Vendor Reports
-    HID_REPORT_ID_VENDOR_12VRGB_RESET       = 0x30,
-    HID_REPORT_ID_VENDOR_12VRGB_ANIMATION   = 0x31,
+    HID_REPORT_ID_VENDOR_12VRGB_RESET        = 0x30,
+    HID_REPORT_ID_VENDOR_12VRGB_ANIMATION    = 0x31,
+    HID_REPORT_ID_VENDOR_12VRGB_PERSIST      = 0x32,
+    HID_REPORT_ID_VENDOR_12VRGB_SCENE_LAMP   = 0x33,
+    HID_REPORT_ID_VENDOR_12VRGB_SCENE        = 0x34,
+    HID_REPORT_ID_VENDOR_12VRGB_SCENE_RULES  = 0x35,
+    HID_REPORT_ID_VENDOR_12VRGB_SENSOR_BATCH = 0x36,
+    HID_REPORT_ID_VENDOR_12VRGB_POWER        = 0x37,
+    HID_REPORT_ID_VENDOR_12VRGB_CALIBRATION  = 0x38,
+    HID_REPORT_ID_VENDOR_12VRGB_STATS        = 0x39,
+    HID_REPORT_ID_VENDOR_12VRGB_MEMORY       = 0x3A,
+    HID_REPORT_ID_VENDOR_12VRGB_TRACE        = 0x3B,
+    HID_REPORT_ID_VENDOR_12VRGB_RECORDER     = 0x3C,
+    HID_REPORT_ID_VENDOR_12VRGB_LATENCY      = 0x3D,
+    HID_REPORT_ID_VENDOR_12VRGB_STATUS       = 0x3E,
+    HID_REPORT_ID_VENDOR_12VRGB_EVENTS       = 0x3F,
 };
 
 #endif // HID_DESCRIPTOR_H_
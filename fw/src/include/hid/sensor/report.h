@@ -71,6 +71,21 @@
         HID_REPORT_SIZE     (32), \
         HID_REPORT_COUNT    (1), \
         HID_FEATURE         (HID_DATA | HID_VARIABLE | HID_ABSOLUTE), \
+        /* Property: Change Sensitivity Absolute */ \
+        HID_USAGE_N         (HID_USAGE_SENSOR_DATA_ENVIRONMENTAL_TEMPERATURE | HID_USAGE_SENSOR_DATA_MOD_CHANGE_SENSITIVITY_ABS, 2), \
+        HID_LOGICAL_MAX_N   (UINT16_MAX, 3), \
+        HID_REPORT_SIZE     (16), \
+        HID_REPORT_COUNT    (1), \
+        HID_UNIT_EXPONENT   (0x0E), \
+        HID_FEATURE         (HID_DATA | HID_VARIABLE | HID_ABSOLUTE), \
+        /* Property: Change Sensitivity Relative Percent */ \
+        HID_USAGE_N         (HID_USAGE_SENSOR_DATA_ENVIRONMENTAL_TEMPERATURE | HID_USAGE_SENSOR_DATA_MOD_CHANGE_SENSITIVITY_REL_PCT, 2), \
+        HID_LOGICAL_MAX_N   (10000, 2), \
+        HID_REPORT_SIZE     (16), \
+        HID_REPORT_COUNT    (1), \
+        HID_UNIT_EXPONENT   (0x0E), \
+        HID_FEATURE         (HID_DATA | HID_VARIABLE | HID_ABSOLUTE), \
+        HID_UNIT_EXPONENT   (0), \
         /* ------------ */ \
         /* Input Report */ \
         /* ------------ */ \
@@ -110,6 +125,8 @@ struct __attribute__ ((packed)) EnvironmentalTemperatureFeatureReport {
     uint8_t power_state;
     uint8_t sensor_state;
     uint32_t report_interval;
+    uint16_t change_sensitivity_abs;        /* hundredths of a degree */
+    uint16_t change_sensitivity_rel_pct;    /* hundredths of a percent */
 };
 
 struct __attribute__ ((packed)) EnvironmentalTemperatureInputReport {
@@ -22,6 +22,11 @@ enum {
 
     HID_USAGE_SENSOR_DATA_ENVIRONMENTAL_TEMPERATURE = 0x434,
 
+    // Data field modifiers, combined with a data usage to describe a property
+    // of that data field
+    HID_USAGE_SENSOR_DATA_MOD_CHANGE_SENSITIVITY_ABS        = 0x1000,
+    HID_USAGE_SENSOR_DATA_MOD_CHANGE_SENSITIVITY_REL_PCT    = 0xE000,
+
     HID_USAGE_SENSOR_STATE_UNDEFINED        = 0x800,
     HID_USAGE_SENSOR_STATE_READY            = 0x801,
     HID_USAGE_SENSOR_STATE_NOT_AVAILABLE    = 0x802,
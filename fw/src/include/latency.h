@@ -0,0 +1,48 @@
+/**
+ * An end-to-end latency probe. The host sends a probe with a sequence number
+ * and its own timestamp, which forces a lamp commit. The device records when
+ * the probe arrived, when the commit was latched into the lamp outputs, and
+ * when it becomes visible, then returns them with the probe in an input
+ * report so the host can measure host-to-light latency. The latch hook goes
+ * through LATENCY_LATCHED, which compiles to nothing when
+ * CFG_RGB_LATENCY_PROBE is 0.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+
+#include "device/specs.h"
+#include "hid/vendor/report.h"
+
+#if CFG_RGB_LATENCY_PROBE
+
+/**
+ * @brief Starts measuring a probe that arrived over @p path, a
+ * VENDOR_LATENCY_PATH_* value. A probe that has not been returned yet is
+ * replaced. The caller must force a lamp commit.
+ */
+void latency_probe(const struct Vendor12VRGBLatencyProbeReport *probe, uint8_t path);
+
+/**
+ * @brief Records the latch time of the pending probe, if any. Call this after
+ * every lamp commit.
+ */
+void latency_latched();
+
+/**
+ * @brief Sends the result of a latched probe to the host. Call this from the
+ * main loop.
+ */
+void latency_task();
+
+#define LATENCY_LATCHED()   latency_latched()
+
+#else
+
+#define LATENCY_LATCHED()   do { } while (0)
+
+#endif // CFG_RGB_LATENCY_PROBE
+
+#endif // LATENCY_H_
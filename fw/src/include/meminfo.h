@@ -0,0 +1,26 @@
+/**
+ * RAM usage measurements: the size of each static region, stack high-water
+ * marks, and heap usage.
+ */
+
+#ifndef MEMINFO_H_
+#define MEMINFO_H_
+
+#include "hid/vendor/report.h"
+
+/**
+ * The number of cores with a stack region. Core 1 is not started by this
+ * firmware, so its stack is only present if a library reserves one.
+ */
+#define MEMINFO_CORE_COUNT 2
+
+/**
+ * @brief Fills the unused part of each core's stack with a known pattern so
+ * the deepest use can be found later. Call this first thing in main, before
+ * any deep call chains.
+ */
+void meminfo_init();
+
+void meminfo_get_report(struct Vendor12VRGBMemoryReport *report);
+
+#endif // MEMINFO_H_
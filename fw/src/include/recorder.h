@@ -0,0 +1,71 @@
+/**
+ * A flight recorder for HID reports. Every get and set report is kept in a
+ * ring with its arrival time, result, and the start of its payload, so the
+ * host can read back the recent protocol history after something goes wrong.
+ * All recording goes through RECORDER_ARRIVAL and RECORDER_ADD, which compile
+ * to nothing when CFG_RGB_RECORDER is 0.
+ */
+
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <stdint.h>
+
+#include "pico/time.h"
+
+#include "device/specs.h"
+#include "hid/vendor/report.h"
+
+/**
+ * What the device did with a report. The CLI decodes results by value, so
+ * only add results at the end.
+ */
+enum RecorderResult {
+    RECORDER_RESULT_ACCEPTED,
+    RECORDER_RESULT_REJECTED_SIZE,      /* shorter than its struct */
+    RECORDER_RESULT_REJECTED_INVALID,   /* out-of-range fields */
+    RECORDER_RESULT_REJECTED_MODE,      /* host lamp update in autonomous mode */
+    RECORDER_RESULT_REJECTED_UNKNOWN,   /* no handler for the ID and type, or a stalled get */
+    RECORDER_RESULT_REJECTED_BUSY,      /* the flash save queue was full */
+};
+
+/**
+ * Set in the report type of each entry for set reports.
+ */
+#define RECORDER_TYPE_SET 0x80
+
+#if CFG_RGB_RECORDER
+
+/**
+ * @brief Adds a report to the recorder, replacing the oldest entry if it is
+ * full. Reports for the recorder itself are not added, so reading the
+ * recorder does not change it.
+ */
+void recorder_add(uint32_t timestamp_us, uint8_t report_type, uint8_t report_id, enum RecorderResult result,
+    const uint8_t *payload, uint16_t len);
+
+/**
+ * @brief Selects the first entry returned by the recorder feature report, and
+ * clears the recorder if the flags include VENDOR_RECORDER_FLAG_CLEAR.
+ */
+void recorder_set_report(const struct Vendor12VRGBRecorderReport *report);
+
+void recorder_get_report(struct Vendor12VRGBRecorderReport *report);
+
+/**
+ * Declares var as the current time, taken when a report arrives and before
+ * its handler runs, for a later RECORDER_ADD.
+ */
+#define RECORDER_ARRIVAL(var) uint32_t var = time_us_32()
+
+#define RECORDER_ADD(timestamp_us, report_type, report_id, result, payload, len) \
+    recorder_add((timestamp_us), (report_type), (report_id), (result), (payload), (len))
+
+#else
+
+#define RECORDER_ARRIVAL(var) do { } while (0)
+#define RECORDER_ADD(timestamp_us, report_type, report_id, result, payload, len) do { } while (0)
+
+#endif // CFG_RGB_RECORDER
+
+#endif // RECORDER_H_
@@ -0,0 +1,129 @@
+/**
+ * Timing and event counters for the main loop and USB report handlers. All
+ * instrumentation goes through the STATS_* macros, which compile to nothing
+ * when CFG_RGB_STATS is 0.
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+
+#include "device/specs.h"
+#include "hid/vendor/report.h"
+
+/**
+ * The timed stages. Each one is a page of the stats report, in this order.
+ */
+enum StatsTimer {
+    // Main loop tasks
+    STATS_TIMER_TUD_TASK,
+    STATS_TIMER_CTRL_TASK,
+    STATS_TIMER_ANIMATION_FRAME,
+    STATS_TIMER_TEMPERATURE_TASK,
+    STATS_TIMER_SENSOR_TASK,
+    STATS_TIMER_SCENE_TASK,
+    STATS_TIMER_PERSIST_TASK,
+    STATS_TIMER_WARMBOOT_TASK,
+    STATS_TIMER_TRACE_TASK,
+    STATS_TIMER_LATENCY_TASK,
+    STATS_TIMER_EVENTS_TASK,
+
+    // Set report handlers, which run inside tud_task
+    STATS_TIMER_SET_LAMP_ATTRIBUTES_REQUEST,
+    STATS_TIMER_SET_LAMP_MULTI_UPDATE,
+    STATS_TIMER_SET_LAMP_RANGE_UPDATE,
+    STATS_TIMER_SET_LAMP_ARRAY_CONTROL,
+    STATS_TIMER_SET_TEMPERATURE,
+    STATS_TIMER_SET_VENDOR_RESET,
+    STATS_TIMER_SET_VENDOR_ANIMATION,
+    STATS_TIMER_SET_VENDOR_SCENE_LAMP,
+    STATS_TIMER_SET_VENDOR_SCENE,
+    STATS_TIMER_SET_VENDOR_SCENE_RULES,
+    STATS_TIMER_SET_VENDOR_SENSOR_BATCH,
+    STATS_TIMER_SET_VENDOR_CALIBRATION,
+    STATS_TIMER_SET_VENDOR_STATS,
+    STATS_TIMER_SET_VENDOR_TRACE,
+    STATS_TIMER_SET_VENDOR_RECORDER,
+    STATS_TIMER_SET_VENDOR_LATENCY,
+    STATS_TIMER_SET_VENDOR_EVENTS,
+
+    STATS_TIMER_COUNT,
+};
+
+enum StatsCounter {
+    STATS_COUNTER_FRAME_OVERRUNS,       /* animation frames that ran late */
+    STATS_COUNTER_DROPPED_UPDATES,      /* host lamp values replaced before they were committed */
+    STATS_COUNTER_REJECTED_SIZE,        /* set reports shorter than their struct */
+    STATS_COUNTER_REJECTED_INVALID,     /* set reports with out-of-range fields */
+    STATS_COUNTER_REJECTED_MODE,        /* host lamp updates sent in autonomous mode */
+    STATS_COUNTER_REJECTED_UNKNOWN,     /* set reports with an unknown ID */
+    STATS_COUNTER_FLASH_STALLS,         /* flash operations that blocked the main loop */
+    STATS_COUNTER_REJECTED_BUSY,        /* set reports that could not queue a flash save */
+
+    STATS_COUNTER_COUNT,
+};
+
+#if CFG_RGB_STATS
+
+#include "pico/time.h"
+
+/**
+ * @brief Clears all stats and selects the first page.
+ */
+void stats_init();
+
+/**
+ * @brief Returns the current time in microseconds. The timer runs from the
+ * reference clock, so durations stay comparable when the system clock
+ * changes speed.
+ */
+static inline uint32_t stats_time_us()
+{
+    return time_us_32();
+}
+
+/**
+ * @brief Records the duration of a stage that started at @p start, as
+ * returned by stats_time_us.
+ */
+void stats_record(enum StatsTimer timer, uint32_t start);
+
+void stats_count(enum StatsCounter counter, uint32_t n);
+
+/**
+ * @brief Clears all timers and counters.
+ */
+void stats_reset();
+
+/**
+ * @brief Selects the timer returned by the stats feature report.
+ */
+void stats_select(uint8_t page);
+
+void stats_get_report(struct Vendor12VRGBStatsReport *report);
+
+#define STATS_START(var)            uint32_t var = stats_time_us()
+#define STATS_RECORD(timer, var)    stats_record((timer), (var))
+#define STATS_COUNT(counter, n)     stats_count((counter), (n))
+
+/**
+ * Runs a statement and records its duration.
+ */
+#define STATS_TIME(timer, stmt) \
+    do { \
+        uint32_t stats_start_ = stats_time_us(); \
+        stmt; \
+        stats_record((timer), stats_start_); \
+    } while (0)
+
+#else
+
+#define STATS_START(var)            do { } while (0)
+#define STATS_RECORD(timer, var)    do { } while (0)
+#define STATS_COUNT(counter, n)     do { } while (0)
+#define STATS_TIME(timer, stmt)     do { stmt; } while (0)
+
+#endif // CFG_RGB_STATS
+
+#endif // STATS_H_
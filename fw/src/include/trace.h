@@ -0,0 +1,69 @@
+/**
+ * A ring of compact binary events for diagnostics. Events can be written from
+ * any context, including interrupts, and are drained by the main loop to the
+ * trace vendor input report or, in DEBUG_USBHID builds, to stdio. All tracing
+ * goes through the TRACE* macros, which compile to nothing when CFG_RGB_TRACE
+ * is 0.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+#include "device/specs.h"
+#include "hid/vendor/report.h"
+
+/**
+ * Event IDs. The meaning of the arguments depends on the event. The CLI
+ * decodes events by ID, so only add events at the end.
+ */
+enum TraceEvent {
+    TRACE_EVENT_BOOT,           /* arg8: 1 after a warm boot */
+    TRACE_EVENT_GET_INPUT,      /* arg8: report ID, arg16: length, arg32: first payload bytes */
+    TRACE_EVENT_GET_FEATURE,    /* arg8: report ID, arg16: length, arg32: first payload bytes */
+    TRACE_EVENT_SET_OUTPUT,     /* arg8: report ID, arg16: length, arg32: first payload bytes */
+    TRACE_EVENT_SET_FEATURE,    /* arg8: report ID, arg16: length, arg32: first payload bytes */
+    TRACE_EVENT_FRAME_OVERRUN,  /* arg32: frames skipped */
+    TRACE_EVENT_FLASH_STALL,    /* arg32: microseconds with interrupts disabled */
+    TRACE_EVENT_SUSPEND,        /* arg8: 1 if the lamps keep running */
+    TRACE_EVENT_RESUME,
+    TRACE_EVENT_CLOCK_MODE,     /* arg8: new SysclkMode, arg16: old mode, arg32: total milliseconds in the old mode */
+
+    TRACE_EVENT_COUNT,
+};
+
+#if CFG_RGB_TRACE
+
+/**
+ * @brief Adds an event to the ring, replacing the oldest event if it is full.
+ * Safe to call from interrupts.
+ */
+void trace_write(enum TraceEvent event, uint8_t arg8, uint16_t arg16, uint32_t arg32);
+
+/**
+ * @brief Adds an event whose 32-bit argument holds up to the first four bytes
+ * of a payload, and whose 16-bit argument holds the payload length.
+ */
+void trace_write_payload(enum TraceEvent event, uint8_t arg8, const uint8_t *payload, uint16_t len);
+
+/**
+ * @brief Sends pending events to the host if it enabled streaming, or prints
+ * them in DEBUG_USBHID builds. Call this from the main loop.
+ */
+void trace_task();
+
+void trace_get_config(struct Vendor12VRGBTraceConfigReport *report);
+void trace_set_config(const struct Vendor12VRGBTraceConfigReport *report);
+
+#define TRACE(event, arg8, arg16, arg32)            trace_write((event), (arg8), (arg16), (arg32))
+#define TRACE_PAYLOAD(event, arg8, payload, len)    trace_write_payload((event), (arg8), (payload), (len))
+
+#else
+
+#define TRACE(event, arg8, arg16, arg32)            do { } while (0)
+#define TRACE_PAYLOAD(event, arg8, payload, len)    do { } while (0)
+
+#endif // CFG_RGB_TRACE
+
+#endif // TRACE_H_
@@ -0,0 +1,64 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include "pico/platform.h"
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "device/lamp.h"
+#include "device/specs.h"
+#include "hid/descriptor.h"
+#include "hid/vendor/report.h"
+#include "latency.h"
+
+#if CFG_RGB_LATENCY_PROBE
+
+enum LatencyState {
+    LATENCY_STATE_IDLE,
+    LATENCY_STATE_RECEIVED,
+    LATENCY_STATE_LATCHED,
+};
+
+static struct Vendor12VRGBLatencyResultReport result;
+static enum LatencyState state;
+
+void latency_probe(const struct Vendor12VRGBLatencyProbeReport *probe, uint8_t path)
+{
+    result.sequence = probe->sequence;
+    result.host_timestamp = probe->host_timestamp;
+    result.lamp_id = probe->lamp_id;
+    result.path = path;
+    result.receive_us = time_us_32();
+    state = LATENCY_STATE_RECEIVED;
+}
+
+void __time_critical_func(latency_latched)()
+{
+    if (state != LATENCY_STATE_RECEIVED) {
+        return;
+    }
+
+    result.latch_us = time_us_32();
+    result.phase = lamp_get_phase(result.lamp_id);
+    result.visible_us = result.latch_us + lamp_get_update_delay_us(result.lamp_id);
+    state = LATENCY_STATE_LATCHED;
+}
+
+void latency_task()
+{
+    if (state != LATENCY_STATE_LATCHED || !tud_hid_ready()) {
+        return;
+    }
+
+    result.send_us = time_us_32();
+    tud_hid_report(HID_REPORT_ID_VENDOR_12VRGB_LATENCY, &result, sizeof(result));
+    state = LATENCY_STATE_IDLE;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(sizeof(struct Vendor12VRGBLatencyResultReport) == 28, "latency result size must match the report descriptor");
+
+#endif // CFG_RGB_LATENCY_PROBE
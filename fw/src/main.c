@@ -2,52 +2,110 @@
 #include "pico/stdlib.h"
 #include "tusb.h"
 
+#include "color/blend.h"
 #include "color/color.h"
 #include "controller/animations/fade.h"
+#include "controller/calibration.h"
 #include "controller/controller.h"
 #include "controller/persist.h"
+#include "controller/scene.h"
 #include "controller/sensor.h"
+#include "controller/warmboot.h"
 #include "device/lamp.h"
+#include "device/sysclk.h"
 #include "device/temperature.h"
+#include "events.h"
 #include "hid/vendor/report.h"
+#include "latency.h"
+#include "meminfo.h"
+#include "stats.h"
+#include "trace.h"
 
 controller_t ctrl;
 sensor_controller_t sensectrl;
+scene_controller_t scenectrl;
 
 bool is_suspended = false;
 
+// Set while suspended unless a scene keeps the lamps running
+bool is_sleeping = false;
+
 int main()
 {
-    stdio_init_all();
-
+    meminfo_init();
+    sysclk_init();
+#if CFG_RGB_STATS
+    stats_init();
+#endif
     lamp_init();
-    temperature_init();
 
     ctrl_init(&ctrl);
     ctrl_sensor_init(&sensectrl);
-    ctrl_persist_init();
 
-    tusb_init();
+    // After a reboot that preserved RAM, continue exactly where we stopped.
+    // Do this first so the lamps are only dark while the chip resets.
+    bool is_warm_boot = ctrl_warmboot_restore(&ctrl, &sensectrl);
+    TRACE(TRACE_EVENT_BOOT, is_warm_boot, 0, 0);
+#if CFG_RGB_EVENTS
+    events_init(is_warm_boot);
+#endif
 
-    // Set default animations for all lamps
-    for (uint8_t id = 0; id <= MAX_LAMP_ID; id++) {
-        struct Vendor12VRGBAnimationReport *report = ctrl_persist_find_report(id);
-        if (report != NULL) {
-            ctrl_set_animation_from_report(&ctrl, report);
+    stdio_init_all();
+    blend_init();
+    temperature_init();
+
+    ctrl_persist_init();
+    ctrl_calibration_init();
+    ctrl_scene_init(&scenectrl);
+
+    if (!is_warm_boot) {
+        // Set default animations for all lamps
+        for (uint8_t id = 0; id <= MAX_LAMP_ID; id++) {
+            struct Vendor12VRGBAnimationReport *report = ctrl_persist_find_report(id);
+            if (report != NULL) {
+                ctrl_set_animation_from_report(&ctrl, report);
+            }
         }
+#if CFG_RGB_PERSIST_LAMP_STATE
+        ctrl_restore_checkpoint(&ctrl);
+#endif
     }
 
+    // Show the first animation frame before starting USB, since enumeration
+    // can take hundreds of milliseconds
+    ctrl_task(&ctrl);
+
+    tusb_init();
+    ctrl_warmboot_init();
+
     while (true) {
-        tud_task();
+        STATS_TIME(STATS_TIMER_TUD_TASK, tud_task());
 
-        // If suspended, block waiting for any event. On any wake-up (real or
+        // If sleeping, block waiting for any event. On any wake-up (real or
         // spurius), restart the loopo and execute the USB task, because that's
-        // what will clear the suspended flag. Skip any other tasks while suspended.
-        if (is_suspended) {
+        // what will clear the suspended flag. Skip any other tasks while sleeping.
+        if (is_sleeping) {
             __wfe();
         } else {
-            ctrl_task(&ctrl);
-            ctrl_sensor_task(&sensectrl);
+            // Animations run well at the reduced clock, but host updates
+            // should be applied as quickly as possible
+            sysclk_set_mode(ctrl_get_autonomous_mode(&ctrl) ? SYSCLK_MODE_REDUCED : SYSCLK_MODE_FULL);
+
+            STATS_TIME(STATS_TIMER_CTRL_TASK, ctrl_task(&ctrl));
+            STATS_TIME(STATS_TIMER_TEMPERATURE_TASK, temperature_task());
+            STATS_TIME(STATS_TIMER_SENSOR_TASK, ctrl_sensor_task(&sensectrl));
+            STATS_TIME(STATS_TIMER_SCENE_TASK, ctrl_scene_task(&scenectrl, &ctrl));
+            STATS_TIME(STATS_TIMER_PERSIST_TASK, ctrl_persist_task());
+            STATS_TIME(STATS_TIMER_WARMBOOT_TASK, ctrl_warmboot_task(&ctrl, &sensectrl));
+#if CFG_RGB_TRACE
+            STATS_TIME(STATS_TIMER_TRACE_TASK, trace_task());
+#endif
+#if CFG_RGB_LATENCY_PROBE
+            STATS_TIME(STATS_TIMER_LATENCY_TASK, latency_task());
+#endif
+#if CFG_RGB_EVENTS
+            STATS_TIME(STATS_TIMER_EVENTS_TASK, events_task());
+#endif
         }
     }
 
@@ -57,16 +115,31 @@ int main()
 void suspend()
 {
     if (!is_suspended) {
-        ctrl_suspend(&ctrl);
         is_suspended = true;
+
+        // A suspend scene keeps animating from bus power instead of sleeping
+        if (!ctrl_scene_handle_event(&scenectrl, &ctrl, SCENE_EVENT_SUSPEND)) {
+            ctrl_suspend(&ctrl);
+            ctrl_warmboot_pause_watchdog(true);
+            sysclk_set_mode(SYSCLK_MODE_SLEEP);
+            is_sleeping = true;
+        }
+        TRACE(TRACE_EVENT_SUSPEND, !is_sleeping, 0, 0);
     }
 }
 
 void resume()
 {
     if (is_suspended) {
-        ctrl_resume(&ctrl);
+        if (is_sleeping) {
+            ctrl_resume(&ctrl);
+            ctrl_warmboot_pause_watchdog(false);
+            is_sleeping = false;
+        }
         is_suspended = false;
+        TRACE(TRACE_EVENT_RESUME, 0, 0, 0);
+
+        ctrl_scene_handle_event(&scenectrl, &ctrl, SCENE_EVENT_RESUME);
     }
 }
 
@@ -88,3 +161,8 @@ void tud_mount_cb(void)
     // because we still get a suspend event on entering sleep.
     resume();
 }
+
+void tud_umount_cb(void)
+{
+    ctrl_scene_handle_event(&scenectrl, &ctrl, SCENE_EVENT_DISCONNECT);
+}
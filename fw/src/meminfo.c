@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <malloc.h>
+#include <stdint.h>
+
+#include "hid/vendor/report.h"
+#include "meminfo.h"
+
+/**
+ * The value written to unused stack words. A word that still holds this value
+ * has never been used.
+ */
+#define STACK_PAINT 0x5AC3A5C3u
+
+/**
+ * The number of bytes below the current stack pointer to leave unpainted when
+ * painting the running stack, for the painting function's own frame.
+ */
+#define STACK_PAINT_MARGIN 64
+
+// Symbols defined by the SDK linker script
+extern uint32_t __data_start__, __data_end__;
+extern uint32_t __bss_start__, __bss_end__;
+extern uint32_t __end__, __StackLimit;
+extern uint32_t __StackBottom, __StackTop;
+extern uint32_t __StackOneBottom, __StackOneTop;
+
+static uint32_t *const stack_bottom[MEMINFO_CORE_COUNT] = { &__StackBottom, &__StackOneBottom };
+static uint32_t *const stack_top[MEMINFO_CORE_COUNT] = { &__StackTop, &__StackOneTop };
+
+static void paint(uint32_t *start, uint32_t *end)
+{
+    for (volatile uint32_t *p = start; p < end; p++) {
+        *p = STACK_PAINT;
+    }
+}
+
+/**
+ * @brief Returns the number of bytes of a stack that have been used since it
+ * was painted.
+ */
+static uint32_t stack_used(uint8_t core)
+{
+    const uint32_t *p = stack_bottom[core];
+    while (p < stack_top[core] && *p == STACK_PAINT) {
+        p++;
+    }
+    return (uint32_t) ((uintptr_t) stack_top[core] - (uintptr_t) p);
+}
+
+static uint32_t region_size(const void *start, const void *end)
+{
+    return (uint32_t) ((uintptr_t) end - (uintptr_t) start);
+}
+
+void meminfo_init()
+{
+    // Paint the core 0 stack up to just below the current frame
+    uint32_t marker;
+    uint32_t *sp = (uint32_t *) ((uintptr_t) &marker - STACK_PAINT_MARGIN);
+    if (sp > stack_bottom[0] && sp <= stack_top[0]) {
+        paint(stack_bottom[0], sp);
+    }
+
+    // Core 1 is not running, so its whole stack can be painted
+    paint(stack_bottom[1], stack_top[1]);
+}
+
+void meminfo_get_report(struct Vendor12VRGBMemoryReport *report)
+{
+    report->data_size = region_size(&__data_start__, &__data_end__);
+    report->bss_size = region_size(&__bss_start__, &__bss_end__);
+
+    // The heap grows from the end of the static data to the stack limit. The
+    // arena only grows, so it is also the heap's high-water mark.
+    struct mallinfo info = mallinfo();
+    uint32_t heap_size = region_size(&__end__, &__StackLimit);
+    uint32_t heap_arena = (uint32_t) info.arena;
+    report->heap_size = heap_size;
+    report->heap_peak = heap_arena;
+    report->heap_used = (uint32_t) info.uordblks;
+    report->heap_free = heap_size - heap_arena + (uint32_t) info.fordblks;
+
+    for (uint8_t core = 0; core < MEMINFO_CORE_COUNT; core++) {
+        report->stack_size[core] = (uint16_t) region_size(stack_bottom[core], stack_top[core]);
+        report->stack_peak[core] = (uint16_t) stack_used(core);
+    }
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(MEMINFO_CORE_COUNT == MEMORY_REPORT_CORES, "memory report must have one stack per core");
@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pico/platform.h"
+
+#include "device/specs.h"
+#include "hid/descriptor.h"
+#include "hid/vendor/report.h"
+#include "hid/vendor/usage.h"
+#include "recorder.h"
+
+#if CFG_RGB_RECORDER
+
+#define RECORDER_MASK (CFG_RGB_RECORDER_DEPTH - 1)
+
+/**
+ * Each report gets the next sequence number, which never wraps to the ring
+ * size. The ring holds the entries from oldest_sequence up to, but not
+ * including, next_sequence.
+ */
+static struct Vendor12VRGBRecorderEntry ring[CFG_RGB_RECORDER_DEPTH];
+static uint32_t next_sequence;
+static uint32_t oldest_sequence;
+static uint32_t selected_sequence;
+
+void recorder_add(uint32_t timestamp_us, uint8_t report_type, uint8_t report_id, enum RecorderResult result,
+    const uint8_t *payload, uint16_t len)
+{
+    if (report_id == HID_REPORT_ID_VENDOR_12VRGB_RECORDER) {
+        return;
+    }
+
+    if (next_sequence - oldest_sequence == CFG_RGB_RECORDER_DEPTH) {
+        oldest_sequence++;
+    }
+
+    struct Vendor12VRGBRecorderEntry *entry = &ring[next_sequence & RECORDER_MASK];
+    entry->timestamp_us = timestamp_us;
+    entry->report_type = report_type;
+    entry->report_id = report_id;
+    entry->result = (uint8_t) result;
+    entry->length = len;
+
+    uint16_t copied = MIN(len, RECORDER_REPORT_PAYLOAD);
+    memcpy(entry->payload, payload, copied);
+    memset(&entry->payload[copied], 0, RECORDER_REPORT_PAYLOAD - copied);
+
+    next_sequence++;
+}
+
+void recorder_set_report(const struct Vendor12VRGBRecorderReport *report)
+{
+    if (report->flags & VENDOR_RECORDER_FLAG_CLEAR) {
+        oldest_sequence = next_sequence;
+    }
+    selected_sequence = report->sequence;
+}
+
+void recorder_get_report(struct Vendor12VRGBRecorderReport *report)
+{
+    // Entries older than the ring are gone; start at the oldest one left
+    uint32_t sequence = selected_sequence;
+    if ((int32_t) (sequence - oldest_sequence) < 0) {
+        sequence = oldest_sequence;
+    } else if ((int32_t) (next_sequence - sequence) < 0) {
+        sequence = next_sequence;
+    }
+
+    uint8_t count = 0;
+    while (count < RECORDER_REPORT_ENTRIES && sequence + count != next_sequence) {
+        report->entries[count] = ring[(sequence + count) & RECORDER_MASK];
+        count++;
+    }
+    memset(&report->entries[count], 0, (RECORDER_REPORT_ENTRIES - count) * sizeof(report->entries[0]));
+
+    report->sequence = sequence;
+    report->next_sequence = next_sequence;
+    report->flags = 0;
+    report->entry_count = count;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert((CFG_RGB_RECORDER_DEPTH & RECORDER_MASK) == 0, "recorder depth must be a power of 2");
+
+static_assert(sizeof(struct Vendor12VRGBRecorderEntry) == 9 + RECORDER_REPORT_PAYLOAD,
+    "recorder entry size must match the report descriptor");
+
+#endif // CFG_RGB_RECORDER
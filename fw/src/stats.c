@@ -0,0 +1,99 @@
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "device/specs.h"
+#include "hid/vendor/report.h"
+#include "stats.h"
+
+#if CFG_RGB_STATS
+
+/**
+ * Durations below 2^STATS_HISTOGRAM_SHIFT microseconds go in the first
+ * bucket, and each following bucket is twice as wide. The last bucket also
+ * counts all longer durations.
+ */
+#define STATS_HISTOGRAM_SHIFT 0
+
+struct StatsTimerState {
+    uint32_t count;
+    uint32_t max;
+    uint64_t total;
+    uint16_t histogram[STATS_REPORT_BUCKETS];
+};
+
+static struct StatsTimerState timers[STATS_TIMER_COUNT];
+static uint32_t counters[STATS_COUNTER_COUNT];
+static uint8_t selected_page;
+
+void stats_init()
+{
+    stats_reset();
+    selected_page = 0;
+}
+
+void __time_critical_func(stats_record)(enum StatsTimer timer, uint32_t start)
+{
+    uint32_t duration_us = stats_time_us() - start;
+
+    struct StatsTimerState *state = &timers[timer];
+    state->count++;
+    state->total += duration_us;
+    if (duration_us > state->max) {
+        state->max = duration_us;
+    }
+
+    uint32_t bucket = 0;
+    uint32_t c = duration_us >> STATS_HISTOGRAM_SHIFT;
+    while (c > 0 && bucket < STATS_REPORT_BUCKETS - 1) {
+        c >>= 1;
+        bucket++;
+    }
+    if (state->histogram[bucket] < UINT16_MAX) {
+        state->histogram[bucket]++;
+    }
+}
+
+void stats_count(enum StatsCounter counter, uint32_t n)
+{
+    counters[counter] += n;
+}
+
+void stats_reset()
+{
+    memset(timers, 0, sizeof(timers));
+    memset(counters, 0, sizeof(counters));
+}
+
+void stats_select(uint8_t page)
+{
+    if (page < STATS_TIMER_COUNT) {
+        selected_page = page;
+    }
+}
+
+void stats_get_report(struct Vendor12VRGBStatsReport *report)
+{
+    const struct StatsTimerState *state = &timers[selected_page];
+
+    report->page = selected_page;
+    report->page_count = STATS_TIMER_COUNT;
+    report->flags = 0;
+    report->count = state->count;
+    report->mean_us = state->count > 0 ? (uint32_t) (state->total / state->count) : 0;
+    report->max_us = state->max;
+    memcpy(report->histogram, state->histogram, sizeof(report->histogram));
+    for (uint8_t i = 0; i < STATS_COUNTER_COUNT; i++) {
+        report->counters[i] = counters[i] > UINT16_MAX ? UINT16_MAX : (uint16_t) counters[i];
+    }
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert(STATS_COUNTER_COUNT == STATS_REPORT_COUNTERS, "stats report must have one value per counter");
+
+static_assert(STATS_TIMER_COUNT <= UINT8_MAX, "too many timers for the stats report page field");
+
+#endif // CFG_RGB_STATS
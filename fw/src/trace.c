@@ -0,0 +1,153 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+#include "tusb.h"
+
+#include "device/specs.h"
+#include "hid/descriptor.h"
+#include "hid/vendor/report.h"
+#include "hid/vendor/usage.h"
+#include "trace.h"
+
+#if CFG_RGB_TRACE
+
+#define TRACE_MASK (CFG_RGB_TRACE_SIZE - 1)
+
+/**
+ * Events are written at head and read from tail. Both count up without
+ * wrapping to the ring size, so the ring is full when they differ by
+ * CFG_RGB_TRACE_SIZE.
+ */
+static struct Vendor12VRGBTraceEntry ring[CFG_RGB_TRACE_SIZE];
+static uint32_t head;
+static uint32_t tail;
+static uint32_t dropped;
+
+static bool streaming;
+
+void __time_critical_func(trace_write)(enum TraceEvent event, uint8_t arg8, uint16_t arg16, uint32_t arg32)
+{
+    uint32_t now = time_us_32();
+
+    uint32_t interrupts = save_and_disable_interrupts();
+    if (head - tail == CFG_RGB_TRACE_SIZE) {
+        tail++;
+        dropped++;
+    }
+    struct Vendor12VRGBTraceEntry *entry = &ring[head & TRACE_MASK];
+    entry->timestamp_us = now;
+    entry->event = (uint8_t) event;
+    entry->arg8 = arg8;
+    entry->arg16 = arg16;
+    entry->arg32 = arg32;
+    head++;
+    restore_interrupts(interrupts);
+}
+
+void trace_write_payload(enum TraceEvent event, uint8_t arg8, const uint8_t *payload, uint16_t len)
+{
+    uint32_t arg32 = 0;
+    memcpy(&arg32, payload, MIN(len, sizeof(arg32)));
+    trace_write(event, arg8, len, arg32);
+}
+
+/**
+ * @brief Removes up to @p max events from the ring, oldest first, and returns
+ * the number removed. Also returns and clears the dropped event count.
+ */
+static uint8_t read_entries(struct Vendor12VRGBTraceEntry *entries, uint8_t max, uint32_t *dropped_out)
+{
+    uint32_t interrupts = save_and_disable_interrupts();
+    uint8_t count = 0;
+    while (count < max && tail != head) {
+        entries[count++] = ring[tail & TRACE_MASK];
+        tail++;
+    }
+    *dropped_out = dropped;
+    dropped = 0;
+    restore_interrupts(interrupts);
+    return count;
+}
+
+#ifdef DEBUG_USBHID
+static const char *const event_names[] = {
+    [TRACE_EVENT_BOOT] = "boot",
+    [TRACE_EVENT_GET_INPUT] = "get input",
+    [TRACE_EVENT_GET_FEATURE] = "get feature",
+    [TRACE_EVENT_SET_OUTPUT] = "set output",
+    [TRACE_EVENT_SET_FEATURE] = "set feature",
+    [TRACE_EVENT_FRAME_OVERRUN] = "frame overrun",
+    [TRACE_EVENT_FLASH_STALL] = "flash stall",
+    [TRACE_EVENT_SUSPEND] = "suspend",
+    [TRACE_EVENT_RESUME] = "resume",
+    [TRACE_EVENT_CLOCK_MODE] = "clock mode",
+};
+
+static void print_entries()
+{
+    struct Vendor12VRGBTraceEntry entry;
+    uint32_t lost;
+    while (read_entries(&entry, 1, &lost) > 0) {
+        if (lost > 0) {
+            printf("trace: %lu events dropped\n", (unsigned long) lost);
+        }
+        printf("trace %10lu: %s arg8=0x%02x arg16=%u arg32=0x%08lx\n",
+            (unsigned long) entry.timestamp_us, event_names[entry.event],
+            entry.arg8, entry.arg16, (unsigned long) entry.arg32);
+    }
+}
+#endif
+
+void trace_task()
+{
+    if (!streaming) {
+#ifdef DEBUG_USBHID
+        print_entries();
+#endif
+        return;
+    }
+
+    if (head == tail || !tud_hid_ready()) {
+        return;
+    }
+
+    struct Vendor12VRGBTraceReport report;
+    uint32_t lost;
+    report.entry_count = read_entries(report.entries, TRACE_REPORT_ENTRIES, &lost);
+    report.dropped_entries = (uint8_t) MIN(lost, UINT8_MAX);
+    memset(&report.entries[report.entry_count], 0, (TRACE_REPORT_ENTRIES - report.entry_count) * sizeof(report.entries[0]));
+
+    tud_hid_report(HID_REPORT_ID_VENDOR_12VRGB_TRACE, &report, sizeof(report));
+}
+
+void trace_get_config(struct Vendor12VRGBTraceConfigReport *report)
+{
+    report->flags = streaming ? VENDOR_TRACE_FLAG_STREAM : 0;
+}
+
+void trace_set_config(const struct Vendor12VRGBTraceConfigReport *report)
+{
+    streaming = (report->flags & VENDOR_TRACE_FLAG_STREAM) != 0;
+}
+
+// ----------
+// Assertions
+// ----------
+
+static_assert((CFG_RGB_TRACE_SIZE & TRACE_MASK) == 0, "trace ring size must be a power of 2");
+
+static_assert(sizeof(struct Vendor12VRGBTraceEntry) == 12, "trace entry size must match the report descriptor");
+
+static_assert(TRACE_EVENT_COUNT <= UINT8_MAX, "too many trace events for the entry event field");
+
+#ifdef DEBUG_USBHID
+static_assert(count_of(event_names) == TRACE_EVENT_COUNT, "every trace event needs a name");
+#endif
+
+#endif // CFG_RGB_TRACE
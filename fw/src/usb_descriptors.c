@@ -70,6 +70,30 @@ uint8_t const desc_hid_report[] = {
     HID_COLLECTION_VENDOR_12VRGB,
         HID_REPORT_DESC_VENDOR_12VRGB_RESET         (HID_REPORT_ID_VENDOR_12VRGB_RESET),
         HID_REPORT_DESC_VENDOR_12VRGB_ANIMATION     (HID_REPORT_ID_VENDOR_12VRGB_ANIMATION),
+        HID_REPORT_DESC_VENDOR_12VRGB_PERSIST       (HID_REPORT_ID_VENDOR_12VRGB_PERSIST),
+        HID_REPORT_DESC_VENDOR_12VRGB_SCENE_LAMP    (HID_REPORT_ID_VENDOR_12VRGB_SCENE_LAMP),
+        HID_REPORT_DESC_VENDOR_12VRGB_SCENE         (HID_REPORT_ID_VENDOR_12VRGB_SCENE),
+        HID_REPORT_DESC_VENDOR_12VRGB_SCENE_RULES   (HID_REPORT_ID_VENDOR_12VRGB_SCENE_RULES),
+        HID_REPORT_DESC_VENDOR_12VRGB_SENSOR_BATCH  (HID_REPORT_ID_VENDOR_12VRGB_SENSOR_BATCH),
+        HID_REPORT_DESC_VENDOR_12VRGB_POWER         (HID_REPORT_ID_VENDOR_12VRGB_POWER),
+        HID_REPORT_DESC_VENDOR_12VRGB_CALIBRATION   (HID_REPORT_ID_VENDOR_12VRGB_CALIBRATION),
+#if CFG_RGB_STATS
+        HID_REPORT_DESC_VENDOR_12VRGB_STATS         (HID_REPORT_ID_VENDOR_12VRGB_STATS),
+#endif
+        HID_REPORT_DESC_VENDOR_12VRGB_MEMORY        (HID_REPORT_ID_VENDOR_12VRGB_MEMORY),
+        HID_REPORT_DESC_VENDOR_12VRGB_STATUS        (HID_REPORT_ID_VENDOR_12VRGB_STATUS),
+#if CFG_RGB_TRACE
+        HID_REPORT_DESC_VENDOR_12VRGB_TRACE         (HID_REPORT_ID_VENDOR_12VRGB_TRACE),
+#endif
+#if CFG_RGB_RECORDER
+        HID_REPORT_DESC_VENDOR_12VRGB_RECORDER      (HID_REPORT_ID_VENDOR_12VRGB_RECORDER),
+#endif
+#if CFG_RGB_LATENCY_PROBE
+        HID_REPORT_DESC_VENDOR_12VRGB_LATENCY       (HID_REPORT_ID_VENDOR_12VRGB_LATENCY),
+#endif
+#if CFG_RGB_EVENTS
+        HID_REPORT_DESC_VENDOR_12VRGB_EVENTS        (HID_REPORT_ID_VENDOR_12VRGB_EVENTS),
+#endif
     HID_COLLECTION_END,
 };
 
@@ -1,18 +1,24 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "hardware/watchdog.h"
 #include "pico/bootrom.h"
+#include "pico/time.h"
 #include "tusb.h"
 
 #include "controller/animations/fade.h"
+#include "controller/calibration.h"
 #include "controller/controller.h"
 #include "controller/persist.h"
+#include "controller/power.h"
+#include "controller/scene.h"
 #include "controller/sensor.h"
-#include "debug.h"
+#include "controller/warmboot.h"
 #include "device/lamp.h"
 #include "device/specs.h"
+#include "events.h"
 #include "hid/descriptor.h"
 #include "hid/lights/report.h"
 #include "hid/lights/usage.h"
@@ -20,11 +26,17 @@
 #include "hid/sensor/usage.h"
 #include "hid/vendor/report.h"
 #include "hid/vendor/usage.h"
+#include "latency.h"
+#include "meminfo.h"
+#include "recorder.h"
+#include "stats.h"
+#include "trace.h"
 
 #define RESET_STD_REBOOT_DELAY 100
 
 extern controller_t ctrl;
 extern sensor_controller_t sensectrl;
+extern scene_controller_t scenectrl;
 
 static uint16_t get_report_lamp_array_attributes(uint8_t *buffer, uint16_t reqlen)
 {
@@ -79,9 +91,222 @@ static uint16_t get_report_temperature_feature(uint8_t *buffer, uint16_t reqlen)
     return sizeof(struct EnvironmentalTemperatureFeatureReport);
 }
 
+static uint16_t get_report_vendor_12vrgb_sensor_batch(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBSensorBatchConfigReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBSensorBatchConfigReport *report = (struct Vendor12VRGBSensorBatchConfigReport *) buffer;
+    ctrl_sensor_get_batch_config(&sensectrl, report);
+
+    return sizeof(struct Vendor12VRGBSensorBatchConfigReport);
+}
+
+static uint16_t get_report_vendor_12vrgb_power(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBPowerReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBPowerReport *report = (struct Vendor12VRGBPowerReport *) buffer;
+    ctrl_power_get_report(&ctrl.power, report);
+
+    return sizeof(struct Vendor12VRGBPowerReport);
+}
+
+static uint16_t get_report_vendor_12vrgb_calibration(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBCalibrationReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBCalibrationReport *report = (struct Vendor12VRGBCalibrationReport *) buffer;
+    ctrl_calibration_get_selected(&report->lamp_id, &report->channel);
+    report->action = 0;
+
+    const struct CalibrationCurve *curve = ctrl_calibration_get(report->lamp_id, report->channel);
+    memcpy(report->points, curve->points, sizeof(report->points));
+
+    return sizeof(struct Vendor12VRGBCalibrationReport);
+}
+
+#if CFG_RGB_STATS
+static uint16_t get_report_vendor_12vrgb_stats(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBStatsReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBStatsReport *report = (struct Vendor12VRGBStatsReport *) buffer;
+    stats_get_report(report);
+
+    return sizeof(struct Vendor12VRGBStatsReport);
+}
+#endif
+
+#if CFG_RGB_TRACE
+static uint16_t get_report_vendor_12vrgb_trace(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBTraceConfigReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBTraceConfigReport *report = (struct Vendor12VRGBTraceConfigReport *) buffer;
+    trace_get_config(report);
+
+    return sizeof(struct Vendor12VRGBTraceConfigReport);
+}
+#endif
+
+#if CFG_RGB_RECORDER
+static uint16_t get_report_vendor_12vrgb_recorder(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBRecorderReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBRecorderReport *report = (struct Vendor12VRGBRecorderReport *) buffer;
+    recorder_get_report(report);
+
+    return sizeof(struct Vendor12VRGBRecorderReport);
+}
+#endif
+
+#if CFG_RGB_EVENTS
+static uint16_t get_report_vendor_12vrgb_events(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBEventsConfigReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBEventsConfigReport *report = (struct Vendor12VRGBEventsConfigReport *) buffer;
+    events_get_config(report);
+
+    return sizeof(struct Vendor12VRGBEventsConfigReport);
+}
+#endif
+
+static uint16_t get_report_vendor_12vrgb_memory(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBMemoryReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBMemoryReport *report = (struct Vendor12VRGBMemoryReport *) buffer;
+    meminfo_get_report(report);
+
+    return sizeof(struct Vendor12VRGBMemoryReport);
+}
+
+static uint16_t get_report_vendor_12vrgb_status(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBStatusReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBStatusReport *report = (struct Vendor12VRGBStatusReport *) buffer;
+    ctrl_get_status(&ctrl, report);
+
+    return sizeof(struct Vendor12VRGBStatusReport);
+}
+
+static uint16_t get_report_vendor_12vrgb_persist(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBPersistReport)) {
+        return 0;
+    }
+
+    struct PersistStatus status;
+    ctrl_persist_get_status(&status);
+
+    struct Vendor12VRGBPersistReport *report = (struct Vendor12VRGBPersistReport *) buffer;
+    report->pending_writes = status.pending_writes;
+    report->pending_erases = status.pending_erases;
+    report->failed_writes = status.failed_writes;
+    report->completed_writes = status.completed_writes;
+
+    return sizeof(struct Vendor12VRGBPersistReport);
+}
+
+static uint16_t get_report_vendor_12vrgb_scene(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBSceneReport)) {
+        return 0;
+    }
+
+    struct Vendor12VRGBSceneReport *report = (struct Vendor12VRGBSceneReport *) buffer;
+    report->scene_id = ctrl_scene_get_selected(&scenectrl);
+    report->action = 0;
+    if (ctrl_scene_exists(report->scene_id)) {
+        report->action |= VENDOR_SCENE_FLAG_SAVED;
+    }
+    if (ctrl_scene_get_active(&scenectrl) == report->scene_id) {
+        report->action |= VENDOR_SCENE_FLAG_ACTIVE;
+    }
+
+    const char *name = ctrl_scene_get_name(report->scene_id);
+    if (name != NULL) {
+        memcpy(report->name, name, SCENE_REPORT_NAME_SIZE);
+    } else {
+        memset(report->name, 0, SCENE_REPORT_NAME_SIZE);
+    }
+
+    return sizeof(struct Vendor12VRGBSceneReport);
+}
+
+static uint16_t get_report_vendor_12vrgb_scene_rules(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < sizeof(struct Vendor12VRGBSceneRulesReport)) {
+        return 0;
+    }
+
+    struct SceneRules rules;
+    ctrl_scene_get_rules(&scenectrl, &rules);
+
+    struct Vendor12VRGBSceneRulesReport *report = (struct Vendor12VRGBSceneRulesReport *) buffer;
+    memcpy(report->scenes, rules.scenes, SCENE_REPORT_EVENT_COUNT);
+    report->temperature_high = rules.temperature_high;
+    report->temperature_normal = rules.temperature_normal;
+
+    return sizeof(struct Vendor12VRGBSceneRulesReport);
+}
+
+// The result of the set report being handled
+static enum RecorderResult set_report_result;
+
+/**
+ * @brief Marks the set report being handled as rejected and counts it.
+ */
+static void reject_set_report(enum RecorderResult result)
+{
+    set_report_result = result;
+
+    switch (result) {
+    case RECORDER_RESULT_ACCEPTED:
+        break;
+    case RECORDER_RESULT_REJECTED_SIZE:
+        STATS_COUNT(STATS_COUNTER_REJECTED_SIZE, 1);
+        break;
+    case RECORDER_RESULT_REJECTED_INVALID:
+        STATS_COUNT(STATS_COUNTER_REJECTED_INVALID, 1);
+        break;
+    case RECORDER_RESULT_REJECTED_MODE:
+        STATS_COUNT(STATS_COUNTER_REJECTED_MODE, 1);
+        break;
+    case RECORDER_RESULT_REJECTED_UNKNOWN:
+        STATS_COUNT(STATS_COUNTER_REJECTED_UNKNOWN, 1);
+        break;
+    case RECORDER_RESULT_REJECTED_BUSY:
+        STATS_COUNT(STATS_COUNTER_REJECTED_BUSY, 1);
+        break;
+    }
+}
+
 static void set_report_lamp_attributes_request(uint8_t const *buffer, uint16_t bufsize)
 {
     if (bufsize < sizeof(struct LampAttributesRequestReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
 
@@ -100,11 +325,13 @@ static inline bool is_valid_rgbi_tuple(uint8_t *rgbi)
 static void set_report_lamp_multi_update(uint8_t const *buffer, uint16_t bufsize)
 {
     if (bufsize < sizeof(struct LampMultiUpdateReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
 
     // Reject updates if device is running in autonomous mode
     if (ctrl_get_autonomous_mode(&ctrl)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_MODE);
         return;
     }
 
@@ -112,17 +339,21 @@ static void set_report_lamp_multi_update(uint8_t const *buffer, uint16_t bufsize
 
     // Validate input, reject report if any parameters are invalid
     if (report->lamp_count > LAMP_MULTI_UPDATE_BATCH_SIZE) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
         return;
     }
     for (uint8_t i = 0; i < report->lamp_count; i++) {
         if (report->lamp_ids[i] > MAX_LAMP_ID) {
+            reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
             return;
         }
         if (!is_valid_rgbi_tuple(report->rgbi_tuples[i])) {
+            reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
             return;
         }
     }
 
+    ctrl_scene_handle_host_update(&scenectrl, &ctrl);
     for (uint8_t i = 0; i < report->lamp_count; i++) {
         ctrl_update_lamp(&ctrl, (uint8_t) report->lamp_ids[i], lamp_value_from_u8_tuple(report->rgbi_tuples[i]), false);
     }
@@ -135,11 +366,13 @@ static void set_report_lamp_multi_update(uint8_t const *buffer, uint16_t bufsize
 static void set_report_lamp_range_update(uint8_t const *buffer, uint16_t bufsize)
 {
     if (bufsize < sizeof(struct LampRangeUpdateReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
 
     // Reject updates if device is running in autonomous mode
     if (ctrl_get_autonomous_mode(&ctrl)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_MODE);
         return;
     }
 
@@ -147,15 +380,19 @@ static void set_report_lamp_range_update(uint8_t const *buffer, uint16_t bufsize
 
     // Validate input, reject report if any parameters are invalid
     if (report->lamp_id_start > MAX_LAMP_ID || report->lamp_id_end > MAX_LAMP_ID) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
         return;
     }
     if (report->lamp_id_start > report->lamp_id_end) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
         return;
     }
     if (!is_valid_rgbi_tuple(report->rgbi_tuple)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
         return;
     }
 
+    ctrl_scene_handle_host_update(&scenectrl, &ctrl);
     struct LampValue value = lamp_value_from_u8_tuple(report->rgbi_tuple);
     for (uint8_t id = (uint8_t) report->lamp_id_start; id <= report->lamp_id_end; id++) {
         ctrl_update_lamp(&ctrl, id, value, false);
@@ -169,6 +406,7 @@ static void set_report_lamp_range_update(uint8_t const *buffer, uint16_t bufsize
 static void set_report_lamp_array_control(uint8_t const *buffer, uint16_t bufsize)
 {
     if (bufsize < sizeof(struct LampArrayControlReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
 
@@ -179,6 +417,7 @@ static void set_report_lamp_array_control(uint8_t const *buffer, uint16_t bufsiz
 static void set_report_temperature_feature(uint8_t const *buffer, uint16_t bufsize)
 {
     if (bufsize < sizeof(struct EnvironmentalTemperatureFeatureReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
 
@@ -187,16 +426,37 @@ static void set_report_temperature_feature(uint8_t const *buffer, uint16_t bufsi
     ctrl_sensor_set_reporting_state(&sensectrl, report->reporting_state);
     ctrl_sensor_set_power_state(&sensectrl, report->power_state);
     ctrl_sensor_set_report_interval(&sensectrl, report->report_interval);
+    ctrl_sensor_set_change_sensitivity(&sensectrl, report->change_sensitivity_abs, report->change_sensitivity_rel_pct);
+}
+
+static void set_report_vendor_12vrgb_sensor_batch(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBSensorBatchConfigReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBSensorBatchConfigReport *report = (struct Vendor12VRGBSensorBatchConfigReport *) buffer;
+    ctrl_sensor_set_batch_config(&sensectrl, report->batch_size, report->sample_interval_ms, report->max_latency_ms);
 }
 
 static void set_report_vendor_12vrgb_reset(uint8_t const *buffer, uint16_t bufsize)
 {
     if (bufsize < sizeof(struct Vendor12VRGBResetReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
 
     struct Vendor12VRGBResetReport *report = (struct Vendor12VRGBResetReport *) buffer;
 
+    // Resume the current state after a plain reboot, but start from scratch
+    // when clearing settings or loading new firmware
+    if (report->flags & (VENDOR_RESET_FLAG_CLEAR_FLASH | VENDOR_RESET_FLAG_BOOTSEL)) {
+        ctrl_warmboot_invalidate();
+    } else {
+        ctrl_warmboot_save(&ctrl, &sensectrl);
+    }
+
     if (report->flags & VENDOR_RESET_FLAG_CLEAR_FLASH) {
         ctrl_persist_clear();
     }
@@ -210,12 +470,14 @@ static void set_report_vendor_12vrgb_reset(uint8_t const *buffer, uint16_t bufsi
 static void set_report_vendor_12vrgb_animation_output(uint8_t const *buffer, uint16_t bufsize)
 {
     if (bufsize < sizeof(struct Vendor12VRGBAnimationReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
 
     struct Vendor12VRGBAnimationReport *report = (struct Vendor12VRGBAnimationReport *) buffer;
 
     if (report->lamp_id > MAX_LAMP_ID) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
         return;
     }
     ctrl_set_animation_from_report(&ctrl, report);
@@ -224,37 +486,278 @@ static void set_report_vendor_12vrgb_animation_output(uint8_t const *buffer, uin
 static void set_report_vendor_12vrgb_animation_feature(uint8_t const *buffer, uint16_t bufsize)
 {
     if (bufsize < sizeof(struct Vendor12VRGBAnimationReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
 
     struct Vendor12VRGBAnimationReport *report = (struct Vendor12VRGBAnimationReport *) buffer;
 
     if (report->lamp_id > MAX_LAMP_ID) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
+        return;
+    }
+    if (!ctrl_persist_save_report(report)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_BUSY);
+    }
+}
+
+static void set_report_vendor_12vrgb_scene_lamp(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBSceneLampReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
         return;
     }
-    ctrl_persist_save_report(report);
+
+    struct Vendor12VRGBSceneLampReport *report = (struct Vendor12VRGBSceneLampReport *) buffer;
+
+    if (report->scene_id >= SCENE_COUNT || report->animation.lamp_id > MAX_LAMP_ID) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
+        return;
+    }
+    if (!ctrl_scene_save_lamp(report->scene_id, &report->animation)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_BUSY);
+    }
 }
 
-#ifdef DEBUG_USBHID
-static void log_hid_report(char const *func, uint8_t report_id, hid_report_type_t report_type, uint16_t size)
+static void set_report_vendor_12vrgb_scene(uint8_t const *buffer, uint16_t bufsize)
 {
-    char *report_type_str = "unknown";
-    switch (report_type) {
-    case HID_REPORT_TYPE_INPUT:
-        report_type_str = "input";
+    if (bufsize < sizeof(struct Vendor12VRGBSceneReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBSceneReport *report = (struct Vendor12VRGBSceneReport *) buffer;
+
+    if (report->scene_id >= SCENE_COUNT || report->action > VENDOR_SCENE_ACTION_DELETE) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
+        return;
+    }
+
+    ctrl_scene_select(&scenectrl, report->scene_id);
+    switch (report->action) {
+    case VENDOR_SCENE_ACTION_SELECT:
+        break;
+    case VENDOR_SCENE_ACTION_ACTIVATE:
+        ctrl_scene_activate(&scenectrl, &ctrl, report->scene_id);
+        break;
+    case VENDOR_SCENE_ACTION_RENAME:
+        if (!ctrl_scene_save_name(report->scene_id, report->name)) {
+            reject_set_report(RECORDER_RESULT_REJECTED_BUSY);
+        }
         break;
-    case HID_REPORT_TYPE_OUTPUT:
-        report_type_str = "output";
+    case VENDOR_SCENE_ACTION_DELETE:
+        if (!ctrl_scene_delete(&scenectrl, report->scene_id)) {
+            reject_set_report(RECORDER_RESULT_REJECTED_BUSY);
+        }
         break;
-    case HID_REPORT_TYPE_FEATURE:
-        report_type_str = "feature";
+    }
+}
+
+static void set_report_vendor_12vrgb_scene_rules(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBSceneRulesReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBSceneRulesReport *report = (struct Vendor12VRGBSceneRulesReport *) buffer;
+
+    struct SceneRules rules;
+    memcpy(rules.scenes, report->scenes, SCENE_REPORT_EVENT_COUNT);
+    rules.temperature_high = report->temperature_high;
+    rules.temperature_normal = report->temperature_normal;
+
+    if (!ctrl_scene_rules_valid(&rules)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
+        return;
+    }
+    if (!ctrl_scene_set_rules(&scenectrl, &rules)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_BUSY);
+    }
+}
+
+static void set_report_vendor_12vrgb_calibration(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBCalibrationReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBCalibrationReport *report = (struct Vendor12VRGBCalibrationReport *) buffer;
+
+    if (report->lamp_id > MAX_LAMP_ID || report->channel >= CALIBRATION_CHANNELS
+        || report->action > VENDOR_CALIBRATION_ACTION_RESET) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
+        return;
+    }
+
+    struct CalibrationCurve curve;
+    memcpy(curve.points, report->points, sizeof(curve.points));
+
+    ctrl_calibration_select(report->lamp_id, report->channel);
+    switch (report->action) {
+    case VENDOR_CALIBRATION_ACTION_PREVIEW:
+        ctrl_calibration_set(report->lamp_id, report->channel, &curve);
+        ctrl_refresh_lamps(&ctrl);
+        break;
+    case VENDOR_CALIBRATION_ACTION_SAVE:
+        ctrl_calibration_set(report->lamp_id, report->channel, &curve);
+        if (!ctrl_calibration_save(report->lamp_id, report->channel)) {
+            reject_set_report(RECORDER_RESULT_REJECTED_BUSY);
+        }
+        ctrl_refresh_lamps(&ctrl);
         break;
-    case HID_REPORT_TYPE_INVALID:
-        report_type_str = "invalid";
+    case VENDOR_CALIBRATION_ACTION_RESET:
+        if (!ctrl_calibration_reset(report->lamp_id, report->channel)) {
+            reject_set_report(RECORDER_RESULT_REJECTED_BUSY);
+        }
+        ctrl_refresh_lamps(&ctrl);
         break;
     }
+}
+
+#if CFG_RGB_TRACE
+static void set_report_vendor_12vrgb_trace(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBTraceConfigReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBTraceConfigReport *report = (struct Vendor12VRGBTraceConfigReport *) buffer;
+    trace_set_config(report);
+}
+#endif
+
+#if CFG_RGB_RECORDER
+static void set_report_vendor_12vrgb_recorder(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBRecorderReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBRecorderReport *report = (struct Vendor12VRGBRecorderReport *) buffer;
+    recorder_set_report(report);
+}
+#endif
+
+#if CFG_RGB_LATENCY_PROBE
+static void set_report_vendor_12vrgb_latency(uint8_t const *buffer, uint16_t bufsize, uint8_t path)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBLatencyProbeReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBLatencyProbeReport *report = (struct Vendor12VRGBLatencyProbeReport *) buffer;
+    if (report->lamp_id > MAX_LAMP_ID) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
+        return;
+    }
+
+    // Set every lamp again so the probe is latched by the next commit, even if
+    // nothing changed
+    latency_probe(report, path);
+    ctrl_refresh_lamps(&ctrl);
+}
+#endif
+
+#if CFG_RGB_EVENTS
+static void set_report_vendor_12vrgb_events(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBEventsConfigReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBEventsConfigReport *report = (struct Vendor12VRGBEventsConfigReport *) buffer;
+    if (report->mask >= (1u << EVENTS_TYPE_COUNT)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_INVALID);
+        return;
+    }
+    events_set_config(report);
+}
+#endif
+
+#if CFG_RGB_STATS
+static void set_report_vendor_12vrgb_stats(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < sizeof(struct Vendor12VRGBStatsReport)) {
+        reject_set_report(RECORDER_RESULT_REJECTED_SIZE);
+        return;
+    }
+
+    struct Vendor12VRGBStatsReport *report = (struct Vendor12VRGBStatsReport *) buffer;
+
+    stats_select(report->page);
+    if (report->flags & VENDOR_STATS_FLAG_RESET) {
+        stats_reset();
+    }
+}
 
-    printf("USBHID %s: report_id=0x%x, report_type=%s, length=%d\n", func, report_id, report_type_str, size);
+/**
+ * @brief Returns the timer for a set report handler, or STATS_TIMER_COUNT if
+ * no handler accepts the report.
+ */
+static enum StatsTimer set_report_timer(uint8_t report_id, hid_report_type_t report_type)
+{
+    if (report_type == HID_REPORT_TYPE_OUTPUT) {
+        switch (report_id) {
+        case HID_REPORT_ID_VENDOR_12VRGB_ANIMATION:
+            return STATS_TIMER_SET_VENDOR_ANIMATION;
+#if CFG_RGB_LATENCY_PROBE
+        case HID_REPORT_ID_VENDOR_12VRGB_LATENCY:
+            return STATS_TIMER_SET_VENDOR_LATENCY;
+#endif
+        }
+    } else if (report_type == HID_REPORT_TYPE_FEATURE) {
+        switch (report_id) {
+        case HID_REPORT_ID_LAMP_ATTRIBUTES_REQUEST:
+            return STATS_TIMER_SET_LAMP_ATTRIBUTES_REQUEST;
+        case HID_REPORT_ID_LAMP_ARRAY_CONTROL:
+            return STATS_TIMER_SET_LAMP_ARRAY_CONTROL;
+        case HID_REPORT_ID_LAMP_MULTI_UPDATE:
+            return STATS_TIMER_SET_LAMP_MULTI_UPDATE;
+        case HID_REPORT_ID_LAMP_RANGE_UPDATE:
+            return STATS_TIMER_SET_LAMP_RANGE_UPDATE;
+        case HID_REPORT_ID_TEMPERATURE:
+            return STATS_TIMER_SET_TEMPERATURE;
+        case HID_REPORT_ID_VENDOR_12VRGB_RESET:
+            return STATS_TIMER_SET_VENDOR_RESET;
+        case HID_REPORT_ID_VENDOR_12VRGB_ANIMATION:
+            return STATS_TIMER_SET_VENDOR_ANIMATION;
+        case HID_REPORT_ID_VENDOR_12VRGB_SCENE_LAMP:
+            return STATS_TIMER_SET_VENDOR_SCENE_LAMP;
+        case HID_REPORT_ID_VENDOR_12VRGB_SCENE:
+            return STATS_TIMER_SET_VENDOR_SCENE;
+        case HID_REPORT_ID_VENDOR_12VRGB_SCENE_RULES:
+            return STATS_TIMER_SET_VENDOR_SCENE_RULES;
+        case HID_REPORT_ID_VENDOR_12VRGB_SENSOR_BATCH:
+            return STATS_TIMER_SET_VENDOR_SENSOR_BATCH;
+        case HID_REPORT_ID_VENDOR_12VRGB_CALIBRATION:
+            return STATS_TIMER_SET_VENDOR_CALIBRATION;
+        case HID_REPORT_ID_VENDOR_12VRGB_STATS:
+            return STATS_TIMER_SET_VENDOR_STATS;
+#if CFG_RGB_TRACE
+        case HID_REPORT_ID_VENDOR_12VRGB_TRACE:
+            return STATS_TIMER_SET_VENDOR_TRACE;
+#endif
+#if CFG_RGB_RECORDER
+        case HID_REPORT_ID_VENDOR_12VRGB_RECORDER:
+            return STATS_TIMER_SET_VENDOR_RECORDER;
+#endif
+#if CFG_RGB_LATENCY_PROBE
+        case HID_REPORT_ID_VENDOR_12VRGB_LATENCY:
+            return STATS_TIMER_SET_VENDOR_LATENCY;
+#endif
+#if CFG_RGB_EVENTS
+        case HID_REPORT_ID_VENDOR_12VRGB_EVENTS:
+            return STATS_TIMER_SET_VENDOR_EVENTS;
+#endif
+        }
+    }
+    return STATS_TIMER_COUNT;
 }
 #endif
 
@@ -263,10 +766,6 @@ static void log_hid_report(char const *func, uint8_t report_id, hid_report_type_
 // Return zero will cause the stack to STALL request
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
 {
-#ifdef DEBUG_USBHID
-    log_hid_report("get_report", report_id, report_type, reqlen);
-#endif
-
     uint16_t report_len = 0;
     if (report_type == HID_REPORT_TYPE_INPUT) {
         switch (report_id) {
@@ -285,12 +784,59 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
         case HID_REPORT_ID_TEMPERATURE:
             report_len = get_report_temperature_feature(buffer, reqlen);
             break;
+        case HID_REPORT_ID_VENDOR_12VRGB_PERSIST:
+            report_len = get_report_vendor_12vrgb_persist(buffer, reqlen);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_SCENE:
+            report_len = get_report_vendor_12vrgb_scene(buffer, reqlen);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_SCENE_RULES:
+            report_len = get_report_vendor_12vrgb_scene_rules(buffer, reqlen);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_SENSOR_BATCH:
+            report_len = get_report_vendor_12vrgb_sensor_batch(buffer, reqlen);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_POWER:
+            report_len = get_report_vendor_12vrgb_power(buffer, reqlen);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_CALIBRATION:
+            report_len = get_report_vendor_12vrgb_calibration(buffer, reqlen);
+            break;
+#if CFG_RGB_STATS
+        case HID_REPORT_ID_VENDOR_12VRGB_STATS:
+            report_len = get_report_vendor_12vrgb_stats(buffer, reqlen);
+            break;
+#endif
+        case HID_REPORT_ID_VENDOR_12VRGB_MEMORY:
+            report_len = get_report_vendor_12vrgb_memory(buffer, reqlen);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_STATUS:
+            report_len = get_report_vendor_12vrgb_status(buffer, reqlen);
+            break;
+#if CFG_RGB_TRACE
+        case HID_REPORT_ID_VENDOR_12VRGB_TRACE:
+            report_len = get_report_vendor_12vrgb_trace(buffer, reqlen);
+            break;
+#endif
+#if CFG_RGB_RECORDER
+        case HID_REPORT_ID_VENDOR_12VRGB_RECORDER:
+            report_len = get_report_vendor_12vrgb_recorder(buffer, reqlen);
+            break;
+#endif
+#if CFG_RGB_EVENTS
+        case HID_REPORT_ID_VENDOR_12VRGB_EVENTS:
+            report_len = get_report_vendor_12vrgb_events(buffer, reqlen);
+            break;
+#endif
         }
     }
 
-#ifdef DEBUG_USBHID
-    dump_buffer((void *) buffer, report_len, true);
-#endif
+    // Requests that return nothing are stalled
+    RECORDER_ADD(time_us_32(), (uint8_t) report_type, report_id,
+        report_len > 0 ? RECORDER_RESULT_ACCEPTED : RECORDER_RESULT_REJECTED_UNKNOWN, buffer, report_len);
+
+    TRACE_PAYLOAD(report_type == HID_REPORT_TYPE_INPUT ? TRACE_EVENT_GET_INPUT : TRACE_EVENT_GET_FEATURE,
+        report_id, buffer, report_len);
     return report_len;
 }
 
@@ -298,13 +844,11 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize)
 {
-#ifdef DEBUG_USBHID
-    log_hid_report("set_report", report_id, report_type, bufsize);
-    dump_buffer((void *) buffer, bufsize, true);
-#endif
+    RECORDER_ARRIVAL(arrival_us);
 
     // Received data on OUT endpoint, convert to standard format for processing
-    if (report_id == 0 && report_type == 0) {
+    bool from_endpoint = report_id == 0 && report_type == 0;
+    if (from_endpoint) {
         if (bufsize == 0) {
             return;
         }
@@ -314,11 +858,26 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
         bufsize--;
     }
 
+    TRACE_PAYLOAD(report_type == HID_REPORT_TYPE_OUTPUT ? TRACE_EVENT_SET_OUTPUT : TRACE_EVENT_SET_FEATURE,
+        report_id, buffer, bufsize);
+
+    STATS_START(start);
+    set_report_result = RECORDER_RESULT_ACCEPTED;
+
     if (report_type == HID_REPORT_TYPE_OUTPUT) {
         switch (report_id) {
         case HID_REPORT_ID_VENDOR_12VRGB_ANIMATION:
             set_report_vendor_12vrgb_animation_output(buffer, bufsize);
             break;
+#if CFG_RGB_LATENCY_PROBE
+        case HID_REPORT_ID_VENDOR_12VRGB_LATENCY:
+            set_report_vendor_12vrgb_latency(buffer, bufsize,
+                from_endpoint ? VENDOR_LATENCY_PATH_INTERRUPT : VENDOR_LATENCY_PATH_OUTPUT);
+            break;
+#endif
+        default:
+            reject_set_report(RECORDER_RESULT_REJECTED_UNKNOWN);
+            break;
         }
     } else if (report_type == HID_REPORT_TYPE_FEATURE) {
         switch (report_id) {
@@ -343,6 +902,60 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
         case HID_REPORT_ID_VENDOR_12VRGB_ANIMATION:
             set_report_vendor_12vrgb_animation_feature(buffer, bufsize);
             break;
+        case HID_REPORT_ID_VENDOR_12VRGB_SCENE_LAMP:
+            set_report_vendor_12vrgb_scene_lamp(buffer, bufsize);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_SCENE:
+            set_report_vendor_12vrgb_scene(buffer, bufsize);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_SCENE_RULES:
+            set_report_vendor_12vrgb_scene_rules(buffer, bufsize);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_SENSOR_BATCH:
+            set_report_vendor_12vrgb_sensor_batch(buffer, bufsize);
+            break;
+        case HID_REPORT_ID_VENDOR_12VRGB_CALIBRATION:
+            set_report_vendor_12vrgb_calibration(buffer, bufsize);
+            break;
+#if CFG_RGB_STATS
+        case HID_REPORT_ID_VENDOR_12VRGB_STATS:
+            set_report_vendor_12vrgb_stats(buffer, bufsize);
+            break;
+#endif
+#if CFG_RGB_TRACE
+        case HID_REPORT_ID_VENDOR_12VRGB_TRACE:
+            set_report_vendor_12vrgb_trace(buffer, bufsize);
+            break;
+#endif
+#if CFG_RGB_RECORDER
+        case HID_REPORT_ID_VENDOR_12VRGB_RECORDER:
+            set_report_vendor_12vrgb_recorder(buffer, bufsize);
+            break;
+#endif
+#if CFG_RGB_LATENCY_PROBE
+        case HID_REPORT_ID_VENDOR_12VRGB_LATENCY:
+            set_report_vendor_12vrgb_latency(buffer, bufsize, VENDOR_LATENCY_PATH_FEATURE);
+            break;
+#endif
+#if CFG_RGB_EVENTS
+        case HID_REPORT_ID_VENDOR_12VRGB_EVENTS:
+            set_report_vendor_12vrgb_events(buffer, bufsize);
+            break;
+#endif
+        default:
+            reject_set_report(RECORDER_RESULT_REJECTED_UNKNOWN);
+            break;
         }
+    } else {
+        reject_set_report(RECORDER_RESULT_REJECTED_UNKNOWN);
     }
+
+#if CFG_RGB_STATS
+    enum StatsTimer timer = set_report_timer(report_id, report_type);
+    if (timer < STATS_TIMER_COUNT) {
+        STATS_RECORD(timer, start);
+    }
+#endif
+
+    RECORDER_ADD(arrival_us, (uint8_t) (RECORDER_TYPE_SET | report_type), report_id, set_report_result, buffer, bufsize);
 }